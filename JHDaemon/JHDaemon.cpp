@@ -3,35 +3,44 @@
 
 #include "stdafx.h"
 #include "common/Common.h"
-#include "logfile/logfilewrapper.h"
+#include "config/AppConfig.h"
+#include "logfile/logbinary.h"
+#include "logfile/logchannel.h"
+#include "logfile/logfileasync.h"
+#include "logfile/logfilemmap.h"
+#include "logfile/logrepeat.h"
+#include "logfile/logsink.h"
+#include "logfile/logtime.h"
+#include "logformats.h"
 #include "process/process.h"
 #include "timer/TimerManager.h"
-#include "xmlhelper/XmlHelper.h"
 
 class AppInfo {
 public:
     std::string id;             /* 标识 */
     std::string path;           /* 应用程序路径 */
     unsigned int rate;          /* 监听频率(秒) */
+    unsigned int slack;         /* 允许延后检测的时间(毫秒), 用于合并唤醒 */
     bool alone;                 /* 是否运行在独立的控制台 */
     unsigned long pid;          /* 进程id */
+    logchannel_st* channel;     /* 日志通道, NULL表示写入守护进程日志 */
 };
 
-static logfilewrapper_st* s_logWrapper = NULL;
+static logchannel_st* s_logCore = NULL;
+static logfilemmap_st* s_logBinary = NULL;
+static unsigned int s_logSync = LOGFILE_SYNC_NONE;
+static unsigned int s_logSyncInterval = 1000;
+static logrepeat_st* s_logRepeat = NULL;
+static logsinkpipe_st* s_logPipe = NULL;
+static logsink_st* s_logRing = NULL;
+static size_t s_logRingSize = 0;
+static std::string s_logRingFilename;
 static std::vector<AppInfo*> s_appInfoList;
 static std::vector<Process> s_processList;
-
-std::string nowdate(void) {
-    struct tm t;
-    time_t now;
-    time(&now);
-    localtime_s(&t, &now);
-    char buf[32] = { 0 };
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
-    return buf;
-}
+static std::mutex s_processListMutex;
 
 static bool isProcessExist(unsigned long pid) {
+    std::lock_guard<std::mutex> lock(s_processListMutex);
     for (size_t i = 0, len = s_processList.size(); i < len; ++i) {
         if (pid == s_processList[i].id) {
             return true;
@@ -41,6 +50,7 @@ static bool isProcessExist(unsigned long pid) {
 }
 
 static unsigned long getAppProcessId(const std::string& appPath) {
+    std::lock_guard<std::mutex> lock(s_processListMutex);
     for (size_t i = 0, len = s_processList.size(); i < len; ++i) {
         if (appPath == s_processList[i].exePath() + s_processList[i].exeFile) {
             return s_processList[i].id;
@@ -49,113 +59,312 @@ static unsigned long getAppProcessId(const std::string& appPath) {
     return 0;
 }
 
-static bool initLogFile(const std::string& logBasename, const std::string& logExtname) {
-    if (s_logWrapper) {
-        return true;
+/* 写入一条日志, 级别由调用者指定, fold为true时折叠重复的日志 */
+template<LogFormatId formatId, typename... Args>
+static void writeLog(logchannel_st* channel, unsigned int level, bool fold, bool withtime, const Args&... args) {
+    if (!channel) {
+        channel = s_logCore;
+    }
+    /* 应用程序的警告和错误同时写入守护进程日志, 都被过滤时不格式化 */
+    bool toChannel = !channel || logchannel_isenable(channel, level);
+    bool toCore = channel != s_logCore && level >= LOG_LEVEL_WARNING && s_logCore && logchannel_isenable(s_logCore, level);
+    if (!toChannel && !toCore) {
+        return;
+    }
+    /* 窗口内重复的日志在格式化之前丢弃并计数, 窗口结束时输出一条汇总 */
+    if (fold && s_logRepeat) {
+        char buf[LOG_REPEAT_MAX_RECORD];
+        size_t length = LogBinary::encode(buf, sizeof(buf), (unsigned short)formatId, 0, args...);
+        if (length > 0 && 1 == logrepeat_check(s_logRepeat, channel, buf, length, logtime_now_ms())) {
+            return;
+        }
+    }
+    unsigned long long now = withtime ? logtime_now_ms() : 0;
+    if (s_logBinary) {
+        char buf[LOG_BINARY_MAX_RECORD];
+        size_t length = LogBinary::encode(buf, sizeof(buf), (unsigned short)formatId, now, args...);
+        if (length > 0) {
+            logfilemmap_write(s_logBinary, buf, length);
+        }
+    }
+    /* 没有文本输出时不渲染文本, 如二进制日志且未开启控制台, 内存环和syslog */
+    if (s_logPipe && 0 == logsinkpipe_count(s_logPipe)) {
+        return;
+    }
+    /* 时间文本每秒只格式化一次 */
+    std::string str;
+    if (withtime) {
+        char date[32] = { 0 };
+        date[0] = '[';
+        size_t dateLength = 1 + logtime_format(now, date + 1, sizeof(date) - 3, 1);
+        date[dateLength++] = ']';
+        date[dateLength++] = ' ';
+        str.assign(date, dateLength);
+    }
+    size_t offset = str.size();
+    str += LogBinary::render(getLogFormat(formatId), args...);
+    if (!s_logPipe) {
+        printf_s("%s", str.c_str());
+        return;
+    }
+    /* 只格式化一次, 由各输出共享, 控制台等慢的输出不阻塞检测 */
+    logsink_record_st record;
+    record.key = channel;
+    record.level = level;
+    record.ms = now;
+    record.text = str.c_str();
+    record.length = str.size();
+    record.offset = offset;
+    logsinkpipe_publish(s_logPipe, &record);
+}
+
+/* 级别低于LOG_COMPILE_LEVEL的日志在编译期移除 */
+template<LogFormatId formatId, typename... Args>
+static typename std::enable_if<(getLogLevel(formatId) < LOG_COMPILE_LEVEL)>::type
+log(logchannel_st*, bool, const Args&...) {}
+
+template<LogFormatId formatId, typename... Args>
+static typename std::enable_if<(getLogLevel(formatId) >= LOG_COMPILE_LEVEL)>::type
+log(logchannel_st* channel, bool withtime, const Args&... args) {
+    writeLog<formatId>(channel, getLogLevel(formatId), true, withtime, args...);
+}
+
+/* 重复日志的汇总, 与原日志同级别写入原通道 */
+static void onLogRepeated(void* key, const char* record, size_t length, unsigned long long count,
+                          unsigned long long firstMs, unsigned long long lastMs, void* param) {
+    LogBinaryRecord decoded;
+    if (0 == LogBinary::decode(record, length, decoded)) {
+        return;
+    }
+    std::string str = LogBinary::renderRecord(getLogFormat(decoded.formatId), decoded);
+    writeLog<LF_LOG_REPEATED>((logchannel_st*)key, getLogLevel(decoded.formatId), false, true,
+                              count, (lastMs - firstMs + 999) / 1000, str);
+}
+
+/* 文件输出, 通道自带异步环, 所以在发布线程中写入, 应用程序的警告和错误同时写入守护进程日志 */
+static unsigned int onLogFileSink(const logsink_record_st* record, void* param) {
+    if (!record) {
+        return 0;
+    }
+    logchannel_st* channel = (logchannel_st*)record->key;
+    unsigned int ret = logchannel_record(channel, record->level, 0, record->text);
+    if (channel != s_logCore && record->level >= LOG_LEVEL_WARNING) {
+        logchannel_record(s_logCore, record->level, 0, record->text);
+    }
+    return 3 == ret ? 1 : 0;
+}
+
+static void initLogSinks(const std::string& logBasename, bool console, const std::string& syslog, size_t ringSize) {
+    s_logPipe = logsinkpipe_open(LOG_SINK_DEFAULT_POOL);
+    if (!s_logPipe) {
+        return;
+    }
+    /* 控制台由独立线程输出, 控制台慢时丢弃日志而不阻塞检测 */
+    logsink_st* sink = console ? logsink_console(LOG_SINK_DEFAULT_QUEUE, LOG_SINK_DROP) : NULL;
+    if (sink) {
+        logsinkpipe_add(s_logPipe, sink);
+    }
+    sink = s_logBinary ? NULL : logsink_open("file", 0, LOG_SINK_DROP, onLogFileSink, NULL);
+    if (sink) {
+        logsinkpipe_add(s_logPipe, sink);
+    }
+    bool syslogFail = false;
+    if (!syslog.empty()) {
+        sink = logsink_datagram(syslog.c_str(), logBasename.c_str(), LOG_SINK_DEFAULT_QUEUE, LOG_SINK_DROP);
+        if (sink) {
+            logsinkpipe_add(s_logPipe, sink);
+        } else {
+            syslogFail = true;
+        }
+    }
+    /* 内存环保存最近的日志, 退出时写入文件 */
+    s_logRing = ringSize > 0 ? logsink_ring(ringSize) : NULL;
+    if (s_logRing) {
+        logsinkpipe_add(s_logPipe, s_logRing);
+        s_logRingSize = ringSize;
+        s_logRingFilename = logBasename + ".ring";
+    }
+    if (syslogFail) {
+        log<LF_OPEN_FILE_FAIL>(NULL, true, syslog);
+    }
+}
+
+static void closeLogSinks(void) {
+    if (!s_logPipe) {
+        return;
+    }
+    for (size_t i = 0, len = logsinkpipe_count(s_logPipe); i < len; ++i) {
+        logsink_stats_st stats;
+        logsink_stats(logsinkpipe_get(s_logPipe, i), &stats);
+        if (stats.dropped > 0 || stats.failed > 0) {
+            log<LF_LOG_SINK_DROP>(NULL, true, logsink_name(logsinkpipe_get(s_logPipe, i)), stats.dropped, stats.failed);
+        }
+    }
+    if (s_logRing) {
+        std::vector<char> buf(s_logRingSize);
+        buf.resize(logsink_ringread(s_logRing, buf.data(), buf.size()));
+        FILE* fp = fopen(s_logRingFilename.c_str(), "wb");
+        if (fp) {
+            fwrite(buf.data(), 1, buf.size(), fp);
+            fclose(fp);
+        }
     }
-    s_logWrapper = logfilewrapper_init(logBasename.c_str(), logExtname.c_str(), LOGFILE_DEFAULT_MAXSIZE, 1);
-    if (s_logWrapper) {
+    /* 控制台队列中的日志在关闭前输出 */
+    logsinkpipe_st* pipe = s_logPipe;
+    s_logPipe = NULL;
+    s_logRing = NULL;
+    logsinkpipe_close(pipe);
+}
+
+static bool initLogFile(const std::string& logBasename, const std::string& logExtname, bool binary, unsigned int level) {
+    if (s_logCore) {
         return true;
     }
-    return false;
+    if (binary) {
+        /* 二进制日志只写入格式id和参数, 由jhlogcat离线转为文本, 所有通道写入同一个文件, 通道只负责过滤 */
+        s_logBinary = logfilemmap_open(logBasename.c_str(), ".jhlog", LOGFILE_MMAP_DEFAULT_SEGMENT, LOGFILE_MMAP_DEFAULT_SYNC);
+        if (s_logBinary) {
+            s_logCore = logchannel_open(logBasename.c_str(), NULL, NULL, 0, 0, level);
+            return NULL != s_logCore;
+        }
+    }
+    /* 日志文件写满时在后台轮转并压缩, 日志由后台线程写入, 磁盘慢时不阻塞检测 */
+    s_logCore = logchannel_open(logBasename.c_str(), logBasename.c_str(), logExtname.c_str(), LOGFILE_DEFAULT_MAXSIZE,
+                                LOGFILE_ASYNC_DEFAULT_CAPACITY, level);
+    if (!s_logCore) {
+        return false;
+    }
+    /* 落盘策略, 分组提交时后台线程每批日志只同步一次 */
+    logchannel_setsync(s_logCore, s_logSync, s_logSyncInterval);
+    return true;
+}
+
+static logchannel_st* openAppLogFile(const std::string& logBasename, const std::string& logExtname, const std::string& id, unsigned int level) {
+    if (s_logBinary) {
+        return logchannel_open(id.c_str(), NULL, NULL, 0, 0, level);
+    }
+    /* 每个应用程序写入各自的日志文件, 大量诊断日志不拖慢守护进程日志 */
+    std::string basename = logBasename + "_" + id;
+    logchannel_st* channel = logchannel_open(id.c_str(), basename.c_str(), logExtname.c_str(), LOGFILE_DEFAULT_MAXSIZE,
+                                             LOG_CHANNEL_DEFAULT_CAPACITY, level);
+    if (channel) {
+        logchannel_setsync(channel, s_logSync, s_logSyncInterval);
+    }
+    return channel;
 }
 
-static void log(const std::string& str, bool withtime) {
-    printf_s("%s", ((withtime ? "[" + nowdate() + "] " : "") + str).c_str());
-    if (s_logWrapper) {
-        logfilewrapper_record(s_logWrapper, NULL, 0, ((withtime ? "[" + nowdate() + "] " : "") + str).c_str());
+static void closeLogFile(void) {
+    if (s_logCore && LOGFILE_SYNC_NONE != s_logSync) {
+        /* 记录实际的同步耗时 */
+        logfile_syncstats_st stats;
+        logchannel_syncstats(s_logCore, &stats);
+        if (stats.syncs > 0) {
+            log<LF_LOG_SYNC>(NULL, true, logchannel_name(s_logCore), stats.syncs, stats.writes,
+                             stats.totalNs / stats.syncs / 1000, stats.maxNs / 1000);
+        }
+    }
+    if (s_logRepeat) {
+        /* 未结束窗口的汇总在通道关闭前写入 */
+        logrepeat_close(s_logRepeat);
+        s_logRepeat = NULL;
+    }
+    closeLogSinks();
+    for (size_t i = 0, len = s_appInfoList.size(); i < len; ++i) {
+        if (s_appInfoList[i]->channel) {
+            logchannel_close(s_appInfoList[i]->channel);
+            s_appInfoList[i]->channel = NULL;
+        }
     }
+    if (s_logCore) {
+        logchannel_close(s_logCore);
+        s_logCore = NULL;
+    }
+    if (s_logBinary) {
+        logfilemmap_close(s_logBinary);
+        s_logBinary = NULL;
+    }
+}
+
+static void updateProcessList(void) {
+    std::vector<Process> processList = Process::getList();
+    std::lock_guard<std::mutex> lock(s_processListMutex);
+    s_processList.swap(processList);
 }
 
 int main() {
     try {
-        /* 初始日志文件 */
+        /* 读取配置, 快照与xml文件一致时直接映射使用, 不解析xml */
+        const std::string xmlFilename = "JHDaemon.xml";
+        std::string currentDir = Common::replaceString(Common::getCurrentDir(), "\\", "/");
+        std::chrono::steady_clock::time_point loadBegin = std::chrono::steady_clock::now();
+        AppConfig config;
+        int configRet = config.load(xmlFilename, xmlFilename + APP_CONFIG_SNAPSHOT_EXT, currentDir);
+        long long loadUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - loadBegin).count();
+        const AppConfig::Root& root = config.getRoot();
+        /* 初始日志文件, 日志格式由配置决定, 所以在读取配置之后 */
         const std::string logBasename = "JHDaemon";
         const std::string logExtname = ".log";
-        if (!initLogFile(logBasename, logExtname)) {
-            log("[ERROR] can not open JHDaemon.log\n", true);
+        bool logBinary = (0 == strcmp(root.logFormat, "binary"));
+        unsigned int logLevel = logchannel_parselevel(root.logLevel, LOG_LEVEL_INFO);
+        s_logSync = logchannel_parsesync(root.logSync, LOGFILE_SYNC_NONE);
+        s_logSyncInterval = root.logSyncInterval;
+        if (!initLogFile(logBasename, logExtname, logBinary, logLevel)) {
+            log<LF_OPEN_FILE_FAIL>(NULL, true, logBasename + logExtname);
             return 0;
         }
-        /* 读取xml文件 */
-        const std::string xmlFilename = "JHDaemon.xml";
-        pugi::xml_document* doc = XmlHelper::loadFile(xmlFilename);
-        if (!doc) {
-            log("[ERROR] can not open JHDaemon.xml\n", true);
+        /* 日志输出: 控制台, 文件, syslog套接字和内存环 */
+        initLogSinks(logBasename, root.logConsole, root.logSyslog, root.logRing);
+        /* 重复日志折叠窗口(秒), 0表示不折叠 */
+        if (root.logRepeat > 0) {
+            s_logRepeat = logrepeat_open(root.logRepeat * 1000, LOG_REPEAT_DEFAULT_SLOTS, onLogRepeated, NULL);
+        }
+        if (2 == configRet) {
+            log<LF_OPEN_FILE_FAIL>(NULL, true, xmlFilename);
+            closeLogFile();
             return 0;
         }
-        /* 解析xml配置文件 */
-        pugi::xml_node root = XmlHelper::getNode(*doc, "root");
-        if (root.empty()) {
-            log("[ERROR] JHDaemon.xml not exist 'root' node\n", true);
+        if (3 == configRet) {
+            log<LF_ROOT_NOT_EXIST>(NULL, true, xmlFilename);
+            closeLogFile();
             return 0;
         }
-        std::vector<pugi::xml_node> children = XmlHelper::getChildren(root);
-        if (children.empty()) {
-            log("[ERROR] not exist application to listen\n", true);
+        log<LF_CONFIG_LOAD>(NULL, true, xmlFilename, 0 == configRet ? "snapshot" : "xml", config.getAppCount(), loadUs);
+        if (0 == config.getAppCount()) {
+            log<LF_APP_NONE>(NULL, true);
+            closeLogFile();
             return 0;
         }
-        log("==================== applications ====================\n", false);
-        std::string currentDir = Common::replaceString(Common::getCurrentDir(), "\\", "/");
-        for (size_t i = 0, len = children.size(); i < len; ++i) {
-            char id[64] = { 0 };
-            sprintf_s(id, "process_%03d", i + 1);
-            std::string path = XmlHelper::getNodeText(children[i], "path").as_string();
-            path = Common::replaceString(path, "\\", "/");
-            if (!Common::isAbsolutePath(path.c_str())) {
-                std::vector<std::string> currentDirVec = Common::splitString(currentDir, "/");
-                if (!currentDirVec.empty()) {
-                    currentDirVec.erase(currentDirVec.end() - 1);
-                }
-                std::vector<std::string> pathVec = Common::splitString(path, "/");
-                std::vector<std::string>::iterator iter = pathVec.begin();
-                while (pathVec.end() != iter) {
-                    if (".." == *iter) {
-                        pathVec.erase(iter);
-                        if (!currentDirVec.empty()) {
-                            currentDirVec.erase(currentDirVec.end() - 1);
-                        }
-                    } else {
-                        ++iter;
-                    }
-                }
-                path = "";
-                for (size_t i1 = 0, len1 = currentDirVec.size(); i1 < len1; ++i1) {
-                    path += currentDirVec[i1] + "/";
-                }
-                for (size_t i2 = 0, len2 = pathVec.size(); i2 < len2; ++i2) {
-                    path += pathVec[i2] + (i2 < len2 - 1 ? "/" : "");
-                }
-            }
-            unsigned int rate = XmlHelper::getNodeText(children[i], "rate").as_uint();
-            if (0 == rate) {
-                rate = 10;
-            }
-            bool alone = XmlHelper::getNodeText(children[i], "alone").as_bool(true);
-            char rateBuf[16] = { 0 };
-            sprintf_s(rateBuf, "%u", rate);
-            std::string str = "---------- [" + std::string(id) + "]\n";
-            str += "path: " + path + "\n";
-            str += "rate: " + std::string(rateBuf) + "\n";
-            str += "alone: " + std::string((alone ? "true" : "false")) + "\n";
-            log(str, false);
-            if (path.empty()) {
+        unsigned int workers = root.workers;
+        log<LF_APP_LIST_BEGIN>(NULL, false);
+        for (size_t i = 0, len = config.getAppCount(); i < len; ++i) {
+            AppConfig::App app = config.getApp(i);
+            unsigned int appLogLevel = logchannel_parselevel(app.logLevel, logLevel);
+            log<LF_APP_CONFIG>(NULL, false, app.id, app.path, app.rate, app.slack, app.alone ? "true" : "false");
+            if ('\0' == app.path[0]) {
                 continue;
             }
             AppInfo* ai = new AppInfo();
-            ai->id = id;
-            ai->path = path;
-            ai->rate = rate;
-            ai->alone = alone;
+            ai->id = app.id;
+            ai->path = app.path;
+            ai->rate = app.rate;
+            ai->slack = app.slack;
+            ai->alone = app.alone;
             ai->pid = 0;
+            ai->channel = openAppLogFile(logBasename, logExtname, ai->id, appLogLevel);
+            if (!ai->channel) {
+                log<LF_OPEN_FILE_FAIL>(NULL, true, logBasename + "_" + ai->id + logExtname);
+            }
             s_appInfoList.push_back(ai);
         }
-        log("======================================================\n", false);
+        log<LF_APP_LIST_END>(NULL, false);
         /* 创建监听定时器 */
         if (s_appInfoList.empty()) {
-            log("[ERROR] not exist valid application to listen\n", true);
+            log<LF_APP_NONE_VALID>(NULL, true);
+            closeLogFile();
             return 0;
         }
-        s_processList = Process::getList();
+        updateProcessList();
+        TimerManager::getInstance()->setWorkerCount(workers);
         for (size_t j = 0, l = s_appInfoList.size(); j < l; ++j) {
             AppInfo* ai = s_appInfoList[j];
             if (0 == Process::isAppFileExist(ai->path.c_str())) {
@@ -163,7 +372,7 @@ int main() {
                 if (0 == pid) {
                     int ret = Process::runApp(ai->path.c_str(), NULL, ai->alone, &pid);
                     if (0 == ret) {
-                        log("Start application \"" + ai->path + "\", pid = [" + Common::toString((long)pid) + "]\n", true);
+                        log<LF_APP_START>(ai->channel, true, ai->path, pid);
                     } else {
                         std::string str;
                         if (1 == ret) {
@@ -175,35 +384,37 @@ int main() {
                         } else if (4 == ret) {
                             str = "create process fail";
                         }
-                        log("[ERROR] start application \"" + ai->path + "\" fail: " + str + " \n", true);
+                        log<LF_APP_START_FAIL>(ai->channel, true, ai->path, str);
                     }
                 } else {
-                    log("Application \"" + ai->path + "\" has been started, pid = [" + Common::toString((long)pid) + "]\n", true);
+                    log<LF_APP_STARTED>(ai->channel, true, ai->path, pid);
                 }
                 ai->pid = pid;
             } else {
-                log("[ERROR] not exist application file \"" + ai->path + "\"\n", true);
+                log<LF_APP_FILE_NOT_EXIST>(ai->channel, true, ai->path);
             }
-            TimerManager::getInstance()->runLoop(ai->id.c_str(), ai->rate * 1000, [](timer_st* tm, unsigned long runCount, void* param)->void {
+            TimerHandle handle = TimerManager::getInstance()->runLoop(ai->rate * 1000, [](timer_st* tm, unsigned long runCount, void* param)->void {
                 AppInfo* ai = (AppInfo*)param;
                 unsigned long pid = getAppProcessId(ai->path);
                 if (pid > 0) {
                     if (ai->pid > 0 && pid != ai->pid) {
-                        log("Application \"" + ai->path + "\" reassociate, old pid = [" + Common::toString((long)ai->pid) + "], new pid = [" + Common::toString((long)pid) + "]\n", true);
+                        log<LF_APP_REASSOCIATE>(ai->channel, true, ai->path, ai->pid, pid);
+                    } else {
+                        log<LF_APP_CHECK>(ai->channel, true, ai->path, pid);
                     }
                     ai->pid = pid;
                     return;
                 } else if (ai->pid > 0) {
-                    log("[WARNING] application \"" + ai->path + "\", pid = [" + Common::toString((long)ai->pid) + "] has been ended\n", true);
+                    log<LF_APP_ENDED>(ai->channel, true, ai->path, ai->pid);
                 }
                 ai->pid = 0;
                 if (0 != Process::isAppFileExist(ai->path.c_str())) {
-                    log("[ERROR] not exist application file \"" + ai->path + "\"\n", true);
+                    log<LF_APP_FILE_NOT_EXIST>(ai->channel, true, ai->path);
                     return;
                 }
                 int ret = Process::runApp(ai->path.c_str(), NULL, ai->alone, &pid);
                 if (0 == ret) {
-                    log("Restart application \"" + ai->path + "\", pid = [" + Common::toString((long)pid) + "]\n", true);
+                    log<LF_APP_RESTART>(ai->channel, true, ai->path, pid);
                 } else {
                     std::string str;
                     if (1 == ret) {
@@ -215,21 +426,33 @@ int main() {
                     } else if (4 == ret) {
                         str = "create process fail";
                     }
-                    log("[ERROR] restart application \"" + ai->path + "\" fail: " + str + " \n", true);
+                    log<LF_APP_RESTART_FAIL>(ai->channel, true, ai->path, str);
                 }
                 ai->pid = pid;
             }, ai);
+            TimerManager::getInstance()->setSlack(handle, ai->slack);
+            /* 检测落后时不补检, 只按原相位继续 */
+            TimerManager::getInstance()->setCatchup(handle, TIMER_CATCHUP_SKIP);
         }
-        /* 主循环 */
+        /* 主循环, 只在有定时器到期时扫描进程列表 */
         while (1) {
-            Sleep(500);
-            s_processList = Process::getList();
+            unsigned long timeout = TimerManager::getInstance()->getNextTimeout();
+            Sleep(timeout < 1000 ? timeout : 1000);
+            if (0 == TimerManager::getInstance()->getNextTimeout()) {
+                updateProcessList();
+            }
             TimerManager::getInstance()->update();
+            if (s_logRepeat) {
+                logrepeat_expire(s_logRepeat, logtime_now_ms());
+            }
         }
     } catch (std::exception e) {
-        log("[EXCEPTION] Application execption: " + std::string(e.what()) + "!!!\n", true);
+        log<LF_EXCEPTION>(NULL, true, e.what());
     } catch (...) {
-        log("[EXCEPTION] Application execption!!!\n", true);
+        log<LF_EXCEPTION_UNKNOWN>(NULL, true);
     }
+    /* 回调线程可能仍在写日志, 先等待回调结束并停止线程池, 再关闭日志 */
+    TimerManager::getInstance()->shutdown();
+    closeLogFile();
     return 0;
 }
@@ -0,0 +1,511 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	normalized config of JHDaemon, compiled into a versioned and
+*           checksummed binary snapshot next to the xml file, the
+*           snapshot is mapped and used directly while the xml file is
+*           unchanged
+**********************************************************************/
+#include "AppConfig.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../common/Common.h"
+#include "../xmlhelper/XmlPullParser.h"
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define APP_CONFIG_MAGIC    0x5043484A      /* "JHCP" */
+
+/* string in the string area, null terminated */
+struct SnapshotString {
+    unsigned int offset;                /* from the string area */
+    unsigned int length;                /* without the null */
+};
+
+/* snapshot layout: head, application table, string area */
+struct SnapshotHead {
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long size;            /* file size */
+    unsigned long long checksum;        /* hash of the bytes after the head */
+    unsigned long long xmlSize;
+    long long xmlMtime;
+    unsigned long long xmlHash;         /* hash of the xml file */
+    unsigned int appOffset;
+    unsigned int appCount;
+    unsigned int stringOffset;
+    unsigned int stringSize;
+    SnapshotString currentDir;
+    unsigned int workers;
+    unsigned int logSyncInterval;
+    unsigned int logRepeat;
+    unsigned int logRing;
+    unsigned int logConsole;
+    SnapshotString logFormat;
+    SnapshotString logLevel;
+    SnapshotString logSync;
+    SnapshotString logSyslog;
+};
+
+struct SnapshotApp {
+    SnapshotString id;
+    SnapshotString path;
+    SnapshotString logLevel;
+    unsigned int rate;
+    unsigned int slack;
+    unsigned int alone;
+    unsigned int reserved;
+};
+
+/* mapped snapshot file */
+struct SnapshotMapping {
+    const char* base;
+    size_t size;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+static const char* s_empty = "";
+
+/* FNV-1a over 8 byte words then the tail bytes, the xml file is hashed on every start so it must be fast */
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned long long word;
+        memcpy(&word, p + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < length; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool statFile(const std::string& filename, unsigned long long& size, long long& mtime) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    struct _stat64 st;
+    if (0 != _stat64(filename.c_str(), &st)) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (0 != stat(filename.c_str(), &st)) {
+        return false;
+    }
+#endif
+    size = (unsigned long long)st.st_size;
+    mtime = (long long)st.st_mtime;
+    return true;
+}
+
+/* hashed through a fixed buffer, its size is a multiple of 8 so the result equals hashBytes of the whole file */
+static bool hashFile(const std::string& filename, unsigned long long size, unsigned long long& hash) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    std::vector<char> buffer(64 * 1024);
+    unsigned long long total = 0;
+    size_t length = 0;
+    hash = 14695981039346656037ULL;
+    while ((length = fread(buffer.data(), 1, buffer.size(), fp)) > 0) {
+        hash = hashBytes(hash, buffer.data(), length);
+        total += length;
+    }
+    fclose(fp);
+    return total == size;
+}
+
+static XmlPullParser::Range toRange(const std::string& str) {
+    XmlPullParser::Range range;
+    range.data = str.data();
+    range.size = str.size();
+    return range;
+}
+
+/* string area under construction */
+class SnapshotStrings {
+public:
+    SnapshotString add(const std::string& str) {
+        SnapshotString ss;
+        ss.offset = (unsigned int)mArea.size();
+        ss.length = (unsigned int)str.size();
+        mArea.append(str);
+        mArea.push_back('\0');
+        return ss;
+    }
+
+    const std::string& area(void) const {
+        return mArea;
+    }
+
+private:
+    std::string mArea;
+};
+
+static bool checkString(const SnapshotString& ss, const char* area, unsigned int areaSize) {
+    return ss.offset < areaSize && ss.length < areaSize - ss.offset && '\0' == area[ss.offset + ss.length];
+}
+
+/**********************************************************************
+ **************************** class methods ***************************
+ **********************************************************************/
+std::string AppConfig::resolvePath(const std::string& path, const std::string& currentDir) {
+    if (path.empty() || Common::isAbsolutePath(path.c_str())) {
+        return path;
+    }
+    std::vector<std::string> currentDirVec = Common::splitString(currentDir, "/");
+    if (!currentDirVec.empty()) {
+        currentDirVec.erase(currentDirVec.end() - 1);
+    }
+    std::vector<std::string> pathVec = Common::splitString(path, "/");
+    std::vector<std::string>::iterator iter = pathVec.begin();
+    while (pathVec.end() != iter) {
+        if (".." == *iter) {
+            iter = pathVec.erase(iter);
+            if (!currentDirVec.empty()) {
+                currentDirVec.erase(currentDirVec.end() - 1);
+            }
+        } else {
+            ++iter;
+        }
+    }
+    std::string resolved;
+    for (size_t i = 0, len = currentDirVec.size(); i < len; ++i) {
+        resolved += currentDirVec[i] + "/";
+    }
+    for (size_t j = 0, len = pathVec.size(); j < len; ++j) {
+        resolved += pathVec[j] + (j < len - 1 ? "/" : "");
+    }
+    return resolved;
+}
+
+/**********************************************************************
+ ************************** instance methods **************************
+ **********************************************************************/
+AppConfig::AppConfig(void) : mData(NULL), mSize(0), mMapping(NULL) {
+    reset();
+}
+
+AppConfig::~AppConfig(void) {
+    unmap();
+}
+
+int AppConfig::load(const std::string& xmlFilename, const std::string& snapshotFilename, const std::string& currentDir) {
+    unmap();
+    mBuffer.clear();
+    reset();
+    unsigned long long xmlSize = 0;
+    long long xmlMtime = 0;
+    unsigned long long xmlHash = 0;
+    if (!statFile(xmlFilename, xmlSize, xmlMtime) || !hashFile(xmlFilename, xmlSize, xmlHash)) {
+        return 2;
+    }
+    if (map(snapshotFilename)) {
+        const SnapshotHead* head = (const SnapshotHead*)mData;
+        const char* dir = mData + head->stringOffset + head->currentDir.offset;
+        if (xmlSize == head->xmlSize && xmlMtime == head->xmlMtime && xmlHash == head->xmlHash &&
+            currentDir.size() == head->currentDir.length && 0 == memcmp(currentDir.c_str(), dir, currentDir.size())) {
+            return 0;
+        }
+        unmap();
+        reset();
+    }
+    int ret = build(xmlFilename, xmlSize, xmlMtime, xmlHash, currentDir);
+    if (1 != ret) {
+        return ret;
+    }
+    /* written to a temporary file first, a reader never maps a partial snapshot */
+    std::string tmpFilename = snapshotFilename + ".tmp";
+    FILE* fp = fopen(tmpFilename.c_str(), "wb");
+    if (fp) {
+        bool ok = mBuffer.size() == fwrite(mBuffer.data(), 1, mBuffer.size(), fp);
+        ok = 0 == fclose(fp) && ok;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+        remove(snapshotFilename.c_str());
+#endif
+        if (!ok || 0 != rename(tmpFilename.c_str(), snapshotFilename.c_str())) {
+            remove(tmpFilename.c_str());
+        }
+    }
+    return 1;
+}
+
+const AppConfig::Root& AppConfig::getRoot(void) const {
+    return mRoot;
+}
+
+size_t AppConfig::getAppCount(void) const {
+    return mData ? ((const SnapshotHead*)mData)->appCount : 0;
+}
+
+AppConfig::App AppConfig::getApp(size_t index) const {
+    const SnapshotHead* head = (const SnapshotHead*)mData;
+    const SnapshotApp* sa = (const SnapshotApp*)(mData + head->appOffset) + index;
+    const char* area = mData + head->stringOffset;
+    App app;
+    app.id = area + sa->id.offset;
+    app.path = area + sa->path.offset;
+    app.rate = sa->rate;
+    app.slack = sa->slack;
+    app.alone = 0 != sa->alone;
+    app.logLevel = area + sa->logLevel.offset;
+    return app;
+}
+
+int AppConfig::build(const std::string& xmlFilename, unsigned long long xmlSize, long long xmlMtime, unsigned long long xmlHash,
+                     const std::string& currentDir) {
+    /* the xml file is streamed, memory does not grow with its size except for the snapshot itself */
+    XmlPullParser parser;
+    if (!parser.open(xmlFilename)) {
+        return 2;
+    }
+    SnapshotHead head;
+    memset(&head, 0, sizeof(head));
+    SnapshotStrings strings;
+    std::vector<SnapshotApp> apps;
+    bool hasRoot = false;
+    /* fields of the current application, only the first element of each name counts like XmlHelper::getNodeText */
+    enum { FIELD_PATH = 0, FIELD_RATE, FIELD_SLACK, FIELD_ALONE, FIELD_LOGLEVEL, FIELD_COUNT, FIELD_NONE = FIELD_COUNT };
+    static const char* fieldNames[FIELD_COUNT] = { "path", "rate", "slack", "alone", "loglevel" };
+    std::string fields[FIELD_COUNT];
+    bool seen[FIELD_COUNT];
+    int field = FIELD_NONE;
+    bool fieldText = false;
+    while (1) {
+        XmlPullParser::Event event = parser.next();
+        if (XmlPullParser::XPE_ERROR == event) {
+            return 2;
+        } else if (XmlPullParser::XPE_END_DOCUMENT == event) {
+            break;
+        }
+        size_t depth = parser.getDepth();
+        if (XmlPullParser::XPE_START_ELEMENT == event) {
+            if (1 == depth) {
+                if (!parser.getName().equals("root")) {
+                    continue;
+                }
+                hasRoot = true;
+                head.workers = parser.getAttribute("workers").toUint(4);
+                head.logSyncInterval = parser.getAttribute("logsyncinterval").toUint(1000);
+                head.logRepeat = parser.getAttribute("logrepeat").toUint(60);
+                head.logRing = parser.getAttribute("logring").toUint(0);
+                head.logConsole = parser.getAttribute("logconsole").toBool(true) ? 1 : 0;
+                head.logFormat = strings.add(parser.getAttribute("logformat").toString());
+                head.logLevel = strings.add(parser.getAttribute("loglevel").toString());
+                head.logSync = strings.add(parser.getAttribute("logsync").toString());
+                head.logSyslog = strings.add(parser.getAttribute("logsyslog").toString());
+            } else if (hasRoot && 2 == depth) {
+                for (int i = 0; i < FIELD_COUNT; ++i) {
+                    fields[i].clear();
+                    seen[i] = false;
+                }
+            } else if (hasRoot && 3 == depth) {
+                field = FIELD_NONE;
+                for (int i = 0; i < FIELD_COUNT; ++i) {
+                    if (!seen[i] && parser.getName().equals(fieldNames[i])) {
+                        seen[i] = true;
+                        field = i;
+                        fieldText = false;
+                        break;
+                    }
+                }
+            }
+        } else if (XmlPullParser::XPE_TEXT == event) {
+            /* like pugi::xml_node::text, the first text directly under the field */
+            if (hasRoot && 3 == depth && FIELD_NONE != field && !fieldText) {
+                fields[field] = parser.getText().toString();
+                fieldText = true;
+            }
+        } else if (XmlPullParser::XPE_END_ELEMENT == event && hasRoot) {
+            if (1 == depth) {
+                break;
+            } else if (3 == depth) {
+                field = FIELD_NONE;
+            } else if (2 == depth) {
+                /* paths and defaults are normalized here, so applications in the snapshot are used as they are */
+                char id[64] = { 0 };
+                snprintf(id, sizeof(id), "process_%03d", (int)(apps.size() + 1));
+                std::string path = Common::replaceString(fields[FIELD_PATH], "\\", "/");
+                unsigned int rate = toRange(fields[FIELD_RATE]).toUint();
+                if (0 == rate) {
+                    rate = 10;
+                }
+                SnapshotApp sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.id = strings.add(id);
+                sa.path = strings.add(resolvePath(path, currentDir));
+                sa.rate = rate;
+                sa.slack = toRange(fields[FIELD_SLACK]).toUint(rate * 100);
+                sa.alone = toRange(fields[FIELD_ALONE]).toBool(true) ? 1 : 0;
+                sa.logLevel = strings.add(fields[FIELD_LOGLEVEL]);
+                apps.push_back(sa);
+            }
+        }
+    }
+    if (!hasRoot) {
+        return 3;
+    }
+    head.magic = APP_CONFIG_MAGIC;
+    head.version = APP_CONFIG_SNAPSHOT_VERSION;
+    head.xmlSize = xmlSize;
+    head.xmlMtime = xmlMtime;
+    head.xmlHash = xmlHash;
+    head.currentDir = strings.add(currentDir);
+    head.appOffset = (unsigned int)sizeof(head);
+    head.appCount = (unsigned int)apps.size();
+    head.stringOffset = head.appOffset + head.appCount * (unsigned int)sizeof(SnapshotApp);
+    head.stringSize = (unsigned int)strings.area().size();
+    head.size = head.stringOffset + head.stringSize;
+    mBuffer.resize((size_t)head.size);
+    if (!apps.empty()) {
+        memcpy(&mBuffer[head.appOffset], apps.data(), apps.size() * sizeof(SnapshotApp));
+    }
+    memcpy(&mBuffer[head.stringOffset], strings.area().data(), head.stringSize);
+    head.checksum = hashBytes(14695981039346656037ULL, &mBuffer[sizeof(head)], mBuffer.size() - sizeof(head));
+    memcpy(&mBuffer[0], &head, sizeof(head));
+    if (!attach(mBuffer.data(), mBuffer.size())) {
+        mBuffer.clear();
+        return 2;
+    }
+    return 1;
+}
+
+bool AppConfig::map(const std::string& snapshotFilename) {
+    SnapshotMapping* sm = new SnapshotMapping();
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    sm->file = CreateFileA(snapshotFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == sm->file) {
+        delete sm;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(sm->file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SnapshotHead)) {
+        CloseHandle(sm->file);
+        delete sm;
+        return false;
+    }
+    sm->size = (size_t)fileSize.QuadPart;
+    sm->mapping = CreateFileMappingA(sm->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    sm->base = sm->mapping ? (const char*)MapViewOfFile(sm->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!sm->base) {
+        if (sm->mapping) {
+            CloseHandle(sm->mapping);
+        }
+        CloseHandle(sm->file);
+        delete sm;
+        return false;
+    }
+#else
+    int fd = open(snapshotFilename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        delete sm;
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || st.st_size < (off_t)sizeof(SnapshotHead)) {
+        close(fd);
+        delete sm;
+        return false;
+    }
+    sm->size = (size_t)st.st_size;
+    void* base = mmap(NULL, sm->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        delete sm;
+        return false;
+    }
+    sm->base = (const char*)base;
+#endif
+    mMapping = sm;
+    if (!attach(sm->base, sm->size)) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void AppConfig::unmap(void) {
+    SnapshotMapping* sm = (SnapshotMapping*)mMapping;
+    if (!sm) {
+        return;
+    }
+    if (mData == sm->base) {
+        mData = NULL;
+        mSize = 0;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    UnmapViewOfFile(sm->base);
+    CloseHandle(sm->mapping);
+    CloseHandle(sm->file);
+#else
+    munmap((void*)sm->base, sm->size);
+#endif
+    delete sm;
+    mMapping = NULL;
+}
+
+bool AppConfig::attach(const char* data, size_t size) {
+    const SnapshotHead* head = (const SnapshotHead*)data;
+    if (size < sizeof(SnapshotHead) || APP_CONFIG_MAGIC != head->magic || APP_CONFIG_SNAPSHOT_VERSION != head->version ||
+        size != head->size || head->appOffset < sizeof(SnapshotHead) || head->appOffset > size ||
+        head->appCount > (size - head->appOffset) / sizeof(SnapshotApp) ||
+        head->stringOffset < head->appOffset + head->appCount * sizeof(SnapshotApp) ||
+        head->stringOffset > size || head->stringSize != size - head->stringOffset) {
+        return false;
+    }
+    if (head->checksum != hashBytes(14695981039346656037ULL, data + sizeof(SnapshotHead), size - sizeof(SnapshotHead))) {
+        return false;
+    }
+    /* every string is checked once here, so readers need no bounds check */
+    const char* area = data + head->stringOffset;
+    if (!checkString(head->currentDir, area, head->stringSize) || !checkString(head->logFormat, area, head->stringSize) ||
+        !checkString(head->logLevel, area, head->stringSize) || !checkString(head->logSync, area, head->stringSize) ||
+        !checkString(head->logSyslog, area, head->stringSize)) {
+        return false;
+    }
+    const SnapshotApp* apps = (const SnapshotApp*)(data + head->appOffset);
+    for (unsigned int i = 0; i < head->appCount; ++i) {
+        if (!checkString(apps[i].id, area, head->stringSize) || !checkString(apps[i].path, area, head->stringSize) ||
+            !checkString(apps[i].logLevel, area, head->stringSize)) {
+            return false;
+        }
+    }
+    mData = data;
+    mSize = size;
+    mRoot.workers = head->workers;
+    mRoot.logFormat = area + head->logFormat.offset;
+    mRoot.logLevel = area + head->logLevel.offset;
+    mRoot.logSync = area + head->logSync.offset;
+    mRoot.logSyncInterval = head->logSyncInterval;
+    mRoot.logRepeat = head->logRepeat;
+    mRoot.logConsole = 0 != head->logConsole;
+    mRoot.logSyslog = area + head->logSyslog.offset;
+    mRoot.logRing = head->logRing;
+    return true;
+}
+
+void AppConfig::reset(void) {
+    mData = NULL;
+    mSize = 0;
+    mRoot.workers = 4;
+    mRoot.logFormat = s_empty;
+    mRoot.logLevel = s_empty;
+    mRoot.logSync = s_empty;
+    mRoot.logSyncInterval = 1000;
+    mRoot.logRepeat = 60;
+    mRoot.logConsole = true;
+    mRoot.logSyslog = s_empty;
+    mRoot.logRing = 0;
+}
@@ -0,0 +1,115 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	normalized config of JHDaemon, compiled into a versioned and
+*           checksummed binary snapshot next to the xml file, the
+*           snapshot is mapped and used directly while the xml file is
+*           unchanged
+**********************************************************************/
+#ifndef _APP_CONFIG_H_
+#define _APP_CONFIG_H_
+
+#include <string>
+#include <vector>
+
+#define APP_CONFIG_SNAPSHOT_EXT     ".snap"
+#define APP_CONFIG_SNAPSHOT_VERSION 2
+
+class AppConfig {
+public:
+    /**********************************************************************
+     * type define
+     **********************************************************************/
+    /* attributes of root node, strings point into the snapshot */
+    struct Root {
+        unsigned int workers;           /* callback worker threads */
+        const char* logFormat;          /* "binary" for binary records, else text */
+        const char* logLevel;           /* empty means default */
+        const char* logSync;            /* empty means default */
+        unsigned int logSyncInterval;   /* milliseconds */
+        unsigned int logRepeat;         /* seconds */
+        bool logConsole;
+        const char* logSyslog;          /* empty means no syslog */
+        unsigned int logRing;           /* bytes */
+    };
+
+    /* one application, strings point into the snapshot */
+    struct App {
+        const char* id;                 /* e.g. "process_001" */
+        const char* path;               /* absolute path with '/', empty when not configured */
+        unsigned int rate;              /* seconds */
+        unsigned int slack;             /* milliseconds */
+        bool alone;
+        const char* logLevel;           /* empty means the level of root */
+    };
+
+public:
+    AppConfig(void);
+
+    virtual ~AppConfig(void);
+
+public:
+    /*
+     * Brief:	load config, the snapshot is used when its version and checksum are valid and the size,
+     *          modify time and hash of the xml file and the current directory are unchanged, else the
+     *          xml file is parsed and the snapshot is written again
+     * Param:	xmlFilename - xml file name, e.g. "JHDaemon.xml"
+     *          snapshotFilename - snapshot file name, e.g. "JHDaemon.xml" APP_CONFIG_SNAPSHOT_EXT
+     *          currentDir - current directory with '/', relative paths of applications are resolved against its parent
+     * Return:	0.ok, loaded from snapshot
+     *          1.ok, parsed xml file
+     *          2.xml file can not open or parse
+     *          3.xml file has no 'root' node
+     */
+    int load(const std::string& xmlFilename, const std::string& snapshotFilename, const std::string& currentDir);
+
+    /*
+     * Brief:	get attributes of root node, defaults when load fail
+     * Param:	void
+     * Return:	const Root&
+     */
+    const Root& getRoot(void) const;
+
+    /*
+     * Brief:	get count of applications
+     * Param:	void
+     * Return:	size_t
+     */
+    size_t getAppCount(void) const;
+
+    /*
+     * Brief:	get an application
+     * Param:	index - application index, in order of the xml file
+     * Return:	App
+     */
+    App getApp(size_t index) const;
+
+    /*
+     * Brief:	resolve a relative path against the parent of current directory, ".." removes one level
+     * Param:	path - path with '/'
+     *          currentDir - current directory with '/'
+     * Return:	std::string
+     */
+    static std::string resolvePath(const std::string& path, const std::string& currentDir);
+
+private:
+    int build(const std::string& xmlFilename, unsigned long long xmlSize, long long xmlMtime, unsigned long long xmlHash,
+              const std::string& currentDir);
+
+    bool map(const std::string& snapshotFilename);
+
+    void unmap(void);
+
+    bool attach(const char* data, size_t size);
+
+    void reset(void);
+
+private:
+    const char* mData;              /* snapshot, mapped or in mBuffer */
+    size_t mSize;
+    std::vector<char> mBuffer;      /* snapshot built from the xml file */
+    void* mMapping;                 /* platform mapping of the snapshot file */
+    Root mRoot;
+};
+
+#endif	// _APP_CONFIG_H_
@@ -0,0 +1,113 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	binary log record, a static format id, a raw timestamp and
+*           typed arguments, rendered to text offline by jhlogcat
+**********************************************************************/
+#include "logbinary.h"
+#include <stdio.h>
+#include "logtime.h"
+
+size_t LogBinary::decode(const char* data, size_t length, LogBinaryRecord& record) {
+    unsigned short recordLength = 0;
+    unsigned char argCount = 0;
+    size_t pos = LOG_BINARY_HEAD_SIZE;
+    if (length < LOG_BINARY_HEAD_SIZE + 1 || LOG_BINARY_MAGIC != (unsigned char)data[0]) {
+        return 0;
+    }
+    argCount = (unsigned char)data[1];
+    memcpy(&record.formatId, data + 2, 2);
+    memcpy(&recordLength, data + 4, 2);
+    memcpy(&record.timestamp, data + 6, 8);
+    if (recordLength < LOG_BINARY_HEAD_SIZE + 1 || recordLength > length || LOG_BINARY_END != (unsigned char)data[recordLength - 1]) {
+        return 0;
+    }
+    record.args.resize(argCount);
+    for (unsigned char i = 0; i < argCount; ++i) {
+        LogBinaryArg& arg = record.args[i];
+        if (pos >= (size_t)recordLength - 1) {
+            return 0;
+        }
+        arg.type = (LogBinaryArgType)(unsigned char)data[pos];
+        if (LBT_STRING == arg.type) {
+            unsigned short len = 0;
+            if (pos + 3 > (size_t)recordLength - 1) {
+                return 0;
+            }
+            memcpy(&len, data + pos + 1, 2);
+            if (pos + 3 + len > (size_t)recordLength - 1) {
+                return 0;
+            }
+            arg.s.assign(data + pos + 3, len);
+            pos += 3 + len;
+        } else if (LBT_INT == arg.type || LBT_UINT == arg.type || LBT_DOUBLE == arg.type) {
+            if (pos + 9 > (size_t)recordLength - 1) {
+                return 0;
+            }
+            memcpy(&arg.i, data + pos + 1, 8);
+            memcpy(&arg.u, data + pos + 1, 8);
+            memcpy(&arg.d, data + pos + 1, 8);
+            pos += 9;
+        } else {
+            return 0;
+        }
+    }
+    return recordLength;
+}
+
+std::string LogBinary::renderRecord(const char* format, const LogBinaryRecord& record) {
+    std::vector<std::string> texts;
+    std::string str;
+    for (size_t i = 0, len = record.args.size(); i < len; ++i) {
+        const LogBinaryArg& arg = record.args[i];
+        if (LBT_INT == arg.type) {
+            texts.push_back(std::to_string(arg.i));
+        } else if (LBT_UINT == arg.type) {
+            texts.push_back(std::to_string(arg.u));
+        } else if (LBT_DOUBLE == arg.type) {
+            texts.push_back(std::to_string(arg.d));
+        } else {
+            texts.push_back(arg.s);
+        }
+    }
+    if (record.timestamp > 0) {
+        char date[32] = { 0 };
+        logtime_format(record.timestamp, date, sizeof(date), 1);
+        str = "[" + std::string(date) + "] ";
+    }
+    if (format) {
+        return str + substitute(format, texts);
+    }
+    /* unknown format id, keep the arguments */
+    char idBuf[32] = { 0 };
+    sprintf(idBuf, "<format %u>", (unsigned int)record.formatId);
+    str += idBuf;
+    for (size_t i = 0, len = texts.size(); i < len; ++i) {
+        str += " " + texts[i];
+    }
+    return str + "\n";
+}
+
+unsigned long long LogBinary::now(void) {
+    return logtime_now_ms();
+}
+
+std::string LogBinary::substitute(const char* format, const std::vector<std::string>& texts) {
+    std::string str;
+    size_t index = 0;
+    if (!format) {
+        return str;
+    }
+    while (*format) {
+        if ('{' == format[0] && '}' == format[1]) {
+            if (index < texts.size()) {
+                str += texts[index];
+            }
+            ++index;
+            format += 2;
+        } else {
+            str += *format++;
+        }
+    }
+    return str;
+}
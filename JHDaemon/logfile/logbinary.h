@@ -0,0 +1,212 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	binary log record, a static format id, a raw timestamp and
+*           typed arguments, rendered to text offline by jhlogcat
+**********************************************************************/
+#ifndef _LOG_BINARY_H_
+#define _LOG_BINARY_H_
+
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * record layout, little endian:
+ *      u8 magic | u8 argCount | u16 formatId | u16 length | u64 timestamp | args... | u8 end
+ * arg: u8 type | 8 bytes value, or u8 type | u16 length | bytes for string
+ * end byte is never zero so a preallocated segment tail can be told from the last record
+ */
+#define LOG_BINARY_MAGIC        0xB1
+#define LOG_BINARY_END          0x0A
+#define LOG_BINARY_HEAD_SIZE    14
+#define LOG_BINARY_MAX_RECORD   4096
+
+enum LogBinaryArgType {
+    LBT_INT = 1,        /* signed integer, 8 bytes */
+    LBT_UINT,           /* unsigned integer, 8 bytes */
+    LBT_DOUBLE,         /* double, 8 bytes */
+    LBT_STRING          /* u16 length + bytes */
+};
+
+/* decoded argument */
+struct LogBinaryArg {
+    LogBinaryArgType type;
+    long long i;
+    unsigned long long u;
+    double d;
+    std::string s;
+};
+
+/* decoded record */
+struct LogBinaryRecord {
+    unsigned short formatId;
+    unsigned long long timestamp;       /* milliseconds since 1970-01-01 00:00:00, 0 means without time */
+    std::vector<LogBinaryArg> args;
+};
+
+class LogBinary {
+public:
+    /*
+     * Brief:	encode a record
+     * Param:	buf - output buffer
+     *          size - buffer size
+     *          formatId - format id
+     *          timestamp - milliseconds since 1970-01-01 00:00:00, 0 means without time
+     *          args - integers, floating numbers, const char* or std::string
+     * Return:	size_t, record length, 0 if buffer is too small
+     */
+    template<typename... Args>
+    static size_t encode(char* buf, size_t size, unsigned short formatId, unsigned long long timestamp, const Args&... args) {
+        size_t pos = LOG_BINARY_HEAD_SIZE;
+        if (size < LOG_BINARY_HEAD_SIZE + 1 || !putArgs(buf, size - 1, pos, args...)) {
+            return 0;
+        }
+        unsigned short length = (unsigned short)(pos + 1);
+        buf[0] = (char)LOG_BINARY_MAGIC;
+        buf[1] = (char)sizeof...(Args);
+        memcpy(buf + 2, &formatId, 2);
+        memcpy(buf + 4, &length, 2);
+        memcpy(buf + 6, &timestamp, 8);
+        buf[pos] = (char)LOG_BINARY_END;
+        return length;
+    }
+
+    /*
+     * Brief:	render a format as text, every "{}" is replaced by the next argument
+     * Param:	format - format text
+     *          args - arguments
+     * Return:	std::string
+     */
+    template<typename... Args>
+    static std::string render(const char* format, const Args&... args) {
+        std::vector<std::string> texts;
+        texts.reserve(sizeof...(Args));
+        appendTexts(texts, args...);
+        return substitute(format, texts);
+    }
+
+    /*
+     * Brief:	decode a record
+     * Param:	data - record data
+     *          length - available bytes
+     *          record - output record
+     * Return:	size_t, bytes consumed, 0 if data is not a complete record
+     */
+    static size_t decode(const char* data, size_t length, LogBinaryRecord& record);
+
+    /*
+     * Brief:	render a decoded record with its format
+     * Param:	format - format text, NULL renders the arguments separated by space
+     *          record - record
+     * Return:	std::string, with "[YYYY-mm-dd HH:MM:SS.mmm] " prefix when record has time
+     */
+    static std::string renderRecord(const char* format, const LogBinaryRecord& record);
+
+    /*
+     * Brief:	get current time
+     * Param:	void
+     * Return:	unsigned long long, milliseconds since 1970-01-01 00:00:00
+     */
+    static unsigned long long now(void);
+
+private:
+    static bool putArgs(char*, size_t, size_t&) {
+        return true;
+    }
+
+    template<typename T, typename... Rest>
+    static bool putArgs(char* buf, size_t size, size_t& pos, const T& arg, const Rest&... rest) {
+        return putArg(buf, size, pos, arg) && putArgs(buf, size, pos, rest...);
+    }
+
+    static bool putValue(char* buf, size_t size, size_t& pos, LogBinaryArgType type, const void* value) {
+        if (pos + 9 > size) {
+            return false;
+        }
+        buf[pos] = (char)type;
+        memcpy(buf + pos + 1, value, 8);
+        pos += 9;
+        return true;
+    }
+
+    static bool putString(char* buf, size_t size, size_t& pos, const char* str, size_t length) {
+        if (pos + 3 > size) {
+            return false;
+        }
+        if (length > size - pos - 3) {
+            length = size - pos - 3;    /* truncate, the record stays valid */
+        }
+        unsigned short len = (unsigned short)length;
+        buf[pos] = (char)LBT_STRING;
+        memcpy(buf + pos + 1, &len, 2);
+        memcpy(buf + pos + 3, str, length);
+        pos += 3 + length;
+        return true;
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, bool>::type
+    putArg(char* buf, size_t size, size_t& pos, const T& arg) {
+        long long value = (long long)arg;
+        return putValue(buf, size, pos, LBT_INT, &value);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, bool>::type
+    putArg(char* buf, size_t size, size_t& pos, const T& arg) {
+        unsigned long long value = (unsigned long long)arg;
+        return putValue(buf, size, pos, LBT_UINT, &value);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+    putArg(char* buf, size_t size, size_t& pos, const T& arg) {
+        double value = (double)arg;
+        return putValue(buf, size, pos, LBT_DOUBLE, &value);
+    }
+
+    static bool putArg(char* buf, size_t size, size_t& pos, const char* arg) {
+        return putString(buf, size, pos, arg ? arg : "", arg ? strlen(arg) : 0);
+    }
+
+    static bool putArg(char* buf, size_t size, size_t& pos, const std::string& arg) {
+        return putString(buf, size, pos, arg.c_str(), arg.size());
+    }
+
+    static void appendTexts(std::vector<std::string>&) {}
+
+    template<typename T, typename... Rest>
+    static void appendTexts(std::vector<std::string>& texts, const T& arg, const Rest&... rest) {
+        texts.push_back(toText(arg));
+        appendTexts(texts, rest...);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, std::string>::type toText(const T& arg) {
+        return std::to_string((long long)arg);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, std::string>::type toText(const T& arg) {
+        return std::to_string((unsigned long long)arg);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, std::string>::type toText(const T& arg) {
+        return std::to_string((double)arg);
+    }
+
+    static std::string toText(const char* arg) {
+        return arg ? arg : "";
+    }
+
+    static std::string toText(const std::string& arg) {
+        return arg;
+    }
+
+    static std::string substitute(const char* format, const std::vector<std::string>& texts);
+};
+
+#endif // _LOG_BINARY_H_
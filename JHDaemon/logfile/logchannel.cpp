@@ -0,0 +1,183 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	named log channel, each channel has its own rotating file
+*           and a runtime level filter, writer, rotation and compression
+*           threads are shared by every channel
+**********************************************************************/
+#include "logchannel.h"
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+#include "logfileasync.h"
+#include "logfilecompress.h"
+#include "logfilewrapper.h"
+
+struct logchannel_st {
+    logchannel_st(void) : level(LOG_LEVEL_INFO), wrapper(NULL), async(NULL), compress(NULL) {}
+    std::string name;
+    std::atomic<unsigned int> level;
+    logfilewrapper_st* wrapper;         /* NULL when the channel has no file */
+    logfileasync_st* async;             /* shared ring, NULL when records are written in the recording thread */
+    logfilecompress_st* compress;
+    std::mutex mutex;                   /* serializes writes without async */
+};
+
+/* one writer thread and ring for every channel with capacity, thousands of channels need no thread each */
+static std::mutex s_sharedMutex;
+static logfileasync_st* s_sharedAsync = NULL;
+static unsigned int s_sharedUsers = 0;
+
+static logfileasync_st* acquireShared(size_t capacity) {
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    if (!s_sharedAsync) {
+        s_sharedAsync = logfileasync_open(NULL, capacity > LOG_CHANNEL_SHARED_CAPACITY ? capacity : LOG_CHANNEL_SHARED_CAPACITY, LOGFILE_ASYNC_COUNT);
+        if (!s_sharedAsync) {
+            return NULL;
+        }
+    }
+    ++s_sharedUsers;
+    return s_sharedAsync;
+}
+
+static void releaseShared(void) {
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    if (0 == --s_sharedUsers) {
+        logfileasync_close(s_sharedAsync);
+        s_sharedAsync = NULL;
+    }
+}
+
+static const char* s_levelNames[] = { "debug", "info", "warning", "error", "none" };
+static const char* s_syncNames[] = { "none", "interval", "group", "record" };
+
+/* index of str in names, case insensitive, -1 if not found */
+static int findName(const char* str, const char** names, int count) {
+    for (int index = 0; index < count; ++index) {
+        const char* name = names[index];
+        size_t i = 0;
+        while (str[i] && tolower((unsigned char)str[i]) == name[i]) {
+            ++i;
+        }
+        if ('\0' == str[i] && '\0' == name[i]) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+logchannel_st* logchannel_open(const char* name, const char* basename, const char* extname, size_t maxSize, size_t capacity, unsigned int level) {
+    logchannel_st* lc = NULL;
+    assert(name);
+    lc = new (std::nothrow) logchannel_st();
+    if (!lc) {
+        return NULL;
+    }
+    lc->name = name;
+    lc->level = level;
+    if (!basename) {
+        return lc;
+    }
+    lc->wrapper = logfilewrapper_init(basename, extname, maxSize, 0);
+    if (!lc->wrapper) {
+        delete lc;
+        return NULL;
+    }
+    logfilewrapper_prepare(lc->wrapper);
+    /* time range queries seek through the sidecar index instead of scanning */
+    logfilewrapper_setindex(lc->wrapper, LOGFILE_INDEX_DEFAULT_INTERVAL);
+    lc->compress = logfilecompress_open(basename, extname, LOGFILE_COMPRESS_DEFAULT_COUNT,
+                                        LOGFILE_COMPRESS_DEFAULT_BYTES, LOGFILE_COMPRESS_DEFAULT_CPU);
+    if (lc->compress) {
+        logfilewrapper_onrotate(lc->wrapper, logfilecompress_onrotate, lc->compress);
+    }
+    if (capacity > 0) {
+        lc->async = acquireShared(capacity);
+        if (lc->async) {
+            logfileasync_attach(lc->async, lc->wrapper);
+        }
+    }
+    return lc;
+}
+
+void logchannel_close(logchannel_st* lc) {
+    assert(lc);
+    if (lc->async) {
+        logfileasync_detach(lc->async, lc->wrapper);
+        releaseShared();
+    }
+    if (lc->wrapper) {
+        /* pending background renames are finished before compression stops */
+        logfilewrapper_close(lc->wrapper);
+    }
+    if (lc->compress) {
+        logfilecompress_close(lc->compress);
+    }
+    delete lc;
+}
+
+const char* logchannel_name(logchannel_st* lc) {
+    assert(lc);
+    return lc->name.c_str();
+}
+
+void logchannel_setlevel(logchannel_st* lc, unsigned int level) {
+    assert(lc);
+    lc->level.store(level, std::memory_order_relaxed);
+}
+
+void logchannel_setsync(logchannel_st* lc, unsigned int policy, unsigned int interval) {
+    assert(lc);
+    if (lc->wrapper) {
+        std::lock_guard<std::mutex> lock(lc->mutex);
+        logfilewrapper_setsync(lc->wrapper, policy, interval);
+    }
+}
+
+void logchannel_syncstats(logchannel_st* lc, logfile_syncstats_st* stats) {
+    assert(lc);
+    assert(stats);
+    memset(stats, 0, sizeof(*stats));
+    if (lc->wrapper) {
+        std::lock_guard<std::mutex> lock(lc->mutex);
+        logfilewrapper_syncstats(lc->wrapper, stats);
+    }
+}
+
+unsigned int logchannel_isenable(logchannel_st* lc, unsigned int level) {
+    assert(lc);
+    return level >= lc->level.load(std::memory_order_relaxed) && level < LOG_LEVEL_NONE ? 1 : 0;
+}
+
+unsigned int logchannel_record(logchannel_st* lc, unsigned int level, unsigned int withtime, const char* content) {
+    assert(lc);
+    if (!logchannel_isenable(lc, level)) {
+        return 1;
+    }
+    if (!lc->wrapper) {
+        return 2;
+    }
+    if (lc->async) {
+        return 0 == logfileasync_recordto(lc->async, lc->wrapper, NULL, withtime, content) ? 0 : 3;
+    }
+    std::lock_guard<std::mutex> lock(lc->mutex);
+    if (0 != logfilewrapper_record(lc->wrapper, NULL, withtime, content)) {
+        return 3;
+    }
+    logfilewrapper_commit(lc->wrapper);
+    return 0;
+}
+
+unsigned int logchannel_parselevel(const char* str, unsigned int def) {
+    int index = str ? findName(str, s_levelNames, sizeof(s_levelNames) / sizeof(s_levelNames[0])) : -1;
+    return index >= 0 ? (unsigned int)index : def;
+}
+
+unsigned int logchannel_parsesync(const char* str, unsigned int def) {
+    int index = str ? findName(str, s_syncNames, sizeof(s_syncNames) / sizeof(s_syncNames[0])) : -1;
+    return index >= 0 ? (unsigned int)index : def;
+}
@@ -0,0 +1,138 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	named log channel, each channel has its own rotating file
+*           and a runtime level filter, writer, rotation and compression
+*           threads are shared by every channel
+**********************************************************************/
+#ifndef _LOG_CHANNEL_H_
+#define _LOG_CHANNEL_H_
+
+#include <stddef.h>
+#include "logfile.h"
+
+/* log levels, a record is kept when its level is not lower than the channel level */
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARNING   2
+#define LOG_LEVEL_ERROR     3
+#define LOG_LEVEL_NONE      4
+
+/*
+ * records below this level are removed at compile time by callers which know the level statically,
+ * define it in the project, e.g. LOG_COMPILE_LEVEL=1 drops every debug record from the binary
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL   LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_CHANNEL_DEFAULT_CAPACITY    64*1024L
+#define LOG_CHANNEL_SHARED_CAPACITY     4*1024*1024L    /* min size of the ring shared by channels */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logchannel_st logchannel_st;
+
+/*
+ * Brief:	open a channel, its file rotates in background, rotated files are compressed and every
+ *          file has a sidecar time index, see LOGFILE_INDEX_EXT, background threads are shared so
+ *          a channel only costs its own file state
+ * Param:	name - channel name
+ *          basename - file base name, NULL means the channel only filters and records are written elsewhere
+ *          extname - file extend name, e.g. ".log"
+ *          maxSize - file max size
+ *          capacity - 0 means records are written in the recording thread, otherwise they go through one
+ *                     ring and writer thread shared by channels, the first such channel creates the ring
+ *                     with max(capacity, LOG_CHANNEL_SHARED_CAPACITY) bytes
+ *          level - runtime level, LOG_LEVEL_XXX
+ * Return:	logchannel_st*
+ */
+extern logchannel_st* logchannel_open(const char* name, const char* basename, const char* extname, size_t maxSize, size_t capacity, unsigned int level);
+
+/*
+ * Brief:	flush pending records and close the channel
+ * Param:	lc - channel
+ * Return:	void
+ */
+extern void logchannel_close(logchannel_st* lc);
+
+/*
+ * Brief:	get channel name
+ * Param:	lc - channel
+ * Return:	const char*
+ */
+extern const char* logchannel_name(logchannel_st* lc);
+
+/*
+ * Brief:	set runtime level, can be called in any thread
+ * Param:	lc - channel
+ *          level - LOG_LEVEL_XXX
+ * Return:	void
+ */
+extern void logchannel_setlevel(logchannel_st* lc, unsigned int level);
+
+/*
+ * Brief:	set durability policy, call before recording, with an asynchronous ring LOGFILE_SYNC_GROUP
+ *          syncs once per batch of the writer, without it every record is its own group
+ * Param:	lc - channel
+ *          policy - LOGFILE_SYNC_XXX
+ *          interval - milliseconds between syncs, for LOGFILE_SYNC_INTERVAL
+ * Return:	void
+ */
+extern void logchannel_setsync(logchannel_st* lc, unsigned int policy, unsigned int interval);
+
+/*
+ * Brief:	get sync statistics, call when no record is running, e.g. before close
+ * Param:	lc - channel
+ *          stats - output statistics, zero when the channel has no file
+ * Return:	void
+ */
+extern void logchannel_syncstats(logchannel_st* lc, logfile_syncstats_st* stats);
+
+/*
+ * Brief:	check a level before formatting a record, can be called in any thread
+ * Param:	lc - channel
+ *          level - record level
+ * Return:	0.filtered
+ *          1.enable
+ */
+extern unsigned int logchannel_isenable(logchannel_st* lc, unsigned int level);
+
+/*
+ * Brief:	record log, can be called in any thread, content is written as "[time] content"
+ *          without adding a newline
+ * Param:	lc - channel
+ *          level - record level
+ *          withtime - with time, 0.false, 1.true
+ *          content - record content
+ * Return:	0.ok
+ *          1.filtered
+ *          2.channel has no file
+ *          3.write fail
+ */
+extern unsigned int logchannel_record(logchannel_st* lc, unsigned int level, unsigned int withtime, const char* content);
+
+/*
+ * Brief:	parse a level name
+ * Param:	str - "debug", "info", "warning", "error" or "none", case insensitive
+ *          def - returned when str is NULL or unknown
+ * Return:	unsigned int, LOG_LEVEL_XXX
+ */
+extern unsigned int logchannel_parselevel(const char* str, unsigned int def);
+
+/*
+ * Brief:	parse a durability policy name
+ * Param:	str - "none", "interval", "group" or "record", case insensitive
+ *          def - returned when str is NULL or unknown
+ * Return:	unsigned int, LOGFILE_SYNC_XXX
+ */
+extern unsigned int logchannel_parsesync(const char* str, unsigned int def);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOG_CHANNEL_H_
@@ -3,18 +3,315 @@
 * Date:		2017-12-25
 * Brief:	logfile
 **********************************************************************/
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     /* fallocate */
+#endif
 #include "logfile.h"
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/stat.h>
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#include "logtime.h"
+
+#define LOGFILE_MAX_PARTS       8           /* newline, date, tag and content of one record */
+#define LOGFILE_GATHER_SIZE     4096        /* stack buffer which gathers parts on windows */
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+/* same fields as struct iovec */
+typedef struct LogPart {
+    void* iov_base;
+    size_t iov_len;
+} LogPart;
+#else
+typedef struct iovec LogPart;
+#endif
+
+static int fileNo(FILE* fp) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    return _fileno(fp);
+#else
+    return fileno(fp);
+#endif
+}
+
+static size_t fileSize(FILE* fp) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    struct _stat st;
+    if (0 != _fstat(_fileno(fp), &st)) {
+        return 0;
+    }
+#else
+    struct stat st;
+    if (0 != fstat(fileno(fp), &st)) {
+        return 0;
+    }
+#endif
+    return (size_t)st.st_size;
+}
+
+/* bytes on disk for text written, file is opened in text mode so windows expands '\n' to "\r\n" */
+static size_t diskSize(const char* content, size_t length) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    size_t size = length;
+    const char* end = content + length;
+    while (content < end && (content = (const char*)memchr(content, '\n', end - content))) {
+        ++size;
+        ++content;
+    }
+    return size;
+#else
+    (void)content;
+    return length;
+#endif
+}
+
+/* open for append, on windows the file can be renamed while it is open, like on posix */
+static FILE* openFile(const char* filename, unsigned int binary) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    int fd = -1;
+    FILE* fp = NULL;
+    HANDLE file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == file) {
+        return NULL;
+    }
+    fd = _open_osfhandle((intptr_t)file, _O_RDWR | _O_APPEND | (binary ? _O_BINARY : _O_TEXT));
+    if (-1 == fd) {
+        CloseHandle(file);
+        return NULL;
+    }
+    fp = _fdopen(fd, binary ? "ab+" : "a+");
+    if (!fp) {
+        _close(fd);
+    }
+    return fp;
+#else
+    return fopen(filename, binary ? "ab+" : "a+");
+#endif
+}
+
+static unsigned long long monotonicNs(void) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (unsigned long long)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+/* data only sync where available, file size changes are flushed too since appends grow the file */
+static unsigned int syncFile(logfile_st* lf, unsigned int counted) {
+    unsigned long long begin = monotonicNs();
+    unsigned long long elapsed = 0;
+    int fd = fileNo(lf->fileptr);
+    int ok = 0;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    ok = FlushFileBuffers((HANDLE)_get_osfhandle(fd)) ? 1 : 0;
+#elif defined(__linux__)
+    ok = 0 == fdatasync(fd) ? 1 : 0;
+#else
+    ok = 0 == fsync(fd) ? 1 : 0;
+#endif
+    elapsed = monotonicNs() - begin;
+    lf->synctime = (begin + elapsed) / 1000000;
+    if (counted && lf->syncstats) {
+        ++lf->syncstats->syncs;
+        lf->syncstats->writes += lf->unsynced;
+        lf->syncstats->totalNs += elapsed;
+        if (elapsed > lf->syncstats->maxNs) {
+            lf->syncstats->maxNs = elapsed;
+        }
+    }
+    lf->unsynced = 0;
+    return ok ? 0 : 1;
+}
+
+static unsigned int syncDue(logfile_st* lf) {
+    if (0 == lf->unsynced) {
+        return 0;
+    }
+    switch (lf->syncpolicy) {
+    case LOGFILE_SYNC_INTERVAL:
+        return monotonicNs() / 1000000 >= lf->synctime + lf->syncinterval ? 1 : 0;
+    case LOGFILE_SYNC_RECORD:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void setPart(LogPart* part, const char* data, size_t length) {
+    part->iov_base = (void*)data;
+    part->iov_len = length;
+}
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+static size_t writeBuffer(int fd, const void* data, size_t length) {
+    int n = _write(fd, data, (unsigned int)length);
+    return n > 0 ? (size_t)n : 0;
+}
+#endif
+
+/* write parts as one record with one system call, records never pass through stdio buffers */
+static size_t writeParts(int fd, LogPart* parts, int count) {
+    size_t written = 0;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    char buf[LOGFILE_GATHER_SIZE];
+    size_t used = 0;
+    int i = 0;
+    for (i = 0; i < count; ++i) {
+        if (used + parts[i].iov_len > sizeof(buf)) {
+            if (used > 0) {
+                written += writeBuffer(fd, buf, used);
+                used = 0;
+            }
+            if (parts[i].iov_len > sizeof(buf)) {
+                written += writeBuffer(fd, parts[i].iov_base, parts[i].iov_len);
+                continue;
+            }
+        }
+        memcpy(buf + used, parts[i].iov_base, parts[i].iov_len);
+        used += parts[i].iov_len;
+    }
+    if (used > 0) {
+        written += writeBuffer(fd, buf, used);
+    }
+#else
+    int i = 0;
+    while (i < count) {
+        ssize_t n = writev(fd, parts + i, count - i);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            break;
+        }
+        written += (size_t)n;
+        /* short write, continue after the written bytes */
+        while (i < count && (size_t)n >= parts[i].iov_len) {
+            n -= (ssize_t)parts[i].iov_len;
+            ++i;
+        }
+        if (i < count) {
+            parts[i].iov_base = (char*)parts[i].iov_base + n;
+            parts[i].iov_len -= (size_t)n;
+        }
+    }
+#endif
+    return written;
+}
+
+/* entry for a write at offset, a failed entry only makes the index coarser */
+static void writeIndex(logfile_st* lf, size_t offset) {
+    logfile_index_st entry;
+    LogPart part;
+    entry.ms = logtime_now_ms();
+    entry.offset = (unsigned long long)offset;
+    setPart(&part, (const char*)&entry, sizeof(entry));
+    writeParts(fileNo(lf->indexptr), &part, 1);
+    lf->indexnext = offset + lf->indexinterval;
+}
+
+/* "[date] [tag] content", newline is written before the record when file is not empty */
+static unsigned int recordParts(logfile_st* lf, const char* tag, unsigned int withtime, const char* content, unsigned int newline) {
+    char date[LOGTIME_LENGTH + 4] = { 0 };
+    LogPart parts[LOGFILE_MAX_PARTS];
+    LogPart* first = parts + 1;         /* parts[0] is kept for the leading newline */
+    int count = 0;
+    size_t recordLength = 0;
+    size_t length = 0;
+    size_t disk = 0;
+    size_t start = 0;
+    int i = 0;
+    if (!lf->enable) {
+        return 1;
+    }
+    if (withtime) {
+        size_t dateLength = 0;
+        date[0] = '[';
+        dateLength = 1 + logtime_now(date + 1, sizeof(date) - 3, 0);
+        date[dateLength++] = ']';
+        date[dateLength++] = ' ';
+        setPart(&first[count++], date, dateLength);
+    }
+    if (tag) {
+        setPart(&first[count++], "[", 1);
+        setPart(&first[count++], tag, strlen(tag));
+        setPart(&first[count++], "] ", 2);
+    }
+    setPart(&first[count++], content, strlen(content));
+    for (i = 0; i < count; ++i) {
+        recordLength += first[i].iov_len;
+    }
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_lock(&lf->mutex);
+#endif
+    if (lf->filesize > 0) {
+        if (recordLength > lf->maxsize) {
+#ifdef LOGFILE_THREAD_SAFETY
+            pthread_mutex_unlock(&lf->mutex);
+#endif
+            return 2;
+        } else if (lf->filesize + 1 + recordLength >= lf->maxsize) {
+#ifdef LOGFILE_THREAD_SAFETY
+            pthread_mutex_unlock(&lf->mutex);
+#endif
+            return 3;
+        }
+    }
+    start = lf->filesize;
+    if (lf->filesize > 0 && newline) {
+        setPart(&parts[0], "\n", 1);
+        first = parts;
+        ++count;
+        start += diskSize("\n", 1);
+    }
+    if (lf->indexptr && start >= lf->indexnext) {
+        writeIndex(lf, start);
+    }
+    for (i = 0; i < count; ++i) {
+        disk += diskSize((const char*)first[i].iov_base, first[i].iov_len);
+        length += first[i].iov_len;
+    }
+    if (writeParts(fileNo(lf->fileptr), first, count) < length) {
+        /* short write, the size on disk is not known */
+        lf->filesize = fileSize(lf->fileptr);
+    } else {
+        lf->filesize += disk;
+    }
+    ++lf->unsynced;
+    if (syncDue(lf)) {
+        syncFile(lf, 1);
+    }
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_unlock(&lf->mutex);
+#endif
+    return 0;
+}
 
 logfile_st* logfile_open(const char* filename, size_t maxSize) {
     logfile_st* lf = NULL;
     FILE* fp = NULL;
     assert(filename && strlen(filename) > 0);
     assert(maxSize > 0);
-    fp = fopen(filename, "a+");
+    fp = openFile(filename, 0);
     if (!fp) {
         return NULL;
     }
@@ -32,7 +329,16 @@ logfile_st* logfile_open(const char* filename, size_t maxSize) {
     }
     sprintf(lf->filename, "%s", filename);
     lf->maxsize = maxSize;
+    lf->filesize = fileSize(fp);
     lf->enable = 1;
+    lf->syncpolicy = LOGFILE_SYNC_NONE;
+    lf->syncinterval = 0;
+    lf->synctime = monotonicNs() / 1000000;
+    lf->unsynced = 0;
+    lf->syncstats = NULL;
+    lf->indexptr = NULL;
+    lf->indexinterval = 0;
+    lf->indexnext = 0;
 #ifdef LOGFILE_THREAD_SAFETY
     pthread_mutex_init(&lf->mutex, NULL);
 #endif
@@ -46,6 +352,14 @@ void logfile_close(logfile_st* lf) {
 #ifdef LOGFILE_THREAD_SAFETY
     pthread_mutex_destroy(&lf->mutex);
 #endif
+    if (LOGFILE_SYNC_NONE != lf->syncpolicy && lf->unsynced > 0) {
+        /* may run in a background thread, statistics belong to the recording side */
+        syncFile(lf, 0);
+    }
+    if (lf->indexptr) {
+        fclose(lf->indexptr);
+        lf->indexptr = NULL;
+    }
     fclose(lf->fileptr);
     lf->fileptr = NULL;
     free(lf->filename);
@@ -65,10 +379,25 @@ unsigned int logfile_clear(logfile_st* lf) {
     lf->fileptr = NULL;
     fp = fopen(lf->filename, "w+");
     if (!fp) {
+#ifdef LOGFILE_THREAD_SAFETY
+        pthread_mutex_unlock(&lf->mutex);
+#endif
         return 1;
     }
     fclose(fp);
-    fp = fopen(lf->filename, "a+");
+    lf->filesize = 0;
+    lf->unsynced = 0;
+    if (lf->indexptr) {
+        /* the handle appends, truncate through it so a renamed index is truncated too */
+        fflush(lf->indexptr);
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+        _chsize_s(_fileno(lf->indexptr), 0);
+#else
+        ftruncate(fileno(lf->indexptr), 0);
+#endif
+        lf->indexnext = 0;
+    }
+    fp = openFile(lf->filename, 0);
     if (fp) {
         lf->fileptr = fp;
     }
@@ -78,6 +407,126 @@ unsigned int logfile_clear(logfile_st* lf) {
     return 0;
 }
 
+void logfile_preallocate(logfile_st* lf, size_t size) {
+    assert(lf);
+    assert(lf->fileptr);
+    if (size <= lf->filesize) {
+        return;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    {
+        FILE_ALLOCATION_INFO info;
+        info.AllocationSize.QuadPart = (LONGLONG)size;
+        SetFileInformationByHandle((HANDLE)_get_osfhandle(_fileno(lf->fileptr)), FileAllocationInfo, &info, sizeof(info));
+    }
+#elif defined(__linux__)
+    /* keep size, appends still start at the end of written data */
+    fallocate(fileno(lf->fileptr), FALLOC_FL_KEEP_SIZE, 0, (off_t)size);
+#endif
+}
+
+void logfile_setsync(logfile_st* lf, unsigned int policy, unsigned int interval, logfile_syncstats_st* stats) {
+    assert(lf);
+    assert(policy <= LOGFILE_SYNC_RECORD);
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_lock(&lf->mutex);
+#endif
+    lf->syncpolicy = policy;
+    lf->syncinterval = interval;
+    lf->syncstats = stats;
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_unlock(&lf->mutex);
+#endif
+}
+
+unsigned int logfile_sync(logfile_st* lf) {
+    unsigned int flag = 0;
+    assert(lf);
+    assert(lf->fileptr);
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_lock(&lf->mutex);
+#endif
+    if (lf->unsynced > 0) {
+        flag = syncFile(lf, 1);
+    }
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_unlock(&lf->mutex);
+#endif
+    return flag;
+}
+
+unsigned int logfile_commit(logfile_st* lf) {
+    unsigned int flag = 0;
+    assert(lf);
+    assert(lf->fileptr);
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_lock(&lf->mutex);
+#endif
+    if (syncDue(lf) || (LOGFILE_SYNC_GROUP == lf->syncpolicy && lf->unsynced > 0)) {
+        flag = syncFile(lf, 1);
+    }
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_unlock(&lf->mutex);
+#endif
+    return flag;
+}
+
+unsigned int logfile_setindex(logfile_st* lf, const char* indexFilename, size_t interval) {
+    char* filename = NULL;
+    FILE* fp = NULL;
+    assert(lf);
+    assert(lf->fileptr);
+    assert(interval > 0);
+    if (!indexFilename) {
+        filename = (char*)malloc(strlen(lf->filename) + strlen(LOGFILE_INDEX_EXT) + 1);
+        if (!filename) {
+            return 1;
+        }
+        sprintf(filename, "%s%s", lf->filename, LOGFILE_INDEX_EXT);
+        indexFilename = filename;
+    }
+    fp = openFile(indexFilename, 1);
+    free(filename);
+    if (!fp) {
+        return 1;
+    }
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_lock(&lf->mutex);
+#endif
+    if (lf->indexptr) {
+        fclose(lf->indexptr);
+    }
+    lf->indexptr = fp;
+    lf->indexinterval = interval;
+    /* the next write adds an entry, also when appending to an existing log */
+    lf->indexnext = 0;
+#ifdef LOGFILE_THREAD_SAFETY
+    pthread_mutex_unlock(&lf->mutex);
+#endif
+    return 0;
+}
+
+unsigned int logfile_rename(const char* filename, const char* newFilename) {
+    char* indexFilename = NULL;
+    char* newIndexFilename = NULL;
+    assert(filename);
+    assert(newFilename);
+    if (0 != rename(filename, newFilename)) {
+        return 1;
+    }
+    indexFilename = (char*)malloc(strlen(filename) + strlen(LOGFILE_INDEX_EXT) + 1);
+    newIndexFilename = (char*)malloc(strlen(newFilename) + strlen(LOGFILE_INDEX_EXT) + 1);
+    if (indexFilename && newIndexFilename) {
+        sprintf(indexFilename, "%s%s", filename, LOGFILE_INDEX_EXT);
+        sprintf(newIndexFilename, "%s%s", newFilename, LOGFILE_INDEX_EXT);
+        /* the log may have no index */
+        rename(indexFilename, newIndexFilename);
+    }
+    free(indexFilename);
+    free(newIndexFilename);
+    return 0;
+}
+
 const char* logfile_name(logfile_st* lf) {
     assert(lf);
     assert(lf->fileptr);
@@ -100,83 +549,26 @@ void logfile_enable(logfile_st* lf, unsigned int enable) {
 }
 
 unsigned int logfile_record(logfile_st* lf, const char* content, unsigned int newline) {
-    size_t fileSize = 0;
-    size_t contentLength = 0;
     assert(lf);
     assert(lf->fileptr);
     assert(lf->filename);
     assert(content);
-    if (!lf->enable) {
-        return 1;
-    }
-    contentLength = strlen(content);
-#ifdef LOGFILE_THREAD_SAFETY
-    pthread_mutex_lock(&lf->mutex);
-#endif
-    fseek(lf->fileptr, 0, SEEK_END);
-    fileSize = (size_t)ftell(lf->fileptr);
-    if (fileSize > 0) {
-        if (contentLength > lf->maxsize) {
-            return 2;
-        } else if (fileSize + 1 + contentLength >= lf->maxsize) {
-            return 3;
-        } else if (newline) {
-            fwrite("\n", 1, 1, lf->fileptr);
-        }
-    }
-    fwrite(content, contentLength, 1, lf->fileptr);
-    fflush(lf->fileptr);
-#ifdef LOGFILE_THREAD_SAFETY
-    pthread_mutex_unlock(&lf->mutex);
-#endif
-    return 0;
+    return recordParts(lf, NULL, 0, content, newline);
 }
 
 unsigned int logfile_record_with_time(logfile_st* lf, const char* content) {
-    time_t now;
-    struct tm t;
-    char date[32] = { 0 };
-    char* buf = NULL;
-    size_t contentLength = 0;
-    unsigned int flag = 0;
     assert(lf);
     assert(lf->fileptr);
     assert(lf->filename);
     assert(content);
-    if (!lf->enable) {
-        return 1;
-    }
-    contentLength = strlen(content);
-    time(&now);
-    t = *localtime(&now);
-    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &t);
-    buf = (char*)malloc(1 + strlen(date) + 2 + contentLength + 1);
-    sprintf(buf, "[%s] %s", date, content);
-    flag = logfile_record(lf, buf, 1);
-    free(buf);
-    return flag;
+    return recordParts(lf, NULL, 1, content, 1);
 }
 
 unsigned int logfile_record_with_tag(logfile_st* lf, const char* tag, unsigned int withtime, const char* content) {
-    size_t contentLength = 0;
-    char* buf = NULL;
-    unsigned int flag = 0;
     assert(lf);
     assert(lf->fileptr);
     assert(lf->filename);
     assert(tag && strlen(tag) > 0);
     assert(content);
-    if (!lf->enable) {
-        return 1;
-    }
-    contentLength = strlen(content);
-    buf = (char*)malloc(1 + strlen(tag) + 2 + contentLength + 1);
-    sprintf(buf, "[%s] %s", tag, content);
-    if (withtime) {
-        flag = logfile_record_with_time(lf, buf);
-    } else {
-        flag = logfile_record(lf, buf, 1);
-    }
-    free(buf);
-    return flag;
+    return recordParts(lf, tag, withtime, content, 1);
 }
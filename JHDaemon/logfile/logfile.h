@@ -12,16 +12,51 @@
 #include <pthread.h>
 #endif
 
+/* durability policy, when written records are synced to disk */
+#define LOGFILE_SYNC_NONE       0       /* never, the system writes back when it wants */
+#define LOGFILE_SYNC_INTERVAL   1       /* when interval passed since last sync, checked on record and on commit */
+#define LOGFILE_SYNC_GROUP      2       /* once for all records of a batch, on commit by the batching writer */
+#define LOGFILE_SYNC_RECORD     3       /* after every record */
+
+/*
+ * sidecar index "filename.idx", an array of logfile_index_st appended every interval bytes
+ * of log, each entry is taken when a write starts at offset, so every record before offset
+ * is older than ms, a reader binary searches it instead of scanning the log
+ */
+#define LOGFILE_INDEX_EXT               ".idx"
+#define LOGFILE_INDEX_DEFAULT_INTERVAL  64*1024L
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+typedef struct logfile_syncstats_st {
+    unsigned long long syncs;           /* syncs done, syncs at close are not counted */
+    unsigned long long writes;          /* writes covered by the syncs */
+    unsigned long long totalNs;         /* total sync time */
+    unsigned long long maxNs;           /* longest sync */
+} logfile_syncstats_st;
+
+typedef struct logfile_index_st {
+    unsigned long long ms;              /* write time, milliseconds since 1970-01-01 00:00:00 */
+    unsigned long long offset;          /* file offset of the write */
+} logfile_index_st;
+
 typedef struct logfile_st {
     FILE* fileptr;
     char* filename;
     size_t maxsize;
+    size_t filesize;            /* current file size, taken at open and counted on write, writes by others are not seen */
     unsigned int enable;
+    unsigned int syncpolicy;            /* LOGFILE_SYNC_XXX */
+    unsigned int syncinterval;          /* milliseconds, for LOGFILE_SYNC_INTERVAL */
+    unsigned long long synctime;        /* monotonic milliseconds of last sync */
+    unsigned long long unsynced;        /* writes since last sync */
+    logfile_syncstats_st* syncstats;    /* can be NULL */
+    FILE* indexptr;                     /* sidecar index, NULL when not indexed */
+    size_t indexinterval;
+    size_t indexnext;                   /* next write at or after this offset adds an entry */
 #ifdef LOGFILE_THREAD_SAFETY
     pthread_mutex_t mutex;
 #endif
@@ -50,6 +85,62 @@ extern void logfile_close(logfile_st* lf);
  */
 extern unsigned int logfile_clear(logfile_st* lf);
 
+/*
+ * Brief:	reserve disk blocks for a logfile without changing its size, so later writes do not
+ *          allocate, ignored where not supported
+ * Param:	lf - a log file
+ *          size - bytes to reserve from file begin
+ * Return:	void
+ */
+extern void logfile_preallocate(logfile_st* lf, size_t size);
+
+/*
+ * Brief:	set durability policy, a file closed with unsynced writes is synced first
+ * Param:	lf - a log file
+ *          policy - LOGFILE_SYNC_XXX
+ *          interval - milliseconds between syncs, for LOGFILE_SYNC_INTERVAL
+ *          stats - sync statistics updated by this file, can be NULL, can be shared by consecutive files
+ * Return:	void
+ */
+extern void logfile_setsync(logfile_st* lf, unsigned int policy, unsigned int interval, logfile_syncstats_st* stats);
+
+/*
+ * Brief:	sync unsynced writes to disk now, whatever the policy
+ * Param:	lf - a log file
+ * Return:	0.ok or nothing to sync
+ *          1.sync fail
+ */
+extern unsigned int logfile_sync(logfile_st* lf);
+
+/*
+ * Brief:	called by a batching writer after each batch and when idle, LOGFILE_SYNC_GROUP syncs
+ *          unsynced writes, LOGFILE_SYNC_INTERVAL syncs when interval passed, others do nothing
+ * Param:	lf - a log file
+ * Return:	0.ok or nothing to sync
+ *          1.sync fail
+ */
+extern unsigned int logfile_commit(logfile_st* lf);
+
+/*
+ * Brief:	write a sidecar index for the logfile, appended when it exists, entries cover writes
+ *          after this call, the index is truncated with the logfile and closed with it
+ * Param:	lf - a log file
+ *          indexFilename - index file name, NULL means logfile name + LOGFILE_INDEX_EXT
+ *          interval - min bytes of log between entries, e.g. LOGFILE_INDEX_DEFAULT_INTERVAL
+ * Return:	0.ok
+ *          1.can not open index file
+ */
+extern unsigned int logfile_setindex(logfile_st* lf, const char* indexFilename, size_t interval);
+
+/*
+ * Brief:	rename a closed or open log file together with its sidecar index
+ * Param:	filename - log file name
+ *          newFilename - new log file name
+ * Return:	0.ok
+ *          1.rename log file fail, the index is not renamed
+ */
+extern unsigned int logfile_rename(const char* filename, const char* newFilename);
+
 /*
  * Brief:	get a logfile name
  * Param:	lf - a log file
@@ -0,0 +1,401 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	asynchronous logfile, records are copied into a lock-free
+*           ring and written to a logfile wrapper by a writer thread,
+*           one ring and thread can serve many wrappers
+**********************************************************************/
+#include "logfileasync.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logtime.h"
+
+#define LOGFILE_ASYNC_ALIGN         8               /* record alignment in the ring */
+#define LOGFILE_ASYNC_MIN_CAPACITY  4096
+#define LOGFILE_ASYNC_BATCH_SIZE    64*1024         /* bytes collected before one write */
+#define LOGFILE_ASYNC_IDLE_WAIT     50              /* milliseconds the writer sleeps when nothing is signaled */
+
+/* commit state of a ring record */
+enum LogRecordCommit {
+    LRC_EMPTY = 0,      /* reserved, producer still copying */
+    LRC_RECORD,         /* record ready */
+    LRC_PADDING         /* unused tail of the ring, skipped */
+};
+
+/* record head, a padding record only has the head */
+struct LogRecordHead {
+    std::atomic<unsigned int> commit;
+    unsigned int size;                  /* total size including head, multiple of LOGFILE_ASYNC_ALIGN */
+};
+
+/* record meta, follows the head, then tag and content */
+struct LogRecordMeta {
+    logfilewrapper_st* wrapper;         /* target of the record */
+    unsigned long long time;            /* milliseconds since 1970-01-01 00:00:00 */
+    unsigned int contentLength;
+    unsigned short tagLength;
+    unsigned char withtime;
+};
+
+struct logfileasync_st {
+    logfileasync_st(void) : wrapper(NULL), policy(LOGFILE_ASYNC_BLOCK), ring(NULL), capacity(0),
+                            reserve(0), release(0), written(0), sleeping(false), exit(false), pendingDropped(0),
+                            recorded(0), dropped(0), failed(0), blocked(0), batches(0), bytes(0) {}
+    logfilewrapper_st* wrapper;                     /* target of logfileasync_record, NULL for a shared ring */
+    std::vector<logfilewrapper_st*> attached;       /* targets of logfileasync_recordto */
+    std::mutex attachMutex;                         /* guards attached, held while the writer commits them */
+    unsigned int policy;
+    unsigned char* ring;
+    size_t capacity;                                /* power of 2 */
+    std::atomic<unsigned long long> reserve;        /* producers reserve space from here */
+    std::atomic<unsigned long long> release;        /* ring before here is free */
+    std::atomic<unsigned long long> written;        /* records before here are written to the wrapper */
+    std::atomic<bool> sleeping;                     /* writer is waiting on wakeCondition */
+    std::atomic<bool> exit;
+    std::atomic<unsigned long long> pendingDropped; /* dropped records not yet reported, LOGFILE_ASYNC_COUNT */
+    std::mutex mutex;
+    std::condition_variable wakeCondition;          /* writer waits for records */
+    std::condition_variable doneCondition;          /* flush and blocked producers wait for the writer */
+    std::thread thread;
+    std::atomic<unsigned long long> recorded;
+    std::atomic<unsigned long long> dropped;
+    std::atomic<unsigned long long> failed;
+    std::atomic<unsigned long long> blocked;
+    std::atomic<unsigned long long> batches;
+    std::atomic<unsigned long long> bytes;
+};
+
+static size_t alignSize(size_t size) {
+    return (size + LOGFILE_ASYNC_ALIGN - 1) & ~(size_t)(LOGFILE_ASYNC_ALIGN - 1);
+}
+
+static LogRecordHead* recordHead(logfileasync_st* la, unsigned long long pos) {
+    return (LogRecordHead*)(la->ring + (pos & (la->capacity - 1)));
+}
+
+static void wakeWriter(logfileasync_st* la) {
+    if (la->sleeping.load() && la->sleeping.exchange(false)) {
+        std::lock_guard<std::mutex> lock(la->mutex);
+        la->wakeCondition.notify_one();
+    }
+}
+
+/* zero the consumed part so stale bytes are never taken as a committed head */
+static void clearRing(logfileasync_st* la, unsigned long long begin, unsigned long long end) {
+    size_t offset = (size_t)(begin & (la->capacity - 1));
+    size_t length = (size_t)(end - begin);
+    if (offset + length <= la->capacity) {
+        memset(la->ring + offset, 0, length);
+    } else {
+        memset(la->ring + offset, 0, la->capacity - offset);
+        memset(la->ring, 0, length - (la->capacity - offset));
+    }
+}
+
+static void appendRecord(std::string& batch, const LogRecordMeta& meta, LogRecordHead* head) {
+    const char* text = (const char*)(head + 1) + sizeof(meta);
+    if (meta.withtime) {
+        char date[32] = { 0 };
+        date[0] = '[';
+        size_t dateLength = 1 + logtime_format(meta.time, date + 1, sizeof(date) - 3, 1);
+        date[dateLength++] = ']';
+        date[dateLength++] = ' ';
+        batch.append(date, dateLength);
+    }
+    if (meta.tagLength > 0) {
+        batch.append("[");
+        batch.append(text, meta.tagLength);
+        batch.append("] ");
+    }
+    batch.append(text + meta.tagLength, meta.contentLength);
+}
+
+static void appendDropped(std::string& batch, unsigned long long droppedCount) {
+    char buf[64] = { 0 };
+    sprintf(buf, "[LOGFILE] %llu records dropped\n", droppedCount);
+    batch.append(buf);
+}
+
+/* write the records collected for one wrapper, it is committed once at the end of the pass */
+static void writeBatch(logfileasync_st* la, logfilewrapper_st* wrapper, std::string& batch, unsigned long long& batchRecords, std::vector<logfilewrapper_st*>& touched) {
+    if (batch.empty()) {
+        return;
+    }
+    /* the file of a wrapper is only touched here, it is closed and reopened when the wrapper rotates */
+    unsigned int flag = logfilewrapper_record(wrapper, NULL, 0, batch.c_str());
+    if (0 == flag) {
+        la->batches.fetch_add(1, std::memory_order_relaxed);
+        la->bytes.fetch_add(batch.size(), std::memory_order_relaxed);
+    } else if (1 != flag) {
+        la->failed.fetch_add(batchRecords, std::memory_order_relaxed);
+    }
+    if (touched.end() == std::find(touched.begin(), touched.end(), wrapper)) {
+        touched.push_back(wrapper);
+    }
+    batch.clear();
+    batchRecords = 0;
+}
+
+/* append a rendered record, the batch is written first when the record would take it over the file size */
+static void appendBatch(logfileasync_st* la, logfilewrapper_st* wrapper, std::string& batch, unsigned long long& batchRecords, const std::string& record, std::vector<logfilewrapper_st*>& touched) {
+    if (!batch.empty() && wrapper->logfile && batch.size() + record.size() > wrapper->logfile->maxsize) {
+        writeBatch(la, wrapper, batch, batchRecords, touched);
+    }
+    batch.append(record);
+    ++batchRecords;
+}
+
+static void writerLoop(logfileasync_st* la) {
+    std::string batch;
+    std::string record;
+    std::vector<logfilewrapper_st*> touched;
+    unsigned long long batchRecords = 0;
+    unsigned long long droppedCount = 0;
+    batch.reserve(LOGFILE_ASYNC_BATCH_SIZE * 2);
+    while (1) {
+        unsigned long long begin = la->release.load(std::memory_order_relaxed);
+        unsigned long long end = la->reserve.load(std::memory_order_acquire);
+        unsigned long long pos = begin;
+        logfilewrapper_st* target = NULL;
+        droppedCount += la->pendingDropped.exchange(0);
+        if (droppedCount > 0 && la->wrapper) {
+            target = la->wrapper;
+            appendDropped(batch, droppedCount);
+            droppedCount = 0;
+        }
+        while (pos < end && pos - begin < LOGFILE_ASYNC_BATCH_SIZE) {
+            LogRecordHead* head = recordHead(la, pos);
+            unsigned int commit = head->commit.load();
+            if (LRC_EMPTY == commit) {
+                break;
+            }
+            if (LRC_RECORD == commit) {
+                LogRecordMeta meta;
+                memcpy(&meta, head + 1, sizeof(meta));
+                /* consecutive records of one wrapper are written together */
+                if (meta.wrapper != target) {
+                    writeBatch(la, target, batch, batchRecords, touched);
+                    target = meta.wrapper;
+                    /* a shared ring reports drops to the wrapper written next */
+                    if (droppedCount > 0) {
+                        appendDropped(batch, droppedCount);
+                        droppedCount = 0;
+                    }
+                }
+                record.clear();
+                appendRecord(record, meta, head);
+                appendBatch(la, target, batch, batchRecords, record, touched);
+            }
+            pos += head->size;
+        }
+        if (pos != begin) {
+            clearRing(la, begin, pos);
+            la->release.store(pos, std::memory_order_release);
+        }
+        writeBatch(la, target, batch, batchRecords, touched);
+        /* group commit, one sync per wrapper for every record of the pass, before the records count as written */
+        for (size_t i = 0, len = touched.size(); i < len; ++i) {
+            logfilewrapper_commit(touched[i]);
+        }
+        touched.clear();
+        if (pos != begin) {
+            la->written.store(pos, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(la->mutex);
+            la->doneCondition.notify_all();
+            continue;
+        }
+        if (la->exit.load() && pos == la->reserve.load(std::memory_order_acquire)) {
+            break;
+        }
+        /* idle, an interval sync which came due since the last batch is done now */
+        if (la->wrapper) {
+            logfilewrapper_commit(la->wrapper);
+        }
+        {
+            std::lock_guard<std::mutex> attachLock(la->attachMutex);
+            for (size_t i = 0, len = la->attached.size(); i < len; ++i) {
+                logfilewrapper_commit(la->attached[i]);
+            }
+        }
+        /* nothing ready, sleep until a producer signals, recheck after announcing to close the race */
+        std::unique_lock<std::mutex> lock(la->mutex);
+        la->sleeping.store(true);
+        if (la->exit.load() || (la->wrapper && la->pendingDropped.load() > 0) ||
+            (pos < la->reserve.load() && LRC_EMPTY != recordHead(la, pos)->commit.load())) {
+            la->sleeping.store(false);
+            continue;
+        }
+        la->wakeCondition.wait_for(lock, std::chrono::milliseconds(LOGFILE_ASYNC_IDLE_WAIT), [la]()->bool {
+            return !la->sleeping.load() || la->exit.load();
+        });
+        la->sleeping.store(false);
+    }
+}
+
+logfileasync_st* logfileasync_open(logfilewrapper_st* wrapper, size_t capacity, unsigned int policy) {
+    logfileasync_st* la = NULL;
+    size_t ringSize = LOGFILE_ASYNC_MIN_CAPACITY;
+    while (ringSize < capacity) {
+        ringSize <<= 1;
+    }
+    la = new (std::nothrow) logfileasync_st();
+    if (!la) {
+        return NULL;
+    }
+    la->ring = (unsigned char*)(new (std::nothrow) unsigned long long[ringSize / sizeof(unsigned long long)]());
+    if (!la->ring) {
+        delete la;
+        return NULL;
+    }
+    la->wrapper = wrapper;
+    la->policy = policy;
+    la->capacity = ringSize;
+    la->thread = std::thread(writerLoop, la);
+    return la;
+}
+
+void logfileasync_close(logfileasync_st* la) {
+    assert(la);
+    logfileasync_flush(la);
+    la->exit.store(true);
+    {
+        std::lock_guard<std::mutex> lock(la->mutex);
+        la->wakeCondition.notify_one();
+    }
+    la->thread.join();
+    delete[] (unsigned long long*)la->ring;
+    la->ring = NULL;
+    delete la;
+}
+
+unsigned int logfileasync_attach(logfileasync_st* la, logfilewrapper_st* wrapper) {
+    assert(la);
+    assert(wrapper);
+    std::lock_guard<std::mutex> attachLock(la->attachMutex);
+    la->attached.push_back(wrapper);
+    return 0;
+}
+
+void logfileasync_detach(logfileasync_st* la, logfilewrapper_st* wrapper) {
+    assert(la);
+    assert(wrapper);
+    logfileasync_flush(la);
+    std::lock_guard<std::mutex> attachLock(la->attachMutex);
+    std::vector<logfilewrapper_st*>::iterator iter = std::find(la->attached.begin(), la->attached.end(), wrapper);
+    if (la->attached.end() != iter) {
+        la->attached.erase(iter);
+    }
+}
+
+unsigned int logfileasync_record(logfileasync_st* la, const char* tag, unsigned int withtime, const char* content) {
+    assert(la);
+    assert(la->wrapper);
+    return logfileasync_recordto(la, la->wrapper, tag, withtime, content);
+}
+
+unsigned int logfileasync_recordto(logfileasync_st* la, logfilewrapper_st* wrapper, const char* tag, unsigned int withtime, const char* content) {
+    size_t tagLength = 0;
+    size_t contentLength = 0;
+    size_t size = 0;
+    unsigned long long pos = 0;
+    bool waited = false;
+    assert(la);
+    assert(wrapper);
+    assert(content);
+    if (tag) {
+        tagLength = strlen(tag);
+        if (tagLength > 0xFFFF) {
+            tagLength = 0xFFFF;
+        }
+    }
+    contentLength = strlen(content);
+    size = alignSize(sizeof(LogRecordHead) + sizeof(LogRecordMeta) + tagLength + contentLength);
+    if (size > la->capacity / 2) {
+        return 2;
+    }
+    /* reserve space, a record never wraps, the ring tail is filled with a padding record instead */
+    while (1) {
+        size_t offset = 0;
+        size_t pad = 0;
+        pos = la->reserve.load(std::memory_order_relaxed);
+        offset = (size_t)(pos & (la->capacity - 1));
+        pad = la->capacity - offset < size ? la->capacity - offset : 0;
+        if (pos + pad + size - la->release.load(std::memory_order_acquire) > la->capacity) {
+            if (LOGFILE_ASYNC_BLOCK != la->policy) {
+                la->dropped.fetch_add(1, std::memory_order_relaxed);
+                if (LOGFILE_ASYNC_COUNT == la->policy) {
+                    la->pendingDropped.fetch_add(1);
+                }
+                return 3;
+            }
+            if (!waited) {
+                waited = true;
+                la->blocked.fetch_add(1, std::memory_order_relaxed);
+            }
+            wakeWriter(la);
+            std::unique_lock<std::mutex> lock(la->mutex);
+            la->doneCondition.wait_for(lock, std::chrono::milliseconds(1));
+            continue;
+        }
+        if (la->reserve.compare_exchange_weak(pos, pos + pad + size, std::memory_order_relaxed)) {
+            if (pad > 0) {
+                LogRecordHead* padding = recordHead(la, pos);
+                padding->size = (unsigned int)pad;
+                padding->commit.store(LRC_PADDING, std::memory_order_release);
+                pos += pad;
+            }
+            break;
+        }
+    }
+    LogRecordHead* head = recordHead(la, pos);
+    LogRecordMeta meta;
+    meta.wrapper = wrapper;
+    meta.time = withtime ? logtime_now_ms() : 0;
+    meta.contentLength = (unsigned int)contentLength;
+    meta.tagLength = (unsigned short)tagLength;
+    meta.withtime = withtime ? 1 : 0;
+    head->size = (unsigned int)size;
+    memcpy((char*)(head + 1), &meta, sizeof(meta));
+    if (tagLength > 0) {
+        memcpy((char*)(head + 1) + sizeof(meta), tag, tagLength);
+    }
+    memcpy((char*)(head + 1) + sizeof(meta) + tagLength, content, contentLength);
+    head->commit.store(LRC_RECORD);
+    la->recorded.fetch_add(1, std::memory_order_relaxed);
+    wakeWriter(la);
+    return 0;
+}
+
+void logfileasync_flush(logfileasync_st* la) {
+    unsigned long long target = 0;
+    assert(la);
+    target = la->reserve.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(la->mutex);
+    while (la->written.load(std::memory_order_acquire) < target) {
+        la->sleeping.store(false);
+        la->wakeCondition.notify_one();
+        la->doneCondition.wait_for(lock, std::chrono::milliseconds(LOGFILE_ASYNC_IDLE_WAIT));
+    }
+}
+
+void logfileasync_stats(logfileasync_st* la, logfileasync_stats_st* stats) {
+    assert(la);
+    assert(stats);
+    stats->recorded = la->recorded.load(std::memory_order_relaxed);
+    stats->dropped = la->dropped.load(std::memory_order_relaxed);
+    stats->failed = la->failed.load(std::memory_order_relaxed);
+    stats->blocked = la->blocked.load(std::memory_order_relaxed);
+    stats->batches = la->batches.load(std::memory_order_relaxed);
+    stats->bytes = la->bytes.load(std::memory_order_relaxed);
+}
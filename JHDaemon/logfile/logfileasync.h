@@ -0,0 +1,119 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	asynchronous logfile, records are copied into a lock-free
+*           ring and written to a logfile wrapper by a writer thread,
+*           one ring and thread can serve many wrappers
+**********************************************************************/
+#ifndef _LOGFILE_ASYNC_H_
+#define _LOGFILE_ASYNC_H_
+
+#include "logfilewrapper.h"
+
+#define LOGFILE_ASYNC_DEFAULT_CAPACITY  1024*1024L
+
+/* overflow policy, what a producer does when the ring is full */
+#define LOGFILE_ASYNC_BLOCK     0       /* wait until the writer frees space */
+#define LOGFILE_ASYNC_DROP      1       /* drop the record */
+#define LOGFILE_ASYNC_COUNT     2       /* drop the record, the writer logs how many were dropped */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logfileasync_st logfileasync_st;
+
+typedef struct logfileasync_stats_st {
+    unsigned long long recorded;        /* records put into the ring */
+    unsigned long long dropped;         /* records dropped on overflow */
+    unsigned long long failed;          /* records the wrapper did not write, e.g. larger than the file size */
+    unsigned long long blocked;         /* records which waited for space */
+    unsigned long long batches;         /* writes to the logfile wrapper */
+    unsigned long long bytes;           /* bytes written to the logfile wrapper */
+} logfileasync_stats_st;
+
+/*
+ * Brief:	start asynchronous logging to a logfile wrapper, the wrapper must not be used
+ *          directly until logfileasync_close
+ * Param:	wrapper - logfile wrapper of logfileasync_record, NULL for a ring shared by wrappers
+ *                    given to logfileasync_attach
+ *          capacity - ring size in bytes, rounded up to power of 2
+ *          policy - overflow policy, LOGFILE_ASYNC_XXX
+ * Return:	logfileasync_st*
+ */
+extern logfileasync_st* logfileasync_open(logfilewrapper_st* wrapper, size_t capacity, unsigned int policy);
+
+/*
+ * Brief:	flush pending records and stop the writer thread, wrapper is not closed
+ * Param:	la - asynchronous logfile
+ * Return:	void
+ */
+extern void logfileasync_close(logfileasync_st* la);
+
+/*
+ * Brief:	add a wrapper to the targets of logfileasync_recordto, it is written and committed by
+ *          the writer thread and must not be used directly until logfileasync_detach
+ * Param:	la - asynchronous logfile
+ *          wrapper - logfile wrapper
+ * Return:	0.ok
+ */
+extern unsigned int logfileasync_attach(logfileasync_st* la, logfilewrapper_st* wrapper);
+
+/*
+ * Brief:	write pending records of every target and remove wrapper from the targets, the wrapper
+ *          can be closed after this call when no thread records to it any more
+ * Param:	la - asynchronous logfile
+ *          wrapper - logfile wrapper
+ * Return:	void
+ */
+extern void logfileasync_detach(logfileasync_st* la, logfilewrapper_st* wrapper);
+
+/*
+ * Brief:	record log, can be called in any thread, time is taken now and formatted by the writer,
+ *          content is written as "[YYYY-mm-dd HH:MM:SS.mmm] [tag] content" without adding a newline,
+ *          the writer discards records of a disabled wrapper, records the wrapper fails to write
+ *          are counted in failed of logfileasync_stats
+ * Param:	la - asynchronous logfile
+ *          tag - record tag, can be NULL
+ *          withtime - with time, 0.false, 1.true
+ *          content - record content
+ * Return:	0.ok
+ *          2.content size large than ring
+ *          3.ring is full, record dropped
+ */
+extern unsigned int logfileasync_record(logfileasync_st* la, const char* tag, unsigned int withtime, const char* content);
+
+/*
+ * Brief:	record log to an attached wrapper, same as logfileasync_record, consecutive records of one
+ *          wrapper are written in one batch and a dropped record is reported to the wrapper written next
+ * Param:	la - asynchronous logfile
+ *          wrapper - attached logfile wrapper
+ *          tag - record tag, can be NULL
+ *          withtime - with time, 0.false, 1.true
+ *          content - record content
+ * Return:	same as logfileasync_record
+ */
+extern unsigned int logfileasync_recordto(logfileasync_st* la, logfilewrapper_st* wrapper, const char* tag, unsigned int withtime, const char* content);
+
+/*
+ * Brief:	wait until every record put before this call is written to the wrapper, and synced to disk
+ *          when the wrapper uses LOGFILE_SYNC_GROUP
+ * Param:	la - asynchronous logfile
+ * Return:	void
+ */
+extern void logfileasync_flush(logfileasync_st* la);
+
+/*
+ * Brief:	get statistics
+ * Param:	la - asynchronous logfile
+ *          stats - output statistics
+ * Return:	void
+ */
+extern void logfileasync_stats(logfileasync_st* la, logfileasync_stats_st* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOGFILE_ASYNC_H_
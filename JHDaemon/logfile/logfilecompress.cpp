@@ -0,0 +1,562 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	rotated logfile compressor, rotated files are queued in O(1)
+*           and compressed by one low priority background thread shared by
+*           every compressor, old rotated files are removed by count and
+*           total size
+**********************************************************************/
+#include "logfilecompress.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <Windows.h>
+#ifndef LOGFILE_HAVE_ZLIB
+#include <wofapi.h>
+#pragma comment(lib, "Wofutil.lib")
+#endif
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+#ifdef LOGFILE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "logfile.h"
+
+#define LOGFILE_COMPRESS_CHUNK  64*1024         /* bytes compressed between budget checks */
+#define LOGFILE_PACKED_EXT      ".gz"
+#define LOGFILE_TEMP_EXT        ".tmp"
+
+/* rotated file on disk */
+struct RotatedFile {
+    std::string name;                           /* without directory */
+    std::string filename;
+    unsigned long long size;                    /* size on disk */
+    long long mtime;
+};
+
+struct logfilecompress_st {
+    logfilecompress_st(void) : maxCount(0), maxBytes(0), cpuPercent(100), busy(false), exit(false),
+                               compressed(0), bytesIn(0), bytesOut(0), removed(0) {}
+    std::string dirname;                        /* with trailing separator, empty for current directory */
+    std::string prefix;                         /* file name part of basename + "_" */
+    std::string extname;                        /* with leading '.' */
+    unsigned int maxCount;
+    unsigned long long maxBytes;
+    unsigned int cpuPercent;
+    bool busy;                                  /* the worker is working on it, guarded by s_worker.mutex */
+    std::atomic<bool> exit;
+    std::atomic<unsigned long long> compressed;
+    std::atomic<unsigned long long> bytesIn;
+    std::atomic<unsigned long long> bytesOut;
+    std::atomic<unsigned long long> removed;
+};
+
+/* rotated file to compress, an empty file name scans leftovers of a previous run */
+struct CompressJob {
+    logfilecompress_st* lc;
+    std::string filename;
+};
+
+/* one background thread serves every compressor, thousands of files need no thread each */
+struct CompressWorker {
+    CompressWorker(void) : users(0), exit(false) {}
+    std::mutex mutex;                           /* guards the worker and the busy flags */
+    std::condition_variable condition;          /* wakes the worker, also ends its budget sleep */
+    std::condition_variable idleCondition;      /* wakes closes waiting for the worker to leave a compressor */
+    std::deque<CompressJob> queue;
+    unsigned int users;                         /* open compressors, guarded by s_lifeMutex */
+    bool exit;
+    std::thread thread;
+};
+
+static CompressWorker s_worker;
+static std::mutex s_lifeMutex;                  /* start and stop of the worker */
+
+static bool endsWith(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() && 0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
+}
+
+/* "prefix" + digit ... + extname, optionally followed by packed or temp extension */
+static bool isRotatedName(logfilecompress_st* lc, const std::string& name) {
+    if (name.size() <= lc->prefix.size() || 0 != name.compare(0, lc->prefix.size(), lc->prefix)) {
+        return false;
+    }
+    char c = name[lc->prefix.size()];
+    if (c < '0' || c > '9') {
+        return false;
+    }
+    return endsWith(name, lc->extname) || endsWith(name, lc->extname + LOGFILE_PACKED_EXT) ||
+           endsWith(name, lc->extname + LOGFILE_PACKED_EXT + LOGFILE_TEMP_EXT);
+}
+
+static void setBackgroundPriority(void) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    /* lowers both cpu and io priority of this thread */
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#else
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);
+#ifdef SYS_ioprio_set
+    /* IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE, only the calling thread */
+    syscall(SYS_ioprio_set, 1, (int)tid, 3 << 13);
+#endif
+#endif
+}
+
+/* regular files of dirname starting with pattern and accepted by accept, accept gets the name without directory */
+template <typename Accept>
+static std::vector<RotatedFile> listFiles(const std::string& dirname, const std::string& pattern, Accept accept) {
+    std::vector<RotatedFile> files;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dirname + pattern + "*").c_str(), &data);
+    if (INVALID_HANDLE_VALUE == find) {
+        return files;
+    }
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !accept(std::string(data.cFileName))) {
+            continue;
+        }
+        RotatedFile file;
+        DWORD high = 0;
+        file.name = data.cFileName;
+        file.filename = dirname + file.name;
+        /* compressed size when the file system compressed it */
+        DWORD low = GetCompressedFileSizeA(file.filename.c_str(), &high);
+        if (INVALID_FILE_SIZE == low && NO_ERROR != GetLastError()) {
+            low = data.nFileSizeLow;
+            high = data.nFileSizeHigh;
+        }
+        file.size = ((unsigned long long)high << 32) | low;
+        file.mtime = (long long)(((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+        files.push_back(file);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    (void)pattern;  /* accept filters the names */
+    DIR* dir = opendir(dirname.empty() ? "." : dirname.c_str());
+    if (!dir) {
+        return files;
+    }
+    struct dirent* entry = NULL;
+    while (NULL != (entry = readdir(dir))) {
+        struct stat st;
+        RotatedFile file;
+        file.name = entry->d_name;
+        if (!accept(file.name)) {
+            continue;
+        }
+        file.filename = dirname + file.name;
+        if (0 != stat(file.filename.c_str(), &st) || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        file.size = (unsigned long long)st.st_size;
+        file.mtime = (long long)st.st_mtime;
+        files.push_back(file);
+    }
+    closedir(dir);
+#endif
+    return files;
+}
+
+/* oldest first, the name carries the rotation time when mtime is equal */
+static void sortOldest(std::vector<RotatedFile>& files) {
+    std::sort(files.begin(), files.end(), [](const RotatedFile& a, const RotatedFile& b)->bool {
+        return a.mtime != b.mtime ? a.mtime < b.mtime : a.filename < b.filename;
+    });
+}
+
+static std::vector<RotatedFile> listRotated(logfilecompress_st* lc) {
+    std::vector<RotatedFile> files = listFiles(lc->dirname, lc->prefix, [lc](const std::string& name)->bool {
+        return isRotatedName(lc, name);
+    });
+    sortOldest(files);
+    return files;
+}
+
+#if defined(LOGFILE_HAVE_ZLIB) || defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+/* sleep after busy time so the thread stays within its cpu budget */
+static void keepBudget(logfilecompress_st* lc, std::chrono::steady_clock::duration busy) {
+    if (lc->cpuPercent >= 100) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(s_worker.mutex);
+    s_worker.condition.wait_for(lock, busy * (100 - lc->cpuPercent) / lc->cpuPercent, [lc]()->bool {
+        return lc->exit.load();
+    });
+}
+#endif
+
+#ifdef LOGFILE_HAVE_ZLIB
+static bool isPacked(const std::string& filename) {
+    return endsWith(filename, LOGFILE_PACKED_EXT);
+}
+
+/* stream into "file.gz.tmp" chunk by chunk, then replace the original */
+static bool packFile(logfilecompress_st* lc, const std::string& filename) {
+    std::string packedFilename = filename + LOGFILE_PACKED_EXT;
+    std::string tempFilename = packedFilename + LOGFILE_TEMP_EXT;
+    FILE* src = fopen(filename.c_str(), "rb");
+    if (!src) {
+        return false;
+    }
+    FILE* dst = fopen(tempFilename.c_str(), "wb");
+    if (!dst) {
+        fclose(src);
+        return false;
+    }
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    /* window bits 15 + 16 writes a gzip header */
+    if (Z_OK != deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY)) {
+        fclose(src);
+        fclose(dst);
+        remove(tempFilename.c_str());
+        return false;
+    }
+    std::vector<unsigned char> in(LOGFILE_COMPRESS_CHUNK);
+    std::vector<unsigned char> out(LOGFILE_COMPRESS_CHUNK);
+    unsigned long long bytesIn = 0;
+    unsigned long long bytesOut = 0;
+    bool ok = true;
+    int flush = Z_NO_FLUSH;
+    while (ok && Z_FINISH != flush) {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        size_t length = fread(&in[0], 1, in.size(), src);
+        if (ferror(src)) {
+            ok = false;
+            break;
+        }
+        flush = feof(src) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = &in[0];
+        zs.avail_in = (uInt)length;
+        bytesIn += length;
+        do {
+            zs.next_out = &out[0];
+            zs.avail_out = (uInt)out.size();
+            if (Z_STREAM_ERROR == deflate(&zs, flush)) {
+                ok = false;
+                break;
+            }
+            size_t packed = out.size() - zs.avail_out;
+            if (packed > 0 && fwrite(&out[0], 1, packed, dst) != packed) {
+                ok = false;
+                break;
+            }
+            bytesOut += packed;
+        } while (0 == zs.avail_out);
+        keepBudget(lc, std::chrono::steady_clock::now() - begin);
+        if (lc->exit.load()) {
+            ok = false;
+        }
+    }
+    deflateEnd(&zs);
+    fclose(src);
+    if (0 != fclose(dst)) {
+        ok = false;
+    }
+    if (!ok || 0 != rename(tempFilename.c_str(), packedFilename.c_str())) {
+        remove(tempFilename.c_str());
+        return false;
+    }
+    remove(filename.c_str());
+    lc->bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+    lc->bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+    return true;
+}
+#elif defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+static bool isPacked(const std::string& filename) {
+    BOOL external = FALSE;
+    ULONG provider = 0;
+    return SUCCEEDED(WofIsExternalFile(std::wstring(filename.begin(), filename.end()).c_str(), &external, &provider, NULL, NULL)) &&
+           external && WOF_PROVIDER_FILE == provider;
+}
+
+/* file system compression, the file keeps its name and content */
+static bool packFile(logfilecompress_st* lc, const std::string& filename) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == file) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        size.QuadPart = 0;
+    }
+    FILE_PROVIDER_EXTERNAL_INFO_V1 info;
+    memset(&info, 0, sizeof(info));
+    info.Version = FILE_PROVIDER_CURRENT_VERSION;
+    info.Algorithm = FILE_PROVIDER_COMPRESSION_LZX;
+    HRESULT hr = WofSetFileDataLocation(file, WOF_PROVIDER_FILE, &info, sizeof(info));
+    CloseHandle(file);
+    if (FAILED(hr)) {
+        return false;
+    }
+    DWORD high = 0;
+    DWORD low = GetCompressedFileSizeA(filename.c_str(), &high);
+    lc->bytesIn.fetch_add((unsigned long long)size.QuadPart, std::memory_order_relaxed);
+    lc->bytesOut.fetch_add(((unsigned long long)high << 32) | low, std::memory_order_relaxed);
+    /* the file is compressed in one call, the budget is kept between files */
+    keepBudget(lc, std::chrono::steady_clock::now() - begin);
+    return true;
+}
+#else
+static bool isPacked(const std::string&) {
+    return true;
+}
+
+static bool packFile(logfilecompress_st*, const std::string&) {
+    return false;
+}
+#endif
+
+/* remove oldest rotated files until both limits are kept, files are sorted oldest first */
+static void keepRetention(logfilecompress_st* lc, const std::vector<RotatedFile>& files) {
+    unsigned long long totalBytes = 0;
+    size_t count = files.size();
+    for (size_t i = 0, len = files.size(); i < len; ++i) {
+        totalBytes += files[i].size;
+    }
+    for (size_t i = 0, len = files.size(); i < len; ++i) {
+        if ((0 == lc->maxCount || count <= lc->maxCount) && (0 == lc->maxBytes || totalBytes <= lc->maxBytes)) {
+            break;
+        }
+        if (0 == remove(files[i].filename.c_str())) {
+            lc->removed.fetch_add(1, std::memory_order_relaxed);
+            /* sidecar index is named after the uncompressed file */
+            std::string filename = files[i].filename;
+            if (endsWith(filename, LOGFILE_PACKED_EXT)) {
+                filename.erase(filename.size() - strlen(LOGFILE_PACKED_EXT));
+            }
+            remove((filename + LOGFILE_INDEX_EXT).c_str());
+        }
+        totalBytes -= files[i].size;
+        --count;
+    }
+}
+
+static void keepRetention(logfilecompress_st* lc) {
+    if (0 == lc->maxCount && 0 == lc->maxBytes) {
+        return;
+    }
+    keepRetention(lc, listRotated(lc));
+}
+
+/* compressor whose rotated files name is, prefixes end with '_' followed by the rotation time */
+static logfilecompress_st* findOwner(const std::unordered_map<std::string, logfilecompress_st*>& prefixes, const std::string& name) {
+    for (size_t i = 0, len = name.size(); i + 1 < len; ++i) {
+        if ('_' != name[i] || name[i + 1] < '0' || name[i + 1] > '9') {
+            continue;
+        }
+        std::unordered_map<std::string, logfilecompress_st*>::const_iterator iter = prefixes.find(name.substr(0, i + 1));
+        if (prefixes.end() != iter && isRotatedName(iter->second, name)) {
+            return iter->second;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * leftovers of a previous run for compressors of one directory, the directory is read once for all,
+ * unfinished temp files are dropped and their sources compressed again
+ */
+static void scanLeftovers(const std::vector<logfilecompress_st*>& group, std::vector<CompressJob>& jobs) {
+    std::unordered_map<std::string, logfilecompress_st*> prefixes;
+    std::unordered_map<logfilecompress_st*, std::vector<RotatedFile> > owned;
+    for (size_t i = 0, len = group.size(); i < len; ++i) {
+        prefixes[group[i]->prefix] = group[i];
+        owned[group[i]];
+    }
+    std::vector<RotatedFile> files = listFiles(group[0]->dirname, 1 == group.size() ? group[0]->prefix : std::string(),
+                                               [&prefixes](const std::string& name)->bool {
+        return NULL != findOwner(prefixes, name);
+    });
+    for (size_t i = 0, len = files.size(); i < len; ++i) {
+        logfilecompress_st* lc = findOwner(prefixes, files[i].name);
+        if (endsWith(files[i].filename, LOGFILE_TEMP_EXT)) {
+            remove(files[i].filename.c_str());
+            continue;
+        }
+        if (!isPacked(files[i].filename)) {
+            CompressJob job;
+            job.lc = lc;
+            job.filename = files[i].filename;
+            jobs.push_back(job);
+        }
+        owned[lc].push_back(files[i]);
+    }
+    for (std::unordered_map<logfilecompress_st*, std::vector<RotatedFile> >::iterator iter = owned.begin(); owned.end() != iter; ++iter) {
+        if (0 == iter->first->maxCount && 0 == iter->first->maxBytes) {
+            continue;
+        }
+        sortOldest(iter->second);
+        keepRetention(iter->first, iter->second);
+    }
+}
+
+static void compressLoop(void) {
+    setBackgroundPriority();
+    std::unique_lock<std::mutex> lock(s_worker.mutex);
+    while (1) {
+        s_worker.condition.wait(lock, []()->bool {
+            return s_worker.exit || !s_worker.queue.empty();
+        });
+        if (s_worker.queue.empty()) {
+            break;
+        }
+        CompressJob job = s_worker.queue.front();
+        s_worker.queue.pop_front();
+        if (job.filename.empty()) {
+            /* compressors opened together share the scan of their directory */
+            std::vector<logfilecompress_st*> group(1, job.lc);
+            std::deque<CompressJob> rest;
+            for (size_t i = 0, len = s_worker.queue.size(); i < len; ++i) {
+                CompressJob& other = s_worker.queue[i];
+                if (other.filename.empty() && other.lc->dirname == job.lc->dirname) {
+                    group.push_back(other.lc);
+                } else {
+                    rest.push_back(other);
+                }
+            }
+            s_worker.queue.swap(rest);
+            for (size_t i = 0, len = group.size(); i < len; ++i) {
+                group[i]->busy = true;
+            }
+            lock.unlock();
+            std::vector<CompressJob> jobs;
+            scanLeftovers(group, jobs);
+            lock.lock();
+            for (size_t i = 0, len = jobs.size(); i < len; ++i) {
+                if (!jobs[i].lc->exit.load()) {
+                    s_worker.queue.push_back(jobs[i]);
+                }
+            }
+            for (size_t i = 0, len = group.size(); i < len; ++i) {
+                group[i]->busy = false;
+            }
+        } else {
+            job.lc->busy = true;
+            lock.unlock();
+            if (packFile(job.lc, job.filename)) {
+                job.lc->compressed.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (!job.lc->exit.load()) {
+                keepRetention(job.lc);
+            }
+            lock.lock();
+            job.lc->busy = false;
+        }
+        s_worker.idleCondition.notify_all();
+    }
+}
+
+static void acquireWorker(void) {
+    std::lock_guard<std::mutex> life(s_lifeMutex);
+    if (0 == s_worker.users++) {
+        s_worker.exit = false;
+        s_worker.thread = std::thread(compressLoop);
+    }
+}
+
+static void releaseWorker(void) {
+    std::lock_guard<std::mutex> life(s_lifeMutex);
+    if (0 == --s_worker.users) {
+        {
+            std::lock_guard<std::mutex> lock(s_worker.mutex);
+            s_worker.exit = true;
+            s_worker.condition.notify_all();
+        }
+        s_worker.thread.join();
+    }
+}
+
+logfilecompress_st* logfilecompress_open(const char* basename, const char* extname, unsigned int maxCount, unsigned long long maxBytes, unsigned int cpuPercent) {
+    logfilecompress_st* lc = NULL;
+    assert(basename && strlen(basename) > 0);
+    assert(extname && strlen(extname) > 0);
+    lc = new (std::nothrow) logfilecompress_st();
+    if (!lc) {
+        return NULL;
+    }
+    std::string name = basename;
+    size_t pos = name.find_last_of("/\\");
+    if (std::string::npos != pos) {
+        lc->dirname = name.substr(0, pos + 1);
+        name = name.substr(pos + 1);
+    }
+    lc->prefix = name + "_";
+    lc->extname = strstr(extname, ".") ? extname : std::string(".") + extname;
+    lc->maxCount = maxCount;
+    lc->maxBytes = maxBytes;
+    lc->cpuPercent = cpuPercent < 1 ? 1 : (cpuPercent > 100 ? 100 : cpuPercent);
+    acquireWorker();
+    CompressJob job;
+    job.lc = lc;
+    std::lock_guard<std::mutex> lock(s_worker.mutex);
+    s_worker.queue.push_back(job);
+    s_worker.condition.notify_all();
+    return lc;
+}
+
+void logfilecompress_close(logfilecompress_st* lc) {
+    assert(lc);
+    {
+        std::unique_lock<std::mutex> lock(s_worker.mutex);
+        lc->exit.store(true);
+        std::deque<CompressJob> rest;
+        for (size_t i = 0, len = s_worker.queue.size(); i < len; ++i) {
+            if (lc != s_worker.queue[i].lc) {
+                rest.push_back(s_worker.queue[i]);
+            }
+        }
+        s_worker.queue.swap(rest);
+        /* ends the budget sleep of a file being compressed */
+        s_worker.condition.notify_all();
+        s_worker.idleCondition.wait(lock, [lc]()->bool {
+            return !lc->busy;
+        });
+    }
+    delete lc;
+    releaseWorker();
+}
+
+void logfilecompress_push(logfilecompress_st* lc, const char* filename) {
+    assert(lc);
+    assert(filename);
+    CompressJob job;
+    job.lc = lc;
+    job.filename = filename;
+    std::lock_guard<std::mutex> lock(s_worker.mutex);
+    s_worker.queue.push_back(job);
+    s_worker.condition.notify_all();
+}
+
+void logfilecompress_onrotate(const char* filename, void* param) {
+    logfilecompress_push((logfilecompress_st*)param, filename);
+}
+
+void logfilecompress_stats(logfilecompress_st* lc, logfilecompress_stats_st* stats) {
+    assert(lc);
+    assert(stats);
+    stats->compressed = lc->compressed.load(std::memory_order_relaxed);
+    stats->bytesIn = lc->bytesIn.load(std::memory_order_relaxed);
+    stats->bytesOut = lc->bytesOut.load(std::memory_order_relaxed);
+    stats->removed = lc->removed.load(std::memory_order_relaxed);
+}
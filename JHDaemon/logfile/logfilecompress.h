@@ -0,0 +1,88 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	rotated logfile compressor, rotated files are queued in O(1)
+*           and compressed by one low priority background thread shared by
+*           every compressor, old rotated files are removed by count and
+*           total size
+**********************************************************************/
+#ifndef _LOGFILE_COMPRESS_H_
+#define _LOGFILE_COMPRESS_H_
+
+#include <stddef.h>
+
+#define LOGFILE_COMPRESS_DEFAULT_COUNT      30
+#define LOGFILE_COMPRESS_DEFAULT_BYTES      1024*1024*100ULL
+#define LOGFILE_COMPRESS_DEFAULT_CPU        20
+
+/*
+ * compression backend:
+ *      LOGFILE_HAVE_ZLIB defined - "file.ext" is replaced by gzip "file.ext.gz", streamed in chunks
+ *      Windows without zlib - "file.ext" is compressed in place by the file system (LZX, Windows 10),
+ *                             it stays readable by every tool
+ *      otherwise - no compression, only retention
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logfilecompress_st logfilecompress_st;
+
+typedef struct logfilecompress_stats_st {
+    unsigned long long compressed;      /* files compressed */
+    unsigned long long bytesIn;         /* bytes before compression */
+    unsigned long long bytesOut;        /* bytes after compression */
+    unsigned long long removed;         /* rotated files removed by retention */
+} logfilecompress_stats_st;
+
+/*
+ * Brief:	start compressor of rotated files "basename_*extname", rotated files left by a previous run
+ *          are compressed too, the worker thread starts with the first compressor and stops with the last,
+ *          compressors opened together in one directory share one scan of it
+ * Param:	basename - file base name, same as logfilewrapper
+ *          extname - file extend name, same as logfilewrapper
+ *          maxCount - max rotated files to keep, 0 means no limit
+ *          maxBytes - max total size of rotated files on disk, 0 means no limit
+ *          cpuPercent - max cpu usage of the worker thread while compressing files of this compressor, 1-100
+ * Return:	logfilecompress_st*
+ */
+extern logfilecompress_st* logfilecompress_open(const char* basename, const char* extname, unsigned int maxCount, unsigned long long maxBytes, unsigned int cpuPercent);
+
+/*
+ * Brief:	stop compressor, a file being compressed is abandoned and compressed next run
+ * Param:	lc - compressor
+ * Return:	void
+ */
+extern void logfilecompress_close(logfilecompress_st* lc);
+
+/*
+ * Brief:	queue a rotated file, can be called in any thread, never blocks on compression
+ * Param:	lc - compressor
+ *          filename - rotated file name
+ * Return:	void
+ */
+extern void logfilecompress_push(logfilecompress_st* lc, const char* filename);
+
+/*
+ * Brief:	rotate handler for logfilewrapper_onrotate, param is logfilecompress_st*
+ * Param:	filename - rotated file name
+ *          param - compressor
+ * Return:	void
+ */
+extern void logfilecompress_onrotate(const char* filename, void* param);
+
+/*
+ * Brief:	get statistics
+ * Param:	lc - compressor
+ *          stats - output statistics
+ * Return:	void
+ */
+extern void logfilecompress_stats(logfilecompress_st* lc, logfilecompress_stats_st* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOGFILE_COMPRESS_H_
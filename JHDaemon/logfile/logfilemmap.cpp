@@ -0,0 +1,425 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	memory mapped logfile, each segment is preallocated and mapped,
+*           writers reserve space with an atomic add and copy their record
+*           without system call
+**********************************************************************/
+#include "logfilemmap.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include "logtime.h"
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* one mapped segment file */
+struct LogSegment {
+    LogSegment(void) : base(NULL), size(0), offset(0), writers(0), next(NULL) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        fd = -1;
+#endif
+    }
+    char* base;
+    size_t size;                            /* writable size */
+    std::atomic<size_t> offset;             /* next reservation, can run past size, the writer crossing size rotates */
+    std::atomic<unsigned int> writers;      /* writers between reservation and copy */
+    LogSegment* next;                       /* retired list, segments are freed at close because late writers may still touch them */
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+struct logfilemmap_st {
+    logfilemmap_st(void) : segmentSize(0), syncInterval(0), current(NULL), retired(NULL), exit(false),
+                           recorded(0), rotations(0), syncs(0), failed(0) {}
+    std::string basename;
+    std::string extname;                    /* with leading '.' */
+    size_t segmentSize;
+    unsigned int syncInterval;
+    std::atomic<LogSegment*> current;       /* NULL while rotating */
+    LogSegment* retired;
+    std::mutex segmentMutex;                /* guards rotation, sync and close */
+    std::mutex syncMutex;
+    std::condition_variable syncCondition;
+    bool exit;
+    std::thread syncThread;
+    std::atomic<unsigned long long> recorded;
+    std::atomic<unsigned long long> rotations;
+    std::atomic<unsigned long long> syncs;
+    std::atomic<unsigned long long> failed;
+};
+
+/* piece of a record, copied in order */
+struct LogPart {
+    const void* data;
+    size_t length;
+};
+
+static void localTime(time_t now, struct tm* t) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    localtime_s(t, &now);
+#else
+    localtime_r(&now, t);
+#endif
+}
+
+/* data end of an existing segment, preallocated tail is zero */
+static size_t usedSize(const char* base, size_t size) {
+    while (size > 0 && '\0' == base[size - 1]) {
+        --size;
+    }
+    return size;
+}
+
+static LogSegment* openSegment(const std::string& filename, size_t segmentSize) {
+    LogSegment* seg = new (std::nothrow) LogSegment();
+    size_t existSize = 0;
+    size_t mapSize = 0;
+    if (!seg) {
+        return NULL;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    LARGE_INTEGER fileSize;
+    seg->file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == seg->file) {
+        delete seg;
+        return NULL;
+    }
+    if (GetFileSizeEx(seg->file, &fileSize)) {
+        existSize = (size_t)fileSize.QuadPart;
+    }
+    mapSize = existSize > segmentSize ? existSize : segmentSize;
+    /* mapping a size larger than the file extends the file */
+    seg->mapping = CreateFileMappingA(seg->file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)mapSize >> 32), (DWORD)(mapSize & 0xFFFFFFFF), NULL);
+    if (seg->mapping) {
+        seg->base = (char*)MapViewOfFile(seg->mapping, FILE_MAP_WRITE, 0, 0, mapSize);
+    }
+    if (!seg->base) {
+        if (seg->mapping) {
+            CloseHandle(seg->mapping);
+        }
+        CloseHandle(seg->file);
+        delete seg;
+        return NULL;
+    }
+#else
+    struct stat st;
+    seg->fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (seg->fd < 0) {
+        delete seg;
+        return NULL;
+    }
+    if (0 == fstat(seg->fd, &st)) {
+        existSize = (size_t)st.st_size;
+    }
+    mapSize = existSize > segmentSize ? existSize : segmentSize;
+    if (existSize < mapSize) {
+        /* reserve blocks now so page faults on write never hit a full disk */
+        if (0 != posix_fallocate(seg->fd, 0, (off_t)mapSize) && 0 != ftruncate(seg->fd, (off_t)mapSize)) {
+            close(seg->fd);
+            delete seg;
+            return NULL;
+        }
+    }
+    void* base = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (MAP_FAILED == base) {
+        close(seg->fd);
+        delete seg;
+        return NULL;
+    }
+    seg->base = (char*)base;
+#endif
+    seg->size = mapSize;
+    seg->offset.store(existSize > 0 ? usedSize(seg->base, existSize) : 0);
+    return seg;
+}
+
+/* unmap and cut the preallocated tail */
+static void closeSegment(LogSegment* seg, size_t used) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    LARGE_INTEGER pos;
+    UnmapViewOfFile(seg->base);
+    CloseHandle(seg->mapping);
+    pos.QuadPart = (LONGLONG)used;
+    if (SetFilePointerEx(seg->file, pos, NULL, FILE_BEGIN)) {
+        SetEndOfFile(seg->file);
+    }
+    CloseHandle(seg->file);
+    seg->mapping = NULL;
+    seg->file = INVALID_HANDLE_VALUE;
+#else
+    munmap(seg->base, seg->size);
+    if (0 != ftruncate(seg->fd, (off_t)used)) {
+        /* keep the zero tail, readers stop at the first zero byte */
+    }
+    close(seg->fd);
+    seg->fd = -1;
+#endif
+    seg->base = NULL;
+}
+
+static void syncSegment(LogSegment* seg, size_t used) {
+    if (0 == used) {
+        return;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    FlushViewOfFile(seg->base, used);
+#else
+    msync(seg->base, used, MS_ASYNC);
+#endif
+}
+
+static size_t writtenSize(LogSegment* seg) {
+    size_t offset = seg->offset.load();
+    return offset < seg->size ? offset : seg->size;
+}
+
+static void waitWriters(LogSegment* seg) {
+    while (seg->writers.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+static std::string currentFilename(logfilemmap_st* lm) {
+    return lm->basename + lm->extname;
+}
+
+/* same scheme as logfilewrapper, a counter is added when the second is already taken */
+static std::string rotatedFilename(logfilemmap_st* lm) {
+    time_t now;
+    struct tm t;
+    char date[16] = { 0 };
+    time(&now);
+    localTime(now, &t);
+    strftime(date, sizeof(date), "%Y%m%d%H%M%S", &t);
+    std::string filename = lm->basename + "_" + date + lm->extname;
+    for (int i = 1; i < 1000; ++i) {
+        FILE* fp = fopen(filename.c_str(), "r");
+        if (!fp) {
+            break;
+        }
+        fclose(fp);
+        char suffix[16] = { 0 };
+        sprintf(suffix, "_%d", i);
+        filename = lm->basename + "_" + date + suffix + lm->extname;
+    }
+    return filename;
+}
+
+/* called by the writer whose reservation crossed the segment end, used is where its reservation began */
+static void rotateSegment(logfilemmap_st* lm, LogSegment* seg, size_t used) {
+    std::lock_guard<std::mutex> lock(lm->segmentMutex);
+    if (lm->current.load() != seg) {
+        return;
+    }
+    lm->current.store(NULL);
+    waitWriters(seg);
+    closeSegment(seg, used);
+    rename(currentFilename(lm).c_str(), rotatedFilename(lm).c_str());
+    seg->next = lm->retired;
+    lm->retired = seg;
+    lm->current.store(openSegment(currentFilename(lm), lm->segmentSize));
+    lm->rotations.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* current segment is missing after a failed open, try again */
+static bool reopenSegment(logfilemmap_st* lm) {
+    std::lock_guard<std::mutex> lock(lm->segmentMutex);
+    if (!lm->current.load()) {
+        lm->current.store(openSegment(currentFilename(lm), lm->segmentSize));
+    }
+    return NULL != lm->current.load();
+}
+
+static void syncLoop(logfilemmap_st* lm) {
+    std::unique_lock<std::mutex> syncLock(lm->syncMutex);
+    while (!lm->exit) {
+        lm->syncCondition.wait_for(syncLock, std::chrono::milliseconds(lm->syncInterval));
+        if (lm->exit) {
+            break;
+        }
+        logfilemmap_sync(lm);
+    }
+}
+
+logfilemmap_st* logfilemmap_open(const char* basename, const char* extname, size_t segmentSize, unsigned int syncInterval) {
+    logfilemmap_st* lm = NULL;
+    assert(basename && strlen(basename) > 0);
+    assert(extname && strlen(extname) > 0);
+    assert(segmentSize > 0);
+    lm = new (std::nothrow) logfilemmap_st();
+    if (!lm) {
+        return NULL;
+    }
+    lm->basename = basename;
+    lm->extname = strstr(extname, ".") ? extname : std::string(".") + extname;
+    lm->segmentSize = segmentSize;
+    lm->syncInterval = syncInterval;
+    LogSegment* seg = openSegment(currentFilename(lm), segmentSize);
+    if (!seg) {
+        delete lm;
+        return NULL;
+    }
+    lm->current.store(seg);
+    if (syncInterval > 0) {
+        lm->syncThread = std::thread(syncLoop, lm);
+    }
+    return lm;
+}
+
+void logfilemmap_close(logfilemmap_st* lm) {
+    assert(lm);
+    if (lm->syncThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> syncLock(lm->syncMutex);
+            lm->exit = true;
+            lm->syncCondition.notify_one();
+        }
+        lm->syncThread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(lm->segmentMutex);
+        LogSegment* seg = lm->current.exchange(NULL);
+        if (seg) {
+            waitWriters(seg);
+            closeSegment(seg, writtenSize(seg));
+            delete seg;
+        }
+        while (lm->retired) {
+            seg = lm->retired;
+            lm->retired = seg->next;
+            delete seg;
+        }
+    }
+    delete lm;
+}
+
+/* reserve length bytes in current segment and copy the parts there, rotates when the segment is full */
+static unsigned int writeParts(logfilemmap_st* lm, const LogPart* parts, size_t count, size_t length) {
+    if (length > lm->segmentSize) {
+        return 1;
+    }
+    if (0 == length) {
+        return 0;
+    }
+    while (1) {
+        LogSegment* seg = lm->current.load();
+        if (!seg) {
+            if (!reopenSegment(lm)) {
+                lm->failed.fetch_add(1, std::memory_order_relaxed);
+                return 2;
+            }
+            continue;
+        }
+        /* announce before reserving, the rotator waits for announced writers after clearing current */
+        seg->writers.fetch_add(1);
+        if (lm->current.load() != seg) {
+            seg->writers.fetch_sub(1);
+            continue;
+        }
+        size_t offset = seg->offset.fetch_add(length);
+        if (offset + length <= seg->size) {
+            char* dst = seg->base + offset;
+            for (size_t i = 0; i < count; ++i) {
+                if (parts[i].length > 0) {
+                    memcpy(dst, parts[i].data, parts[i].length);
+                    dst += parts[i].length;
+                }
+            }
+            seg->writers.fetch_sub(1);
+            lm->recorded.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        seg->writers.fetch_sub(1);
+        if (offset <= seg->size) {
+            rotateSegment(lm, seg, offset);
+        } else {
+            /* another writer crossed the end and is rotating */
+            while (lm->current.load() == seg) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+unsigned int logfilemmap_record(logfilemmap_st* lm, const char* tag, unsigned int withtime, const char* content) {
+    char date[32] = { 0 };
+    LogPart parts[5];
+    size_t count = 0;
+    size_t length = 0;
+    assert(lm);
+    assert(content);
+    if (withtime) {
+        size_t dateLength = 1 + logtime_now(date + 1, sizeof(date) - 3, 0);
+        date[0] = '[';
+        date[dateLength++] = ']';
+        date[dateLength++] = ' ';
+        parts[count].data = date;
+        parts[count++].length = dateLength;
+    }
+    if (tag && strlen(tag) > 0) {
+        parts[count].data = "[";
+        parts[count++].length = 1;
+        parts[count].data = tag;
+        parts[count++].length = strlen(tag);
+        parts[count].data = "] ";
+        parts[count++].length = 2;
+    }
+    parts[count].data = content;
+    parts[count++].length = strlen(content);
+    for (size_t i = 0; i < count; ++i) {
+        length += parts[i].length;
+    }
+    return writeParts(lm, parts, count, length);
+}
+
+unsigned int logfilemmap_write(logfilemmap_st* lm, const void* data, size_t length) {
+    LogPart part;
+    assert(lm);
+    assert(data || 0 == length);
+    part.data = data;
+    part.length = length;
+    return writeParts(lm, &part, 1, length);
+}
+
+void logfilemmap_sync(logfilemmap_st* lm) {
+    assert(lm);
+    std::lock_guard<std::mutex> lock(lm->segmentMutex);
+    LogSegment* seg = lm->current.load();
+    if (seg) {
+        syncSegment(seg, writtenSize(seg));
+        lm->syncs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void logfilemmap_stats(logfilemmap_st* lm, logfilemmap_stats_st* stats) {
+    assert(lm);
+    assert(stats);
+    stats->recorded = lm->recorded.load(std::memory_order_relaxed);
+    stats->rotations = lm->rotations.load(std::memory_order_relaxed);
+    stats->syncs = lm->syncs.load(std::memory_order_relaxed);
+    stats->failed = lm->failed.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,94 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	memory mapped logfile, each segment is preallocated and mapped,
+*           writers reserve space with an atomic add and copy their record
+*           without system call
+**********************************************************************/
+#ifndef _LOGFILE_MMAP_H_
+#define _LOGFILE_MMAP_H_
+
+#include <stddef.h>
+
+#define LOGFILE_MMAP_DEFAULT_SEGMENT    1024*1024*10L
+#define LOGFILE_MMAP_DEFAULT_SYNC       1000
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logfilemmap_st logfilemmap_st;
+
+typedef struct logfilemmap_stats_st {
+    unsigned long long recorded;        /* records written */
+    unsigned long long rotations;       /* segments rotated */
+    unsigned long long syncs;           /* background syncs */
+    unsigned long long failed;          /* records dropped because no segment could be opened */
+} logfilemmap_stats_st;
+
+/*
+ * Brief:	open a memory mapped logfile, current segment is "basename + extname", a full segment is
+ *          renamed to "basename_YYYYmmddHHMMSS + extname" like logfilewrapper, an existing current
+ *          segment is appended after its last non-zero byte
+ * Param:	basename - file base name, e.g. "Demo" or "demo_"
+ *          extname - file extend name, e.g. ".log" or ".err"
+ *          segmentSize - segment size
+ *          syncInterval - milliseconds between background syncs of written pages, 0 means no background sync
+ * Return:	logfilemmap_st*
+ */
+extern logfilemmap_st* logfilemmap_open(const char* basename, const char* extname, size_t segmentSize, unsigned int syncInterval);
+
+/*
+ * Brief:	close a memory mapped logfile, current segment is truncated to its written size,
+ *          no record may be running
+ * Param:	lm - memory mapped logfile
+ * Return:	void
+ */
+extern void logfilemmap_close(logfilemmap_st* lm);
+
+/*
+ * Brief:	record log, can be called in any thread, content is written as "[time] [tag] content"
+ *          without adding a newline
+ * Param:	lm - memory mapped logfile
+ *          tag - record tag, can be NULL
+ *          withtime - with time, 0.false, 1.true
+ *          content - record content
+ * Return:	0.ok
+ *          1.content size large than segment
+ *          2.can not open segment, record dropped
+ */
+extern unsigned int logfilemmap_record(logfilemmap_st* lm, const char* tag, unsigned int withtime, const char* content);
+
+/*
+ * Brief:	write raw bytes as one record, can be called in any thread, used for binary records,
+ *          data should not end with zero bytes since the segment tail is found by the last non-zero byte
+ * Param:	lm - memory mapped logfile
+ *          data - record data
+ *          length - data length
+ * Return:	0.ok
+ *          1.data size large than segment
+ *          2.can not open segment, record dropped
+ */
+extern unsigned int logfilemmap_write(logfilemmap_st* lm, const void* data, size_t length);
+
+/*
+ * Brief:	sync written pages of current segment to disk now
+ * Param:	lm - memory mapped logfile
+ * Return:	void
+ */
+extern void logfilemmap_sync(logfilemmap_st* lm);
+
+/*
+ * Brief:	get statistics
+ * Param:	lm - memory mapped logfile
+ *          stats - output statistics
+ * Return:	void
+ */
+extern void logfilemmap_stats(logfilemmap_st* lm, logfilemmap_stats_st* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOGFILE_MMAP_H_
@@ -0,0 +1,282 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	background rotation of logfile wrapper, the next file is
+*           opened and preallocated ahead, rotation in the recording
+*           thread is a pointer swap, close and rename run in background on
+*           one worker thread shared by every rotation
+**********************************************************************/
+#include "logfilerotate.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define LOGFILE_NEXT_EXT    ".next"
+
+/* full file waiting to be closed and renamed */
+struct RotateJob {
+    logfile_st* full;
+    void (*handler)(const char* filename, void* param);
+    void* param;
+};
+
+struct logfilerotate_st {
+    logfilerotate_st(void) : maxSize(0), indexInterval(0), next(NULL), failed(false), queued(false), busy(false), closing(false) {}
+    std::string basename;
+    std::string extname;
+    std::string filename;                   /* basename + extname */
+    size_t maxSize;
+    size_t indexInterval;                   /* 0 means no index */
+    logfile_st* next;                       /* opened ahead, NULL while being prepared */
+    bool failed;                            /* next file can not be opened */
+    std::deque<RotateJob> jobs;
+    bool queued;                            /* in the worker queue */
+    bool busy;                              /* the worker is working on it */
+    bool closing;                           /* no next file is prepared any more */
+};
+
+/* one background thread serves every rotation, thousands of files need no thread each */
+struct RotateWorker {
+    RotateWorker(void) : users(0), exit(false) {}
+    std::mutex mutex;                       /* guards the worker and the state of every rotation */
+    std::condition_variable condition;      /* wakes the worker */
+    std::condition_variable readyCondition; /* wakes swaps and closes waiting for the worker */
+    std::deque<logfilerotate_st*> queue;    /* rotations with work to do */
+    unsigned int users;                     /* open rotations, guarded by s_lifeMutex */
+    bool exit;
+    std::thread thread;
+};
+
+static RotateWorker s_worker;
+static std::mutex s_lifeMutex;              /* start and stop of the worker */
+
+/* same scheme as logfilewrapper, a counter is added when the second is already taken */
+static std::string rotatedFilename(logfilerotate_st* lr) {
+    time_t now;
+    struct tm t;
+    char date[16] = { 0 };
+    time(&now);
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    localtime_s(&t, &now);
+#else
+    localtime_r(&now, &t);
+#endif
+    strftime(date, sizeof(date), "%Y%m%d%H%M%S", &t);
+    std::string filename = lr->basename + "_" + date + lr->extname;
+    for (int i = 1; i < 1000; ++i) {
+        FILE* fp = fopen(filename.c_str(), "r");
+        if (!fp) {
+            break;
+        }
+        fclose(fp);
+        char suffix[16] = { 0 };
+        sprintf(suffix, "_%d", i);
+        filename = lr->basename + "_" + date + suffix + lr->extname;
+    }
+    return filename;
+}
+
+/* open "filename.next", it carries the final name so logfile_name and logfile_clear see the right file */
+static logfile_st* openNext(logfilerotate_st* lr) {
+    logfile_st* lf = logfile_open((lr->filename + LOGFILE_NEXT_EXT).c_str(), lr->maxSize);
+    if (!lf) {
+        return NULL;
+    }
+    char* name = (char*)malloc(lr->filename.size() + 1);
+    if (!name) {
+        logfile_close(lf);
+        return NULL;
+    }
+    sprintf(name, "%s", lr->filename.c_str());
+    free(lf->filename);
+    lf->filename = name;
+    logfile_preallocate(lf, lr->maxSize);
+    return lf;
+}
+
+/* below the recording thread, so waking the background never preempts it on a busy core */
+static void setLowPriority(void) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(SCHED_IDLE)
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+/* a full file to rename, or a next file to prepare while not closing */
+static bool hasWork(logfilerotate_st* lr) {
+    return !lr->jobs.empty() || (!lr->next && !lr->failed && !lr->closing);
+}
+
+/* queue to the worker when there is work, need lock s_worker.mutex */
+static void schedule(logfilerotate_st* lr) {
+    if (!lr->queued && !lr->busy && hasWork(lr)) {
+        lr->queued = true;
+        s_worker.queue.push_back(lr);
+        s_worker.condition.notify_one();
+    }
+}
+
+static void rotateLoop(void) {
+    setLowPriority();
+    std::unique_lock<std::mutex> lock(s_worker.mutex);
+    while (1) {
+        if (s_worker.queue.empty()) {
+            if (s_worker.exit) {
+                break;
+            }
+            s_worker.condition.wait(lock);
+            continue;
+        }
+        logfilerotate_st* lr = s_worker.queue.front();
+        s_worker.queue.pop_front();
+        lr->queued = false;
+        lr->busy = true;
+        if (!lr->jobs.empty()) {
+            RotateJob job = lr->jobs.front();
+            lock.unlock();
+            std::string rotated = rotatedFilename(lr);
+            logfile_close(job.full);
+            /* the swapped in file is open under "filename.next" until here */
+            logfile_rename(lr->filename.c_str(), rotated.c_str());
+            logfile_rename((lr->filename + LOGFILE_NEXT_EXT).c_str(), lr->filename.c_str());
+            if (job.handler) {
+                job.handler(rotated.c_str(), job.param);
+            }
+            lock.lock();
+            lr->jobs.pop_front();
+            lr->failed = false;
+        } else if (!lr->next && !lr->failed && !lr->closing) {
+            /* prepare the next file, outside the lock so other rotations can still swap */
+            lock.unlock();
+            logfile_st* next = openNext(lr);
+            lock.lock();
+            if (next && lr->indexInterval > 0) {
+                logfile_setindex(next, (lr->filename + LOGFILE_NEXT_EXT LOGFILE_INDEX_EXT).c_str(), lr->indexInterval);
+            }
+            lr->next = next;
+            lr->failed = (NULL == next);
+        }
+        lr->busy = false;
+        s_worker.readyCondition.notify_all();
+        schedule(lr);
+    }
+}
+
+static void acquireWorker(void) {
+    std::lock_guard<std::mutex> life(s_lifeMutex);
+    if (0 == s_worker.users++) {
+        s_worker.exit = false;
+        s_worker.thread = std::thread(rotateLoop);
+    }
+}
+
+static void releaseWorker(void) {
+    std::lock_guard<std::mutex> life(s_lifeMutex);
+    if (0 == --s_worker.users) {
+        {
+            std::lock_guard<std::mutex> lock(s_worker.mutex);
+            s_worker.exit = true;
+            s_worker.condition.notify_one();
+        }
+        s_worker.thread.join();
+    }
+}
+
+logfilerotate_st* logfilerotate_open(const char* basename, const char* extname, size_t maxSize) {
+    logfilerotate_st* lr = NULL;
+    assert(basename && strlen(basename) > 0);
+    assert(extname && '.' == extname[0]);
+    assert(maxSize > 0);
+    lr = new (std::nothrow) logfilerotate_st();
+    if (!lr) {
+        return NULL;
+    }
+    lr->basename = basename;
+    lr->extname = extname;
+    lr->filename = lr->basename + lr->extname;
+    lr->maxSize = maxSize;
+    acquireWorker();
+    std::lock_guard<std::mutex> lock(s_worker.mutex);
+    schedule(lr);
+    return lr;
+}
+
+void logfilerotate_close(logfilerotate_st* lr) {
+    assert(lr);
+    {
+        std::unique_lock<std::mutex> lock(s_worker.mutex);
+        lr->closing = true;
+        s_worker.readyCondition.wait(lock, [lr]()->bool {
+            return lr->jobs.empty() && !lr->busy;
+        });
+        if (lr->queued) {
+            s_worker.queue.erase(std::find(s_worker.queue.begin(), s_worker.queue.end(), lr));
+            lr->queued = false;
+        }
+    }
+    if (lr->next) {
+        bool empty = (0 == lr->next->filesize);
+        logfile_close(lr->next);
+        if (empty) {
+            remove((lr->filename + LOGFILE_NEXT_EXT).c_str());
+            remove((lr->filename + LOGFILE_NEXT_EXT LOGFILE_INDEX_EXT).c_str());
+        }
+        lr->next = NULL;
+    }
+    delete lr;
+    releaseWorker();
+}
+
+void logfilerotate_setindex(logfilerotate_st* lr, size_t interval) {
+    assert(lr);
+    std::lock_guard<std::mutex> lock(s_worker.mutex);
+    lr->indexInterval = interval;
+    /* a next file prepared before this call */
+    if (lr->next && !lr->next->indexptr) {
+        logfile_setindex(lr->next, (lr->filename + LOGFILE_NEXT_EXT LOGFILE_INDEX_EXT).c_str(), interval);
+    }
+}
+
+logfile_st* logfilerotate_swap(logfilerotate_st* lr, logfile_st* full, void (*handler)(const char* filename, void* param), void* param) {
+    logfile_st* next = NULL;
+    RotateJob job;
+    assert(lr);
+    assert(full);
+    job.full = full;
+    job.handler = handler;
+    job.param = param;
+    std::unique_lock<std::mutex> lock(s_worker.mutex);
+    /* the next file is normally ready, waiting means rotations come faster than the background */
+    s_worker.readyCondition.wait(lock, [lr]()->bool {
+        return (lr->next || lr->failed) && lr->jobs.empty();
+    });
+    next = lr->next;
+    lr->next = NULL;
+    if (!next) {
+        /* keep the full file, the caller still owns it */
+        lr->failed = false;
+        schedule(lr);
+        return NULL;
+    }
+    lr->jobs.push_back(job);
+    schedule(lr);
+    return next;
+}
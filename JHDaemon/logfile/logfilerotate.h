@@ -0,0 +1,63 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	background rotation of logfile wrapper, the next file is
+*           opened and preallocated ahead, rotation in the recording
+*           thread is a pointer swap, close and rename run in background on
+*           one worker thread shared by every rotation
+**********************************************************************/
+#ifndef _LOGFILE_ROTATE_H_
+#define _LOGFILE_ROTATE_H_
+
+#include "logfile.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logfilerotate_st logfilerotate_st;
+
+/*
+ * Brief:	start background rotation, the next file is opened as "filename.next" and renamed to
+ *          filename after the full file is renamed away, the worker thread starts with the first
+ *          rotation and stops with the last
+ * Param:	basename - file base name, with extname gives rotated names "basename_YYYYmmddHHMMSS + extname"
+ *          extname - file extend name, with leading '.'
+ *          maxSize - file max size, also preallocated size of the next file
+ * Return:	logfilerotate_st*
+ */
+extern logfilerotate_st* logfilerotate_open(const char* basename, const char* extname, size_t maxSize);
+
+/*
+ * Brief:	finish pending rotations and stop, an unused empty next file is removed
+ * Param:	lr - rotation
+ * Return:	void
+ */
+extern void logfilerotate_close(logfilerotate_st* lr);
+
+/*
+ * Brief:	write a sidecar index for every next file, it is opened as "filename.next" + LOGFILE_INDEX_EXT
+ *          and renamed with the file
+ * Param:	lr - rotation
+ *          interval - min bytes of log between entries
+ * Return:	void
+ */
+extern void logfilerotate_setindex(logfilerotate_st* lr, size_t interval);
+
+/*
+ * Brief:	rotate, the full file is handed to the background which closes it, renames it and calls handler,
+ *          waits only when the next file is not ready yet because rotations come faster than the background
+ * Param:	lr - rotation
+ *          full - full logfile, must not be used after this call
+ *          handler - called in background with the rotated file name, can be NULL
+ *          param - parameter passed to handler
+ * Return:	logfile_st*, the next logfile, NULL if it can not be opened and full is still owned by the caller
+ */
+extern logfile_st* logfilerotate_swap(logfilerotate_st* lr, logfile_st* full, void (*handler)(const char* filename, void* param), void* param);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOGFILE_ROTATE_H_
@@ -39,9 +39,42 @@ logfilewrapper_st* logfilewrapper_init(const char* basename, const char* extname
         sprintf(wrapper->extname, ".%s", extname);
     }
     wrapper->override = override;
+    wrapper->rotateHandler = NULL;
+    wrapper->rotateParam = NULL;
+    wrapper->rotator = NULL;
+    wrapper->syncPolicy = LOGFILE_SYNC_NONE;
+    wrapper->syncInterval = 0;
+    memset(&wrapper->syncStats, 0, sizeof(wrapper->syncStats));
+    wrapper->indexInterval = 0;
     return wrapper;
 }
 
+void logfilewrapper_close(logfilewrapper_st* wrapper) {
+    assert(wrapper);
+    if (wrapper->rotator) {
+        logfilerotate_close(wrapper->rotator);
+        wrapper->rotator = NULL;
+    }
+    logfile_close(wrapper->logfile);
+    wrapper->logfile = NULL;
+    free(wrapper->basename);
+    wrapper->basename = NULL;
+    free(wrapper->extname);
+    wrapper->extname = NULL;
+    free(wrapper);
+}
+
+unsigned int logfilewrapper_prepare(logfilewrapper_st* wrapper) {
+    assert(wrapper);
+    if (!wrapper->rotator) {
+        wrapper->rotator = logfilerotate_open(wrapper->basename, wrapper->extname, wrapper->logfile->maxsize);
+        if (wrapper->rotator && wrapper->indexInterval > 0) {
+            logfilerotate_setindex(wrapper->rotator, wrapper->indexInterval);
+        }
+    }
+    return wrapper->rotator ? 0 : 1;
+}
+
 unsigned int logfilewrapper_isenable(logfilewrapper_st* wrapper) {
     assert(wrapper);
     return logfile_isenable(wrapper->logfile);
@@ -52,6 +85,40 @@ void logfilewrapper_enable(logfilewrapper_st* wrapper, unsigned int enable) {
     logfile_enable(wrapper->logfile, enable);
 }
 
+void logfilewrapper_onrotate(logfilewrapper_st* wrapper, logfilewrapper_callback_rotate handler, void* param) {
+    assert(wrapper);
+    wrapper->rotateHandler = handler;
+    wrapper->rotateParam = param;
+}
+
+void logfilewrapper_setsync(logfilewrapper_st* wrapper, unsigned int policy, unsigned int interval) {
+    assert(wrapper);
+    wrapper->syncPolicy = policy;
+    wrapper->syncInterval = interval;
+    logfile_setsync(wrapper->logfile, policy, interval, &wrapper->syncStats);
+}
+
+unsigned int logfilewrapper_setindex(logfilewrapper_st* wrapper, size_t interval) {
+    assert(wrapper);
+    assert(interval > 0);
+    wrapper->indexInterval = interval;
+    if (wrapper->rotator) {
+        logfilerotate_setindex(wrapper->rotator, interval);
+    }
+    return logfile_setindex(wrapper->logfile, NULL, interval);
+}
+
+unsigned int logfilewrapper_commit(logfilewrapper_st* wrapper) {
+    assert(wrapper);
+    return logfile_commit(wrapper->logfile);
+}
+
+void logfilewrapper_syncstats(logfilewrapper_st* wrapper, logfile_syncstats_st* stats) {
+    assert(wrapper);
+    assert(stats);
+    *stats = wrapper->syncStats;
+}
+
 unsigned int logfilewrapper_record(logfilewrapper_st* wrapper, const char* tag, unsigned int withtime, const char* content) {
     unsigned int flag = 0;
     char* filename = NULL;
@@ -74,6 +141,13 @@ unsigned int logfilewrapper_record(logfilewrapper_st* wrapper, const char* tag,
     if (3 == flag) {
         if (wrapper->override) {
             logfile_clear(wrapper->logfile);
+        } else if (wrapper->rotator) {
+            logfile_st* next = logfilerotate_swap(wrapper->rotator, wrapper->logfile, wrapper->rotateHandler, wrapper->rotateParam);
+            if (!next) {
+                return 3;
+            }
+            wrapper->logfile = next;
+            logfile_setsync(wrapper->logfile, wrapper->syncPolicy, wrapper->syncInterval, &wrapper->syncStats);
         } else {
             filename = (char*)malloc(strlen(wrapper->logfile->filename) + 1);
             sprintf(filename, "%s", wrapper->logfile->filename);
@@ -89,7 +163,9 @@ unsigned int logfilewrapper_record(logfilewrapper_st* wrapper, const char* tag,
                 oldFilename = (char*)malloc(strlen(wrapper->basename) + 1 + strlen(date) + 1 + strlen(wrapper->extname) + 1);
                 sprintf(oldFilename, "%s_%s.%s", wrapper->basename, date, wrapper->extname);
             }
-            rename(filename, oldFilename);
+            if (0 == logfile_rename(filename, oldFilename) && wrapper->rotateHandler) {
+                wrapper->rotateHandler(oldFilename, wrapper->rotateParam);
+            }
             free(oldFilename);
             wrapper->logfile = logfile_open(filename, maxsize);
             free(filename);
@@ -102,6 +178,10 @@ unsigned int logfilewrapper_record(logfilewrapper_st* wrapper, const char* tag,
                 wrapper = NULL;
                 return 3;
             }
+            logfile_setsync(wrapper->logfile, wrapper->syncPolicy, wrapper->syncInterval, &wrapper->syncStats);
+            if (wrapper->indexInterval > 0) {
+                logfile_setindex(wrapper->logfile, NULL, wrapper->indexInterval);
+            }
         }
         if (!tag || 0 == strlen(tag)) {
             if (withtime) {
@@ -7,6 +7,7 @@
 #define _LOGFILE_WRAPPER_H_
 
 #include "logfile.h"
+#include "logfilerotate.h"
 
 #define LOGFILE_DEFAULT_MAXSIZE     1024*1024*10L
 
@@ -15,11 +16,21 @@ extern "C"
 {
 #endif
 
+/* called after a full file is renamed to "basename_YYYYmmddHHMMSS + extname", in the recording thread */
+typedef void (*logfilewrapper_callback_rotate)(const char* filename, void* param);
+
 typedef struct logfilewrapper_st {
     logfile_st* logfile;
     char* basename;
     char* extname;
     unsigned int override;
+    logfilewrapper_callback_rotate rotateHandler;
+    void* rotateParam;
+    logfilerotate_st* rotator;              /* background rotation, NULL means rotate in the recording thread */
+    unsigned int syncPolicy;                /* LOGFILE_SYNC_XXX, applied to every new file */
+    unsigned int syncInterval;
+    logfile_syncstats_st syncStats;         /* sync statistics of all files */
+    size_t indexInterval;                   /* sidecar index interval of every new file, 0 means no index */
 } logfilewrapper_st;
 
 /*
@@ -32,6 +43,23 @@ typedef struct logfilewrapper_st {
  */
 extern logfilewrapper_st* logfilewrapper_init(const char* basename, const char* extname, size_t maxSize, unsigned int override);
 
+/*
+ * Brief:	close logfile wrapper, pending background rotations are finished first
+ * Param:	wrapper - a logfile wrapper
+ * Return:	void
+ */
+extern void logfilewrapper_close(logfilewrapper_st* wrapper);
+
+/*
+ * Brief:	open the next file ahead and rotate in background, a record crossing max size then only
+ *          swaps file pointers, close and rename of the full file run in a background thread,
+ *          only used when override is 0
+ * Param:	wrapper - a logfile wrapper
+ * Return:	0.ok
+ *          1.can not start background rotation
+ */
+extern unsigned int logfilewrapper_prepare(logfilewrapper_st* wrapper);
+
 /*
  * Brief:	get is logfile wrapper enable
  * Param:	logrecord - a log record
@@ -48,6 +76,51 @@ extern unsigned int logfilewrapper_isenable(logfilewrapper_st* wrapper);
  */
 extern void logfilewrapper_enable(logfilewrapper_st* wrapper, unsigned int enable);
 
+/*
+ * Brief:	set handler called after a file is rotated, only when override is 0, should return quickly,
+ *          called in background thread after logfilewrapper_prepare
+ * Param:	wrapper - a logfile wrapper
+ *          handler - rotate handler, NULL means none
+ *          param - parameter passed to handler
+ * Return:	void
+ */
+extern void logfilewrapper_onrotate(logfilewrapper_st* wrapper, logfilewrapper_callback_rotate handler, void* param);
+
+/*
+ * Brief:	set durability policy of current and later files
+ * Param:	wrapper - a logfile wrapper
+ *          policy - LOGFILE_SYNC_XXX
+ *          interval - milliseconds between syncs, for LOGFILE_SYNC_INTERVAL
+ * Return:	void
+ */
+extern void logfilewrapper_setsync(logfilewrapper_st* wrapper, unsigned int policy, unsigned int interval);
+
+/*
+ * Brief:	write a sidecar index for current and later files, rotated files keep their index
+ *          under the rotated name + LOGFILE_INDEX_EXT
+ * Param:	wrapper - a logfile wrapper
+ *          interval - min bytes of log between entries, e.g. LOGFILE_INDEX_DEFAULT_INTERVAL
+ * Return:	0.ok
+ *          1.can not open index of current file
+ */
+extern unsigned int logfilewrapper_setindex(logfilewrapper_st* wrapper, size_t interval);
+
+/*
+ * Brief:	called by a batching writer after each batch and when idle, see logfile_commit
+ * Param:	wrapper - a logfile wrapper
+ * Return:	0.ok or nothing to sync
+ *          1.sync fail
+ */
+extern unsigned int logfilewrapper_commit(logfilewrapper_st* wrapper);
+
+/*
+ * Brief:	get sync statistics of all files written by the wrapper
+ * Param:	wrapper - a logfile wrapper
+ *          stats - output statistics
+ * Return:	void
+ */
+extern void logfilewrapper_syncstats(logfilewrapper_st* wrapper, logfile_syncstats_st* stats);
+
 /*
  * Brief:	record log to file
  * Param:	logrecord - a logfile wrapper
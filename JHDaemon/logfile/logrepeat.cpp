@@ -0,0 +1,231 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log storm suppression, a record repeated within a window is
+*           dropped before it is formatted and counted, the count is
+*           reported as one summary when the window ends
+**********************************************************************/
+#include "logrepeat.h"
+#include <assert.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "logbinary.h"
+
+#define LOG_REPEAT_PROBE    8           /* slots searched from the hashed slot */
+
+struct RepeatSlot {
+    unsigned long long hash;
+    void* key;
+    unsigned long long firstMs;         /* window begin */
+    unsigned long long lastMs;
+    unsigned long long count;           /* repeats dropped in the window */
+    unsigned int length;                /* record length, 0 means free */
+    char record[LOG_REPEAT_MAX_RECORD]; /* first record of the window */
+};
+
+/* copied out of the table, reported after the lock is released */
+struct RepeatSummary {
+    void* key;
+    unsigned long long firstMs;
+    unsigned long long lastMs;
+    unsigned long long count;
+    unsigned int length;
+    char record[LOG_REPEAT_MAX_RECORD];
+};
+
+struct logrepeat_st {
+    logrepeat_st(void) : windowMs(0), handler(NULL), param(NULL), dropped(0) {}
+    unsigned int windowMs;
+    std::vector<RepeatSlot> slots;
+    logrepeat_callback_summary handler;
+    void* param;
+    std::mutex mutex;
+    std::atomic<unsigned long long> dropped;
+};
+
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* FNV-1a of key, format id and string arguments, false when the record is malformed */
+static bool hashRecord(void* key, const char* record, size_t length, unsigned long long& hash) {
+    hash = hashBytes(14695981039346656037ULL, &key, sizeof(key));
+    hash = hashBytes(hash, record + 2, 2);
+    size_t pos = LOG_BINARY_HEAD_SIZE;
+    for (int i = 0, count = (unsigned char)record[1]; i < count; ++i) {
+        if (pos + 1 > length) {
+            return false;
+        }
+        if (LBT_STRING == record[pos]) {
+            unsigned short len = 0;
+            if (pos + 3 > length) {
+                return false;
+            }
+            memcpy(&len, record + pos + 1, 2);
+            if (pos + 3 + len > length) {
+                return false;
+            }
+            hash = hashBytes(hash, record + pos + 1, 2 + len);
+            pos += 3 + len;
+        } else {
+            pos += 9;
+        }
+    }
+    return pos <= length;
+}
+
+static void takeSummary(RepeatSlot* slot, RepeatSummary& summary) {
+    summary.key = slot->key;
+    summary.firstMs = slot->firstMs;
+    summary.lastMs = slot->lastMs;
+    summary.count = slot->count;
+    summary.length = slot->length;
+    memcpy(summary.record, slot->record, slot->length);
+}
+
+static void report(logrepeat_st* lr, const RepeatSummary& summary) {
+    lr->handler(summary.key, summary.record, summary.length, summary.count, summary.firstMs, summary.lastMs, lr->param);
+}
+
+logrepeat_st* logrepeat_open(unsigned int windowMs, size_t slots, logrepeat_callback_summary handler, void* param) {
+    logrepeat_st* lr = NULL;
+    assert(windowMs > 0);
+    assert(slots > 0);
+    assert(handler);
+    lr = new (std::nothrow) logrepeat_st();
+    if (!lr) {
+        return NULL;
+    }
+    lr->windowMs = windowMs;
+    lr->slots.resize(slots);
+    for (size_t i = 0; i < slots; ++i) {
+        lr->slots[i].length = 0;
+    }
+    lr->handler = handler;
+    lr->param = param;
+    return lr;
+}
+
+void logrepeat_close(logrepeat_st* lr) {
+    std::vector<RepeatSummary> summaries;
+    assert(lr);
+    {
+        std::lock_guard<std::mutex> lock(lr->mutex);
+        for (size_t i = 0, len = lr->slots.size(); i < len; ++i) {
+            if (lr->slots[i].length > 0 && lr->slots[i].count > 0) {
+                summaries.push_back(RepeatSummary());
+                takeSummary(&lr->slots[i], summaries.back());
+            }
+        }
+    }
+    for (size_t i = 0, len = summaries.size(); i < len; ++i) {
+        report(lr, summaries[i]);
+    }
+    delete lr;
+}
+
+unsigned int logrepeat_check(logrepeat_st* lr, void* key, const char* record, size_t length, unsigned long long nowMs) {
+    unsigned long long hash = 0;
+    RepeatSummary summary;
+    bool reported = false;
+    unsigned int flag = 0;
+    assert(lr);
+    assert(record);
+    if (length < LOG_BINARY_HEAD_SIZE || length > LOG_REPEAT_MAX_RECORD || !hashRecord(key, record, length, hash)) {
+        return 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(lr->mutex);
+        const size_t slotCount = lr->slots.size();
+        const size_t probe = slotCount < LOG_REPEAT_PROBE ? slotCount : LOG_REPEAT_PROBE;
+        RepeatSlot* found = NULL;
+        RepeatSlot* victim = NULL;      /* free slot, else the least recently repeated */
+        for (size_t i = 0; i < probe; ++i) {
+            RepeatSlot* slot = &lr->slots[(hash + i) % slotCount];
+            if (slot->length > 0 && hash == slot->hash && key == slot->key) {
+                found = slot;
+                break;
+            }
+            if (!victim || (0 == slot->length && victim->length > 0) ||
+                (slot->length > 0 && victim->length > 0 && slot->lastMs < victim->lastMs)) {
+                victim = slot;
+            }
+        }
+        if (found) {
+            if (nowMs < found->firstMs + lr->windowMs) {
+                ++found->count;
+                found->lastMs = nowMs;
+                flag = 1;
+            } else {
+                if (found->count > 0) {
+                    /* still repeating, report the window and count this one in the next */
+                    takeSummary(found, summary);
+                    reported = true;
+                    flag = 1;
+                }
+                found->firstMs = nowMs;
+                found->lastMs = nowMs;
+                found->count = reported ? 1 : 0;
+            }
+        } else {
+            if (victim->length > 0 && victim->count > 0) {
+                takeSummary(victim, summary);
+                reported = true;
+            }
+            victim->hash = hash;
+            victim->key = key;
+            victim->firstMs = nowMs;
+            victim->lastMs = nowMs;
+            victim->count = 0;
+            victim->length = (unsigned int)length;
+            memcpy(victim->record, record, length);
+        }
+    }
+    if (flag) {
+        lr->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (reported) {
+        report(lr, summary);
+    }
+    return flag;
+}
+
+void logrepeat_expire(logrepeat_st* lr, unsigned long long nowMs) {
+    std::vector<RepeatSummary> summaries;
+    assert(lr);
+    {
+        std::lock_guard<std::mutex> lock(lr->mutex);
+        for (size_t i = 0, len = lr->slots.size(); i < len; ++i) {
+            RepeatSlot* slot = &lr->slots[i];
+            if (0 == slot->length || nowMs < slot->firstMs + lr->windowMs) {
+                continue;
+            }
+            if (0 == slot->count) {
+                slot->length = 0;
+                continue;
+            }
+            /* a storm which goes on stays folded, the slot is forgotten after a quiet window */
+            summaries.push_back(RepeatSummary());
+            takeSummary(slot, summaries.back());
+            slot->firstMs = nowMs;
+            slot->lastMs = nowMs;
+            slot->count = 0;
+        }
+    }
+    for (size_t i = 0, len = summaries.size(); i < len; ++i) {
+        report(lr, summaries[i]);
+    }
+}
+
+unsigned long long logrepeat_dropped(logrepeat_st* lr) {
+    assert(lr);
+    return lr->dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log storm suppression, a record repeated within a window is
+*           dropped before it is formatted and counted, the count is
+*           reported as one summary when the window ends
+**********************************************************************/
+#ifndef _LOG_REPEAT_H_
+#define _LOG_REPEAT_H_
+
+#include <stddef.h>
+
+#define LOG_REPEAT_DEFAULT_WINDOW   60000       /* milliseconds */
+#define LOG_REPEAT_DEFAULT_SLOTS    256
+#define LOG_REPEAT_MAX_RECORD       512         /* longer records are never folded */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logrepeat_st logrepeat_st;
+
+/*
+ * called with the first record of a window whose repeats were dropped, never while the table is locked,
+ * so it can record logs, record is a binary log record as encoded by LogBinary::encode
+ */
+typedef void (*logrepeat_callback_summary)(void* key, const char* record, size_t length, unsigned long long count,
+                                           unsigned long long firstMs, unsigned long long lastMs, void* param);
+
+/*
+ * Brief:	open a repeat table
+ * Param:	windowMs - window length in milliseconds
+ *          slots - table size, e.g. LOG_REPEAT_DEFAULT_SLOTS, the oldest record is evicted when it is full
+ *          handler - summary handler
+ *          param - parameter passed to handler
+ * Return:	logrepeat_st*
+ */
+extern logrepeat_st* logrepeat_open(unsigned int windowMs, size_t slots, logrepeat_callback_summary handler, void* param);
+
+/*
+ * Brief:	report pending summaries and close
+ * Param:	lr - repeat table
+ * Return:	void
+ */
+extern void logrepeat_close(logrepeat_st* lr);
+
+/*
+ * Brief:	check a record before it is formatted, can be called in any thread, records are equal when
+ *          key, format id and string arguments are equal, numeric arguments like pids are ignored,
+ *          a repeat which arrives after its window ended reports the summary first, and while repeats
+ *          keep coming the record is not written again, only one summary per window
+ * Param:	lr - repeat table
+ *          key - e.g. the channel, records of different keys are never equal
+ *          record - binary log record, its time is ignored
+ *          length - record length
+ *          nowMs - current time in milliseconds
+ * Return:	0.record it
+ *          1.repeat, drop it
+ */
+extern unsigned int logrepeat_check(logrepeat_st* lr, void* key, const char* record, size_t length, unsigned long long nowMs);
+
+/*
+ * Brief:	report summaries of ended windows and forget records which were not repeated in their window,
+ *          call it periodically, e.g. every second
+ * Param:	lr - repeat table
+ *          nowMs - current time in milliseconds
+ * Return:	void
+ */
+extern void logrepeat_expire(logrepeat_st* lr, unsigned long long nowMs);
+
+/*
+ * Brief:	get count of dropped records
+ * Param:	lr - repeat table
+ * Return:	unsigned long long
+ */
+extern unsigned long long logrepeat_dropped(logrepeat_st* lr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOG_REPEAT_H_
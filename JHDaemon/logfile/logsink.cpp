@@ -0,0 +1,474 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log sink pipeline, a record is copied once into a pooled
+*           buffer and shared by reference with every sink, each sink
+*           has its own queue and backpressure policy
+**********************************************************************/
+#include "logsink.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logchannel.h"
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define LOG_SINK_FACILITY   3           /* syslog facility daemon */
+
+/* a published record, shared by every sink until the last one releases it */
+struct LogSinkMessage {
+    LogSinkMessage(void) : refs(0), pipe(NULL), data(buffer), pooled(false) {}
+    std::atomic<unsigned int> refs;
+    logsinkpipe_st* pipe;
+    logsink_record_st record;
+    char* data;                         /* buffer, or allocated for a long record, null terminated */
+    bool pooled;
+    char buffer[LOG_SINK_POOL_BUFFER];
+};
+
+struct logsink_st {
+    logsink_st(void) : queueSize(0), policy(LOG_SINK_DROP), writer(NULL), param(NULL), destroy(NULL), exit(false),
+                       written(0), dropped(0), blocked(0), failed(0) {}
+    std::string name;
+    size_t queueSize;                   /* 0 means written in the publishing thread */
+    unsigned int policy;
+    logsink_callback_write writer;
+    void* param;
+    void (*destroy)(void* param);       /* frees param of the builtin sinks */
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable spaceCondition;
+    std::deque<LogSinkMessage*> queue;
+    std::thread thread;
+    bool exit;
+    std::atomic<unsigned long long> written;
+    std::atomic<unsigned long long> dropped;
+    std::atomic<unsigned long long> blocked;
+    std::atomic<unsigned long long> failed;
+};
+
+struct logsinkpipe_st {
+    logsinkpipe_st(void) : pool(NULL) {}
+    std::vector<logsink_st*> sinks;
+    LogSinkMessage* pool;
+    std::vector<LogSinkMessage*> freeList;
+    std::mutex poolMutex;
+};
+
+struct LogSinkRing {
+    LogSinkRing(void) : head(0) {}
+    std::mutex mutex;
+    std::vector<char> buf;
+    unsigned long long head;            /* bytes written since open */
+};
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+struct LogSinkDatagram {
+    LogSinkDatagram(void) : fd(-1) {}
+    int fd;
+    struct sockaddr_un addr;
+    std::string ident;
+    std::string packet;                 /* only used by the writer thread */
+};
+#endif
+
+static void releaseMessage(LogSinkMessage* msg) {
+    if (1 != msg->refs.fetch_sub(1, std::memory_order_acq_rel)) {
+        return;
+    }
+    if (msg->pooled) {
+        logsinkpipe_st* lp = msg->pipe;
+        std::lock_guard<std::mutex> lock(lp->poolMutex);
+        lp->freeList.push_back(msg);
+        return;
+    }
+    if (msg->data != msg->buffer) {
+        delete[] msg->data;
+    }
+    delete msg;
+}
+
+static LogSinkMessage* acquireMessage(logsinkpipe_st* lp, size_t length) {
+    LogSinkMessage* msg = NULL;
+    if (length < LOG_SINK_POOL_BUFFER) {
+        std::lock_guard<std::mutex> lock(lp->poolMutex);
+        if (!lp->freeList.empty()) {
+            msg = lp->freeList.back();
+            lp->freeList.pop_back();
+            return msg;
+        }
+    }
+    /* pool is exhausted or the record is long */
+    msg = new (std::nothrow) LogSinkMessage();
+    if (!msg) {
+        return NULL;
+    }
+    if (length >= LOG_SINK_POOL_BUFFER) {
+        msg->data = new (std::nothrow) char[length + 1];
+        if (!msg->data) {
+            delete msg;
+            return NULL;
+        }
+    }
+    msg->pipe = lp;
+    return msg;
+}
+
+/* return 1 when the writer failed */
+static unsigned int writeMessage(logsink_st* sink, LogSinkMessage* msg) {
+    if (0 == sink->writer(&msg->record, sink->param)) {
+        sink->written.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    sink->failed.fetch_add(1, std::memory_order_relaxed);
+    return 1;
+}
+
+static void sinkThread(logsink_st* sink) {
+    std::deque<LogSinkMessage*> batch;
+    while (1) {
+        {
+            std::unique_lock<std::mutex> lock(sink->mutex);
+            sink->wakeCondition.wait(lock, [sink]()->bool {
+                return sink->exit || !sink->queue.empty();
+            });
+            if (sink->queue.empty()) {
+                break;
+            }
+            batch.swap(sink->queue);
+        }
+        sink->spaceCondition.notify_all();
+        for (size_t i = 0, len = batch.size(); i < len; ++i) {
+            writeMessage(sink, batch[i]);
+            releaseMessage(batch[i]);
+        }
+        batch.clear();
+        sink->writer(NULL, sink->param);
+    }
+}
+
+/* return 1 when the sink dropped a record, or an inline sink failed to write it */
+static unsigned int pushMessage(logsink_st* sink, LogSinkMessage* msg) {
+    if (0 == sink->queueSize) {
+        unsigned int ret = writeMessage(sink, msg);
+        sink->writer(NULL, sink->param);
+        releaseMessage(msg);
+        return ret;
+    }
+    LogSinkMessage* oldest = NULL;
+    bool wasEmpty = false;
+    {
+        std::unique_lock<std::mutex> lock(sink->mutex);
+        if (sink->queue.size() >= sink->queueSize) {
+            if (LOG_SINK_BLOCK == sink->policy) {
+                sink->blocked.fetch_add(1, std::memory_order_relaxed);
+                sink->spaceCondition.wait(lock, [sink]()->bool {
+                    return sink->exit || sink->queue.size() < sink->queueSize;
+                });
+            } else if (LOG_SINK_DROP_OLDEST == sink->policy) {
+                oldest = sink->queue.front();
+                sink->queue.pop_front();
+            } else {
+                lock.unlock();
+                sink->dropped.fetch_add(1, std::memory_order_relaxed);
+                releaseMessage(msg);
+                return 1;
+            }
+        }
+        wasEmpty = sink->queue.empty();
+        sink->queue.push_back(msg);
+    }
+    /* the writer only waits when the queue is empty */
+    if (wasEmpty) {
+        sink->wakeCondition.notify_one();
+    }
+    if (oldest) {
+        sink->dropped.fetch_add(1, std::memory_order_relaxed);
+        releaseMessage(oldest);
+        return 1;
+    }
+    return 0;
+}
+
+static logsink_st* openSink(const char* name, size_t queueSize, unsigned int policy, logsink_callback_write writer,
+                            void* param, void (*destroy)(void*)) {
+    logsink_st* sink = NULL;
+    assert(name);
+    assert(writer);
+    sink = new (std::nothrow) logsink_st();
+    if (!sink) {
+        return NULL;
+    }
+    sink->name = name;
+    sink->queueSize = queueSize;
+    sink->policy = policy;
+    sink->writer = writer;
+    sink->param = param;
+    sink->destroy = destroy;
+    if (queueSize > 0) {
+        sink->thread = std::thread(sinkThread, sink);
+    }
+    return sink;
+}
+
+static unsigned int consoleWrite(const logsink_record_st* record, void*) {
+    if (!record) {
+        fflush(stdout);
+        return 0;
+    }
+    return record->length == fwrite(record->text, 1, record->length, stdout) ? 0 : 1;
+}
+
+static unsigned int ringWrite(const logsink_record_st* record, void* param) {
+    LogSinkRing* ring = (LogSinkRing*)param;
+    if (!record) {
+        return 0;
+    }
+    const size_t capacity = ring->buf.size();
+    const char* text = record->text;
+    size_t length = record->length;
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    if (length > capacity) {
+        ring->head += length - capacity;
+        text += length - capacity;
+        length = capacity;
+    }
+    size_t pos = (size_t)(ring->head % capacity);
+    size_t first = capacity - pos < length ? capacity - pos : length;
+    memcpy(&ring->buf[pos], text, first);
+    memcpy(&ring->buf[0], text + first, length - first);
+    ring->head += length;
+    return 0;
+}
+
+static void ringDestroy(void* param) {
+    delete (LogSinkRing*)param;
+}
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+static unsigned int datagramWrite(const logsink_record_st* record, void* param) {
+    LogSinkDatagram* dg = (LogSinkDatagram*)param;
+    static const unsigned int severities[] = { 7, 6, 4, 3 };    /* debug, info, warning, error */
+    if (!record) {
+        return 0;
+    }
+    char head[32];
+    unsigned int severity = record->level < LOG_LEVEL_NONE ? severities[record->level] : 6;
+    int headLength = snprintf(head, sizeof(head), "<%u>", LOG_SINK_FACILITY * 8 + severity);
+    size_t length = record->length - record->offset;
+    if (length > 0 && '\n' == record->text[record->offset + length - 1]) {
+        --length;
+    }
+    dg->packet.assign(head, headLength);
+    dg->packet.append(dg->ident);
+    dg->packet.append(": ", 2);
+    dg->packet.append(record->text + record->offset, length);
+    /* a stalled receiver fails the send instead of blocking close */
+    ssize_t ret = sendto(dg->fd, dg->packet.data(), dg->packet.size(), MSG_DONTWAIT, (const struct sockaddr*)&dg->addr, sizeof(dg->addr));
+    return ret == (ssize_t)dg->packet.size() ? 0 : 1;
+}
+
+static void datagramDestroy(void* param) {
+    LogSinkDatagram* dg = (LogSinkDatagram*)param;
+    close(dg->fd);
+    delete dg;
+}
+#endif
+
+logsink_st* logsink_open(const char* name, size_t queueSize, unsigned int policy, logsink_callback_write writer, void* param) {
+    return openSink(name, queueSize, policy, writer, param, NULL);
+}
+
+logsink_st* logsink_console(size_t queueSize, unsigned int policy) {
+    return openSink("console", queueSize, policy, consoleWrite, NULL, NULL);
+}
+
+logsink_st* logsink_datagram(const char* path, const char* ident, size_t queueSize, unsigned int policy) {
+    assert(path);
+    assert(ident);
+    assert(queueSize > 0);
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    return NULL;
+#else
+    LogSinkDatagram* dg = NULL;
+    logsink_st* sink = NULL;
+    if (strlen(path) >= sizeof(dg->addr.sun_path)) {
+        return NULL;
+    }
+    dg = new (std::nothrow) LogSinkDatagram();
+    if (!dg) {
+        return NULL;
+    }
+    dg->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (dg->fd < 0) {
+        delete dg;
+        return NULL;
+    }
+    memset(&dg->addr, 0, sizeof(dg->addr));
+    dg->addr.sun_family = AF_UNIX;
+    strcpy(dg->addr.sun_path, path);
+    dg->ident = ident;
+    sink = openSink(path, queueSize, policy, datagramWrite, dg, datagramDestroy);
+    if (!sink) {
+        datagramDestroy(dg);
+    }
+    return sink;
+#endif
+}
+
+logsink_st* logsink_ring(size_t capacity) {
+    LogSinkRing* ring = NULL;
+    logsink_st* sink = NULL;
+    assert(capacity > 0);
+    ring = new (std::nothrow) LogSinkRing();
+    if (!ring) {
+        return NULL;
+    }
+    ring->buf.resize(capacity);
+    sink = openSink("ring", 0, LOG_SINK_DROP, ringWrite, ring, ringDestroy);
+    if (!sink) {
+        ringDestroy(ring);
+    }
+    return sink;
+}
+
+size_t logsink_ringread(logsink_st* sink, char* buf, size_t size) {
+    assert(sink);
+    assert(ringWrite == sink->writer);
+    assert(buf);
+    LogSinkRing* ring = (LogSinkRing*)sink->param;
+    const size_t capacity = ring->buf.size();
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    size_t length = ring->head < capacity ? (size_t)ring->head : capacity;
+    bool partial = ring->head > capacity;
+    if (length > size) {
+        length = size;
+        partial = true;
+    }
+    unsigned long long start = ring->head - length;
+    /* the oldest record may be cut, begin after its end */
+    while (partial && length > 0) {
+        --length;
+        if ('\n' == ring->buf[(size_t)(start++ % capacity)]) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < length; ++i) {
+        buf[i] = ring->buf[(size_t)((start + i) % capacity)];
+    }
+    return length;
+}
+
+void logsink_close(logsink_st* sink) {
+    assert(sink);
+    if (sink->thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(sink->mutex);
+            sink->exit = true;
+        }
+        sink->wakeCondition.notify_one();
+        sink->spaceCondition.notify_all();
+        sink->thread.join();
+    }
+    if (sink->destroy) {
+        sink->destroy(sink->param);
+    }
+    delete sink;
+}
+
+const char* logsink_name(logsink_st* sink) {
+    assert(sink);
+    return sink->name.c_str();
+}
+
+void logsink_stats(logsink_st* sink, logsink_stats_st* stats) {
+    assert(sink);
+    assert(stats);
+    stats->written = sink->written.load(std::memory_order_relaxed);
+    stats->dropped = sink->dropped.load(std::memory_order_relaxed);
+    stats->blocked = sink->blocked.load(std::memory_order_relaxed);
+    stats->failed = sink->failed.load(std::memory_order_relaxed);
+}
+
+logsinkpipe_st* logsinkpipe_open(size_t poolCount) {
+    logsinkpipe_st* lp = new (std::nothrow) logsinkpipe_st();
+    if (!lp) {
+        return NULL;
+    }
+    if (poolCount > 0) {
+        lp->pool = new (std::nothrow) LogSinkMessage[poolCount];
+        if (!lp->pool) {
+            delete lp;
+            return NULL;
+        }
+        lp->freeList.reserve(poolCount);
+        for (size_t i = 0; i < poolCount; ++i) {
+            lp->pool[i].pipe = lp;
+            lp->pool[i].pooled = true;
+            lp->freeList.push_back(&lp->pool[i]);
+        }
+    }
+    return lp;
+}
+
+void logsinkpipe_close(logsinkpipe_st* lp) {
+    assert(lp);
+    /* queued records are written and released before the pool is freed */
+    for (size_t i = 0, len = lp->sinks.size(); i < len; ++i) {
+        logsink_close(lp->sinks[i]);
+    }
+    delete[] lp->pool;
+    delete lp;
+}
+
+void logsinkpipe_add(logsinkpipe_st* lp, logsink_st* sink) {
+    assert(lp);
+    assert(sink);
+    lp->sinks.push_back(sink);
+}
+
+size_t logsinkpipe_count(logsinkpipe_st* lp) {
+    assert(lp);
+    return lp->sinks.size();
+}
+
+logsink_st* logsinkpipe_get(logsinkpipe_st* lp, size_t index) {
+    assert(lp);
+    assert(index < lp->sinks.size());
+    return lp->sinks[index];
+}
+
+unsigned int logsinkpipe_publish(logsinkpipe_st* lp, const logsink_record_st* record) {
+    unsigned int dropped = 0;
+    assert(lp);
+    assert(record);
+    const size_t count = lp->sinks.size();
+    if (0 == count) {
+        return 0;
+    }
+    LogSinkMessage* msg = acquireMessage(lp, record->length);
+    if (!msg) {
+        return (unsigned int)count;
+    }
+    memcpy(msg->data, record->text, record->length);
+    msg->data[record->length] = '\0';
+    msg->record = *record;
+    msg->record.text = msg->data;
+    /* one reference per sink, the last sink returns the buffer to the pool */
+    msg->refs.store((unsigned int)count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        dropped += pushMessage(lp->sinks[i], msg);
+    }
+    return dropped;
+}
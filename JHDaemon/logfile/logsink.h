@@ -0,0 +1,172 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log sink pipeline, a record is copied once into a pooled
+*           buffer and shared by reference with every sink, each sink
+*           has its own queue and backpressure policy
+**********************************************************************/
+#ifndef _LOG_SINK_H_
+#define _LOG_SINK_H_
+
+#include <stddef.h>
+
+#define LOG_SINK_POOL_BUFFER        512         /* pooled buffer size, longer records are allocated */
+#define LOG_SINK_DEFAULT_POOL       1024        /* pooled buffers, more are allocated when all are in use */
+#define LOG_SINK_DEFAULT_QUEUE      1024        /* records */
+#define LOG_SINK_DEFAULT_RING       64*1024L    /* bytes */
+
+/* backpressure policy, what the publisher does when a sink queue is full */
+#define LOG_SINK_BLOCK          0       /* wait until the sink writes, only for sinks which must not lose records */
+#define LOG_SINK_DROP           1       /* drop the new record */
+#define LOG_SINK_DROP_OLDEST    2       /* drop the oldest queued record */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct logsink_st logsink_st;
+typedef struct logsinkpipe_st logsinkpipe_st;
+
+typedef struct logsink_record_st {
+    void* key;                          /* set by the publisher, e.g. the channel */
+    unsigned int level;                 /* LOG_LEVEL_XXX */
+    unsigned long long ms;              /* milliseconds since 1970-01-01 00:00:00 */
+    const char* text;                   /* formatted record, e.g. "[time] content", sinks get a null terminated copy */
+    size_t length;
+    size_t offset;                      /* content begins at text + offset, after the time */
+} logsink_record_st;
+
+typedef struct logsink_stats_st {
+    unsigned long long written;         /* records written */
+    unsigned long long dropped;         /* records dropped by the backpressure policy */
+    unsigned long long blocked;         /* records which waited for space */
+    unsigned long long failed;          /* records the writer failed to write */
+} logsink_stats_st;
+
+/*
+ * write a record, record is NULL when a batch ends, e.g. to flush, the record is only valid in the call
+ * return 0 when written
+ */
+typedef unsigned int (*logsink_callback_write)(const logsink_record_st* record, void* param);
+
+/*
+ * Brief:	open a sink
+ * Param:	name - sink name
+ *          queueSize - queued records, 0 means records are written in the publishing threads, so the
+ *                      writer can be called in several threads at once, else the sink has its own writer thread
+ *          policy - backpressure policy, LOG_SINK_XXX
+ *          writer - write handler
+ *          param - parameter passed to writer
+ * Return:	logsink_st*
+ */
+extern logsink_st* logsink_open(const char* name, size_t queueSize, unsigned int policy, logsink_callback_write writer, void* param);
+
+/*
+ * Brief:	open a sink which writes records to stdout
+ * Param:	queueSize - queued records, a slow console drops records instead of blocking when it is not 0
+ *          policy - backpressure policy, LOG_SINK_XXX
+ * Return:	logsink_st*
+ */
+extern logsink_st* logsink_console(size_t queueSize, unsigned int policy);
+
+/*
+ * Brief:	open a sink which sends every record as one syslog style datagram "<priority>ident: content"
+ *          to a unix datagram socket, e.g. "/dev/log", not supported on windows
+ * Param:	path - socket path
+ *          ident - program name in datagrams
+ *          queueSize - queued records, must not be 0, a datagram which the receiver has no room for is counted as failed
+ *          policy - backpressure policy, LOG_SINK_XXX
+ * Return:	logsink_st*, NULL when the socket can not be created
+ */
+extern logsink_st* logsink_datagram(const char* path, const char* ident, size_t queueSize, unsigned int policy);
+
+/*
+ * Brief:	open a sink which keeps the newest records in memory, written in the publishing thread
+ * Param:	capacity - ring size in bytes
+ * Return:	logsink_st*
+ */
+extern logsink_st* logsink_ring(size_t capacity);
+
+/*
+ * Brief:	copy the records kept by a ring sink, oldest first, a record partly overwritten is skipped
+ * Param:	sink - ring sink
+ *          buf - output buffer
+ *          size - buffer size
+ * Return:	size_t, bytes copied
+ */
+extern size_t logsink_ringread(logsink_st* sink, char* buf, size_t size);
+
+/*
+ * Brief:	write queued records and close a sink which is not added to a pipeline
+ * Param:	sink - sink
+ * Return:	void
+ */
+extern void logsink_close(logsink_st* sink);
+
+/*
+ * Brief:	get sink name
+ * Param:	sink - sink
+ * Return:	const char*
+ */
+extern const char* logsink_name(logsink_st* sink);
+
+/*
+ * Brief:	get statistics
+ * Param:	sink - sink
+ *          stats - output statistics
+ * Return:	void
+ */
+extern void logsink_stats(logsink_st* sink, logsink_stats_st* stats);
+
+/*
+ * Brief:	open a pipeline
+ * Param:	poolCount - pooled buffers, e.g. LOG_SINK_DEFAULT_POOL
+ * Return:	logsinkpipe_st*
+ */
+extern logsinkpipe_st* logsinkpipe_open(size_t poolCount);
+
+/*
+ * Brief:	write queued records, close every sink and the pipeline
+ * Param:	lp - pipeline
+ * Return:	void
+ */
+extern void logsinkpipe_close(logsinkpipe_st* lp);
+
+/*
+ * Brief:	add a sink, the pipeline owns it, call before publishing
+ * Param:	lp - pipeline
+ *          sink - sink
+ * Return:	void
+ */
+extern void logsinkpipe_add(logsinkpipe_st* lp, logsink_st* sink);
+
+/*
+ * Brief:	get count of sinks
+ * Param:	lp - pipeline
+ * Return:	size_t
+ */
+extern size_t logsinkpipe_count(logsinkpipe_st* lp);
+
+/*
+ * Brief:	get a sink
+ * Param:	lp - pipeline
+ *          index - sink index, in order of adding
+ * Return:	logsink_st*
+ */
+extern logsink_st* logsinkpipe_get(logsinkpipe_st* lp, size_t index);
+
+/*
+ * Brief:	publish a record to every sink, can be called in any thread, the text is copied once,
+ *          a sink with a queue never blocks the publisher unless its policy is LOG_SINK_BLOCK
+ * Param:	lp - pipeline
+ *          record - record, text is copied
+ * Return:	unsigned int, count of sinks which dropped the record, a sink without queue counts when its writer failed
+ */
+extern unsigned int logsinkpipe_publish(logsinkpipe_st* lp, const logsink_record_st* record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOG_SINK_H_
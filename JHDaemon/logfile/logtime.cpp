@@ -0,0 +1,154 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log timestamp, the "%Y-%m-%d %H:%M:%S" text is formatted once
+*           per second and shared by every thread, milliseconds come from
+*           the monotonic clock offset to the last formatted second
+**********************************************************************/
+#include "logtime.h"
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+
+#define LOGTIME_WORDS   3       /* cached text stored as words so readers never race on plain bytes */
+
+/*
+ * seqlock guarded cache, the updater makes seq odd, stores and makes it even again,
+ * readers retry or fall back to formatting when seq changed under them
+ */
+struct LogTimeCache {
+    std::atomic<unsigned int> seq;
+    std::atomic<long long> second;                  /* cached second, -1 when empty */
+    std::atomic<unsigned long long> anchorMs;       /* wall clock at the last update */
+    std::atomic<long long> anchorSteady;            /* steady clock nanoseconds at the last update */
+    std::atomic<unsigned long long> text[LOGTIME_WORDS];
+};
+
+static LogTimeCache s_cache = { { 0 }, { -1 }, { 0 }, { 0 }, { { 0 }, { 0 }, { 0 } } };
+
+static long long steadyNs(void) {
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned long long systemMs(void) {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void formatSecond(long long second, char* text) {
+    time_t t = (time_t)second;
+    struct tm date;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    localtime_s(&date, &t);
+#else
+    localtime_r(&t, &date);
+#endif
+    strftime(text, LOGTIME_WORDS * sizeof(unsigned long long), "%Y-%m-%d %H:%M:%S", &date);
+}
+
+/* publish a formatted second, skipped when another thread is updating */
+static void updateCache(long long second, const char* text, unsigned long long anchorMs, long long anchorSteady) {
+    unsigned long long words[LOGTIME_WORDS];
+    unsigned int seq = s_cache.seq.load(std::memory_order_relaxed);
+    if (seq & 1) {
+        return;
+    }
+    if (!s_cache.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire)) {
+        return;
+    }
+    memcpy(words, text, sizeof(words));
+    s_cache.second.store(second, std::memory_order_relaxed);
+    s_cache.anchorMs.store(anchorMs, std::memory_order_relaxed);
+    s_cache.anchorSteady.store(anchorSteady, std::memory_order_relaxed);
+    for (int i = 0; i < LOGTIME_WORDS; ++i) {
+        s_cache.text[i].store(words[i], std::memory_order_relaxed);
+    }
+    s_cache.seq.store(seq + 2, std::memory_order_release);
+}
+
+/* read a consistent snapshot, return false if an update was running */
+static bool readCache(long long& second, unsigned long long& anchorMs, long long& anchorSteady, char* text) {
+    unsigned long long words[LOGTIME_WORDS];
+    unsigned int seq = s_cache.seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+        return false;
+    }
+    second = s_cache.second.load(std::memory_order_relaxed);
+    anchorMs = s_cache.anchorMs.load(std::memory_order_relaxed);
+    anchorSteady = s_cache.anchorSteady.load(std::memory_order_relaxed);
+    for (int i = 0; i < LOGTIME_WORDS; ++i) {
+        words[i] = s_cache.text[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s_cache.seq.load(std::memory_order_relaxed) != seq) {
+        return false;
+    }
+    if (text) {
+        memcpy(text, words, sizeof(words));
+    }
+    return true;
+}
+
+/* ".mmm" with integer writes */
+static size_t appendMs(char* buf, size_t length, unsigned int ms) {
+    buf[length] = '.';
+    buf[length + 1] = (char)('0' + ms / 100);
+    buf[length + 2] = (char)('0' + ms / 10 % 10);
+    buf[length + 3] = (char)('0' + ms % 10);
+    buf[length + 4] = '\0';
+    return length + 4;
+}
+
+/* current time and its formatted second, the wall clock is read only when the second changes */
+static unsigned long long nowMs(char* text) {
+    long long second = -1;
+    unsigned long long anchorMs = 0;
+    long long anchorSteady = 0;
+    long long steady = steadyNs();
+    if (readCache(second, anchorMs, anchorSteady, text) && second >= 0 && steady >= anchorSteady) {
+        unsigned long long ms = anchorMs + (unsigned long long)((steady - anchorSteady) / 1000000);
+        if ((long long)(ms / 1000) == second) {
+            return ms;
+        }
+    }
+    unsigned long long ms = systemMs();
+    char buf[LOGTIME_WORDS * sizeof(unsigned long long)] = { 0 };
+    formatSecond((long long)(ms / 1000), buf);
+    updateCache((long long)(ms / 1000), buf, ms, steady);
+    if (text) {
+        memcpy(text, buf, sizeof(buf));
+    }
+    return ms;
+}
+
+unsigned long long logtime_now_ms(void) {
+    return nowMs(NULL);
+}
+
+size_t logtime_now(char* buf, size_t size, unsigned int withms) {
+    char text[LOGTIME_WORDS * sizeof(unsigned long long)];
+    if (!buf || size < (withms ? LOGTIME_MS_LENGTH : LOGTIME_LENGTH) + 1) {
+        return 0;
+    }
+    unsigned long long ms = nowMs(text);
+    memcpy(buf, text, LOGTIME_LENGTH);
+    buf[LOGTIME_LENGTH] = '\0';
+    return withms ? appendMs(buf, LOGTIME_LENGTH, (unsigned int)(ms % 1000)) : LOGTIME_LENGTH;
+}
+
+size_t logtime_format(unsigned long long ms, char* buf, size_t size, unsigned int withms) {
+    char text[LOGTIME_WORDS * sizeof(unsigned long long)] = { 0 };
+    long long second = -1;
+    unsigned long long anchorMs = 0;
+    long long anchorSteady = 0;
+    if (!buf || size < (withms ? LOGTIME_MS_LENGTH : LOGTIME_LENGTH) + 1) {
+        return 0;
+    }
+    /* only the current second is cached, older times such as offline rendering are formatted directly */
+    if (!readCache(second, anchorMs, anchorSteady, text) || (long long)(ms / 1000) != second) {
+        formatSecond((long long)(ms / 1000), text);
+    }
+    memcpy(buf, text, LOGTIME_LENGTH);
+    buf[LOGTIME_LENGTH] = '\0';
+    return withms ? appendMs(buf, LOGTIME_LENGTH, (unsigned int)(ms % 1000)) : LOGTIME_LENGTH;
+}
@@ -0,0 +1,51 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log timestamp, the "%Y-%m-%d %H:%M:%S" text is formatted once
+*           per second and shared by every thread, milliseconds come from
+*           the monotonic clock offset to the last formatted second
+**********************************************************************/
+#ifndef _LOG_TIME_H_
+#define _LOG_TIME_H_
+
+#include <stddef.h>
+
+#define LOGTIME_LENGTH      19      /* "YYYY-mm-dd HH:MM:SS" */
+#define LOGTIME_MS_LENGTH   23      /* "YYYY-mm-dd HH:MM:SS.mmm" */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Brief:	get current time
+ * Param:	void
+ * Return:	unsigned long long, milliseconds since 1970-01-01 00:00:00
+ */
+extern unsigned long long logtime_now_ms(void);
+
+/*
+ * Brief:	format current time as "YYYY-mm-dd HH:MM:SS[.mmm]", can be called in any thread
+ * Param:	buf - output buffer, terminated by '\0'
+ *          size - buffer size, at least LOGTIME_MS_LENGTH + 1 with milliseconds
+ *          withms - with milliseconds, 0.false, 1.true
+ * Return:	size_t, text length, 0 if buffer is too small
+ */
+extern size_t logtime_now(char* buf, size_t size, unsigned int withms);
+
+/*
+ * Brief:	format a time as "YYYY-mm-dd HH:MM:SS[.mmm]", can be called in any thread
+ * Param:	ms - milliseconds since 1970-01-01 00:00:00
+ *          buf - output buffer, terminated by '\0'
+ *          size - buffer size, at least LOGTIME_MS_LENGTH + 1 with milliseconds
+ *          withms - with milliseconds, 0.false, 1.true
+ * Return:	size_t, text length, 0 if buffer is too small
+ */
+extern size_t logtime_format(unsigned long long ms, char* buf, size_t size, unsigned int withms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _LOG_TIME_H_
@@ -0,0 +1,78 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	log formats of JHDaemon, binary log records keep only the id,
+*           jhlogcat renders them with the same table
+**********************************************************************/
+#ifndef _LOG_FORMATS_H_
+#define _LOG_FORMATS_H_
+
+#include <stddef.h>
+#include "logfile/logchannel.h"
+
+/*
+ * LOG_FORMAT(name, id, level, format), every "{}" is replaced by the next argument,
+ * ids are written to log files, so only append new formats and never reuse an id,
+ * level is LOG_LEVEL_XXX, formats below LOG_COMPILE_LEVEL are removed at compile time,
+ * LF_LOG_REPEATED is written with the level of the repeated record
+ */
+#define LOG_FORMAT_TABLE(LOG_FORMAT) \
+    LOG_FORMAT(LF_TEXT,                 0,  LOG_LEVEL_INFO,     "{}") \
+    LOG_FORMAT(LF_OPEN_FILE_FAIL,       1,  LOG_LEVEL_ERROR,    "[ERROR] can not open {}\n") \
+    LOG_FORMAT(LF_ROOT_NOT_EXIST,       2,  LOG_LEVEL_ERROR,    "[ERROR] {} not exist 'root' node\n") \
+    LOG_FORMAT(LF_APP_NONE,             3,  LOG_LEVEL_ERROR,    "[ERROR] not exist application to listen\n") \
+    LOG_FORMAT(LF_APP_LIST_BEGIN,       4,  LOG_LEVEL_INFO,     "==================== applications ====================\n") \
+    LOG_FORMAT(LF_APP_CONFIG,           5,  LOG_LEVEL_INFO,     "---------- [{}]\npath: {}\nrate: {}\nslack: {}\nalone: {}\n") \
+    LOG_FORMAT(LF_APP_LIST_END,         6,  LOG_LEVEL_INFO,     "======================================================\n") \
+    LOG_FORMAT(LF_APP_NONE_VALID,       7,  LOG_LEVEL_ERROR,    "[ERROR] not exist valid application to listen\n") \
+    LOG_FORMAT(LF_APP_START,            8,  LOG_LEVEL_INFO,     "Start application \"{}\", pid = [{}]\n") \
+    LOG_FORMAT(LF_APP_START_FAIL,       9,  LOG_LEVEL_ERROR,    "[ERROR] start application \"{}\" fail: {} \n") \
+    LOG_FORMAT(LF_APP_STARTED,          10, LOG_LEVEL_INFO,     "Application \"{}\" has been started, pid = [{}]\n") \
+    LOG_FORMAT(LF_APP_FILE_NOT_EXIST,   11, LOG_LEVEL_ERROR,    "[ERROR] not exist application file \"{}\"\n") \
+    LOG_FORMAT(LF_APP_REASSOCIATE,      12, LOG_LEVEL_INFO,     "Application \"{}\" reassociate, old pid = [{}], new pid = [{}]\n") \
+    LOG_FORMAT(LF_APP_ENDED,            13, LOG_LEVEL_WARNING,  "[WARNING] application \"{}\", pid = [{}] has been ended\n") \
+    LOG_FORMAT(LF_APP_RESTART,          14, LOG_LEVEL_INFO,     "Restart application \"{}\", pid = [{}]\n") \
+    LOG_FORMAT(LF_APP_RESTART_FAIL,     15, LOG_LEVEL_ERROR,    "[ERROR] restart application \"{}\" fail: {} \n") \
+    LOG_FORMAT(LF_EXCEPTION,            16, LOG_LEVEL_ERROR,    "[EXCEPTION] Application execption: {}!!!\n") \
+    LOG_FORMAT(LF_EXCEPTION_UNKNOWN,    17, LOG_LEVEL_ERROR,    "[EXCEPTION] Application execption!!!\n") \
+    LOG_FORMAT(LF_APP_CHECK,            18, LOG_LEVEL_DEBUG,    "Application \"{}\" is running, pid = [{}]\n") \
+    LOG_FORMAT(LF_LOG_SYNC,             19, LOG_LEVEL_INFO,     "Log \"{}\" synced {} times for {} writes, mean = [{} us], max = [{} us]\n") \
+    LOG_FORMAT(LF_LOG_REPEATED,         20, LOG_LEVEL_INFO,     "Repeated {} times in {} s: {}") \
+    LOG_FORMAT(LF_LOG_SINK_DROP,        21, LOG_LEVEL_WARNING,  "[WARNING] log sink \"{}\" dropped {} records, {} failed\n") \
+    LOG_FORMAT(LF_CONFIG_LOAD,          22, LOG_LEVEL_INFO,     "Load config \"{}\" from {}, {} applications in {} us\n")
+
+enum LogFormatId {
+#define LOG_FORMAT_ENUM(name, id, level, format) name = id,
+    LOG_FORMAT_TABLE(LOG_FORMAT_ENUM)
+#undef LOG_FORMAT_ENUM
+};
+
+/*
+ * Brief:	get format text of an id
+ * Param:	id - format id
+ * Return:	const char*, NULL if id is unknown, e.g. a log written by a newer version
+ */
+static inline const char* getLogFormat(unsigned int id) {
+    switch (id) {
+#define LOG_FORMAT_CASE(name, id, level, format) case id: return format;
+    LOG_FORMAT_TABLE(LOG_FORMAT_CASE)
+#undef LOG_FORMAT_CASE
+    }
+    return NULL;
+}
+
+/*
+ * Brief:	get level of an id, a constant expression for a constant id
+ * Param:	id - format id
+ * Return:	unsigned int, LOG_LEVEL_XXX, LOG_LEVEL_NONE if id is unknown
+ */
+static inline constexpr unsigned int getLogLevel(unsigned int id) {
+    switch (id) {
+#define LOG_LEVEL_CASE(name, id, level, format) case id: return level;
+    LOG_FORMAT_TABLE(LOG_LEVEL_CASE)
+#undef LOG_LEVEL_CASE
+    }
+    return LOG_LEVEL_NONE;
+}
+
+#endif // _LOG_FORMATS_H_
@@ -0,0 +1,28 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	process awaitables for TimerTask coroutines
+**********************************************************************/
+#ifndef _PROCESS_COROUTINE_H_
+#define _PROCESS_COROUTINE_H_
+
+#include "process.h"
+#include "../timer/TimerCoroutine.h"
+
+/* opt-in like TimerCoroutine.h, declares nothing without C++20 coroutines */
+#ifdef TIMER_COROUTINE_ENABLED
+/*
+ * Brief:	suspend the coroutine until process exits
+ * Param:	processId - process id
+ *          interval - check interval in milliseconds
+ *          timeout - milliseconds, 0 means wait forever
+ * Return:	TimerProbeAwaiter, co_await it, result is false on timeout
+ */
+inline TimerProbeAwaiter process_exit(unsigned long processId, unsigned long interval = 1000, unsigned long timeout = 0) {
+    return probe([processId]()->bool {
+        return !Process::isExist(processId);
+    }, interval, timeout);
+}
+#endif
+
+#endif // _PROCESS_COROUTINE_H_
@@ -8,6 +8,9 @@
 #include <Windows.h>
 #include <TlHelp32.h>
 #pragma warning(disable: 4996)
+#else
+#include <errno.h>
+#include <signal.h>
 #endif
 //--------------------------------------------------------------------------
 static char* wchar2char(const wchar_t* wstr) {
@@ -179,6 +182,23 @@ int Process::kill(unsigned long processId) {
     return 0;
 }
 //--------------------------------------------------------------------------
+bool Process::isExist(unsigned long processId) {
+    if (0 == processId) {
+        return false;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    HANDLE process = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+    if (!process) {
+        return ERROR_ACCESS_DENIED == GetLastError();   /* exists but belongs to a protected process */
+    }
+    bool exist = WAIT_TIMEOUT == WaitForSingleObject(process, 0);
+    CloseHandle(process);
+    return exist;
+#else
+    return 0 == ::kill((pid_t)processId, 0) || EPERM == errno;
+#endif
+}
+//--------------------------------------------------------------------------
 void Process::killApp(const char* appName) {
     if (!appName || 0 == strlen(appName)) {
         return;
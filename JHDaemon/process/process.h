@@ -46,6 +46,13 @@ public:
      */
     static int kill(unsigned long processId);
 
+    /*
+     * Brief:	check whether process is still alive
+     * Param:	processId - process id
+     * Return:	bool
+     */
+    static bool isExist(unsigned long processId);
+
     /*
      * Brief:	kill application
      * Param:	appName - application name, e.g. "C:/Program Files/Notepad++/notepad++.exe" or "notepad++.exe"
@@ -12,6 +12,8 @@
 #include <tchar.h>
 #include <time.h>
 #include <Windows.h>
+#include <chrono>
 #include <exception>
+#include <mutex>
 
 // TODO: 在此处引用程序需要的其他头文件
@@ -0,0 +1,158 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-09-15
+* Brief:	fixed capacity callable, stored inline without heap allocation
+**********************************************************************/
+#ifndef _INPLACE_FUNCTION_H_
+#define _INPLACE_FUNCTION_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<typename Signature, size_t Capacity = 64>
+class InplaceFunction;
+
+template<typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+private:
+    enum ManageOp {
+        MO_DESTROY,
+        MO_COPY,
+        MO_MOVE
+    };
+    typedef R (*InvokeFunc)(void* storage, Args... args);
+    typedef void (*ManageFunc)(ManageOp op, void* dst, void* src);
+
+    template<typename F>
+    struct Callable {
+        template<typename T>
+        static auto check(int) -> decltype(std::declval<T&>()(std::declval<Args>()...), std::true_type());
+        template<typename T>
+        static std::false_type check(...);
+        static const bool value = decltype(check<F>(0))::value && !std::is_same<F, InplaceFunction>::value;
+    };
+
+    template<typename F>
+    static bool isNull(const F&) {
+        return false;
+    }
+
+    template<typename R2, typename... Args2>
+    static bool isNull(R2 (*func)(Args2...)) {
+        return !func;
+    }
+
+    template<typename F>
+    static R invoke(void* storage, Args... args) {
+        return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+    }
+
+    template<typename F>
+    static void manage(ManageOp op, void* dst, void* src) {
+        switch (op) {
+        case MO_DESTROY:
+            static_cast<F*>(dst)->~F();
+            break;
+        case MO_COPY:
+            new (dst) F(*static_cast<const F*>(src));
+            break;
+        case MO_MOVE:
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            break;
+        }
+    }
+
+public:
+    InplaceFunction(void) : mInvoke(NULL), mManage(NULL) {}
+
+    InplaceFunction(std::nullptr_t) : mInvoke(NULL), mManage(NULL) {}
+
+    template<typename F, typename = typename std::enable_if<Callable<typename std::decay<F>::type>::value>::type>
+    InplaceFunction(F&& func) : mInvoke(NULL), mManage(NULL) {
+        typedef typename std::decay<F>::type Functor;
+        static_assert(sizeof(Functor) <= Capacity, "callable is too large for InplaceFunction, increase the capacity");
+        static_assert(alignof(Functor) <= alignof(Storage), "callable alignment is not supported by InplaceFunction");
+        if (isNull(func)) {
+            return;
+        }
+        new (&mStorage) Functor(std::forward<F>(func));
+        mInvoke = &invoke<Functor>;
+        mManage = &manage<Functor>;
+    }
+
+    InplaceFunction(const InplaceFunction& other) : mInvoke(other.mInvoke), mManage(other.mManage) {
+        if (mManage) {
+            mManage(MO_COPY, &mStorage, const_cast<Storage*>(&other.mStorage));
+        }
+    }
+
+    InplaceFunction(InplaceFunction&& other) : mInvoke(other.mInvoke), mManage(other.mManage) {
+        if (mManage) {
+            mManage(MO_MOVE, &mStorage, &other.mStorage);
+        }
+    }
+
+    ~InplaceFunction(void) {
+        reset();
+    }
+
+    InplaceFunction& operator=(const InplaceFunction& other) {
+        if (this != &other) {
+            reset();
+            if (other.mManage) {
+                other.mManage(MO_COPY, &mStorage, const_cast<Storage*>(&other.mStorage));
+                mInvoke = other.mInvoke;
+                mManage = other.mManage;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) {
+        if (this != &other) {
+            reset();
+            if (other.mManage) {
+                other.mManage(MO_MOVE, &mStorage, &other.mStorage);
+                mInvoke = other.mInvoke;
+                mManage = other.mManage;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    /*
+     * Brief:	destroy the stored callable
+     * Param:	void
+     * Return:	void
+     */
+    void reset(void) {
+        if (mManage) {
+            mManage(MO_DESTROY, &mStorage, NULL);
+        }
+        mInvoke = NULL;
+        mManage = NULL;
+    }
+
+    explicit operator bool(void) const {
+        return NULL != mInvoke;
+    }
+
+    R operator()(Args... args) const {
+        return mInvoke(const_cast<Storage*>(&mStorage), std::forward<Args>(args)...);
+    }
+
+private:
+    typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+    Storage mStorage;           /* callable object */
+    InvokeFunc mInvoke;         /* call the callable, NULL if empty */
+    ManageFunc mManage;         /* destroy/copy/move the callable */
+};
+
+#endif // _INPLACE_FUNCTION_H_
@@ -0,0 +1,271 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-09-15
+* Brief:	C++20 coroutine awaitables driven by TimerManager
+**********************************************************************/
+#ifndef _TIMER_COROUTINE_H_
+#define _TIMER_COROUTINE_H_
+
+/*
+ * opt-in: the default build is C++14, where this header declares nothing and JHDaemon keeps its
+ * callback supervisors, a build with C++20 coroutines (/std:c++latest or -std=c++20) can include
+ * it to write supervisors as coroutines, see the example at the end of this file
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define TIMER_COROUTINE_ENABLED 1
+
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <new>
+#include "TimerManager.h"
+
+/* 探测条件, 返回值:true-条件满足 */
+#define TIMER_PROBE_PREDICATE InplaceFunction<bool(void), TIMER_CALLBACK_CAPACITY>
+
+/* pool of coroutine frames, freed frames are kept by size class and reused, never returned to the heap */
+class TimerCoroutineFramePool {
+public:
+    enum {
+        GRANULARITY = 64,           /* size class step in bytes */
+        CLASS_COUNT = 16            /* frames larger than GRANULARITY * CLASS_COUNT use the heap directly */
+    };
+
+    /*
+     * Brief:	allocate a coroutine frame
+     * Param:	size - frame size
+     * Return:	void*
+     */
+    static void* allocate(size_t size) {
+        size_t sizeClass = (size + GRANULARITY - 1) / GRANULARITY;
+        if (0 == sizeClass || sizeClass > CLASS_COUNT) {
+            return ::operator new(size);
+        }
+        FreeLists& lists = freeLists();
+        {
+            std::lock_guard<std::mutex> lock(lists.mutex);
+            FreeBlock* block = lists.heads[sizeClass - 1];
+            if (block) {
+                lists.heads[sizeClass - 1] = block->next;
+                return block;
+            }
+        }
+        return ::operator new(sizeClass * GRANULARITY);
+    }
+
+    /*
+     * Brief:	give a coroutine frame back to the pool
+     * Param:	ptr - frame
+     *          size - frame size, same as allocate
+     * Return:	void
+     */
+    static void deallocate(void* ptr, size_t size) {
+        size_t sizeClass = (size + GRANULARITY - 1) / GRANULARITY;
+        if (0 == sizeClass || sizeClass > CLASS_COUNT) {
+            ::operator delete(ptr);
+            return;
+        }
+        FreeLists& lists = freeLists();
+        std::lock_guard<std::mutex> lock(lists.mutex);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = lists.heads[sizeClass - 1];
+        lists.heads[sizeClass - 1] = block;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    /* frames are resumed in update or in timer workers, so the lists are locked */
+    struct FreeLists {
+        std::mutex mutex;
+        FreeBlock* heads[CLASS_COUNT] = {};
+    };
+
+    static FreeLists& freeLists(void) {
+        static FreeLists lists;
+        return lists;
+    }
+};
+
+/*
+ * fire-and-forget coroutine, starts running when called and destroys its frame when it returns,
+ * the body runs in the thread that resumed it: the caller until the first suspension, then the
+ * thread calling TimerManager::update (or a timer worker if TimerManager::setWorkerCount > 0)
+ */
+class TimerTask {
+public:
+    class promise_type {
+    public:
+        TimerTask get_return_object(void) {
+            return TimerTask();
+        }
+
+        std::suspend_never initial_suspend(void) noexcept {
+            return std::suspend_never();
+        }
+
+        std::suspend_never final_suspend(void) noexcept {
+            return std::suspend_never();
+        }
+
+        void return_void(void) {}
+
+        void unhandled_exception(void) {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size) {
+            return TimerCoroutineFramePool::allocate(size);
+        }
+
+        static void operator delete(void* ptr, size_t size) {
+            TimerCoroutineFramePool::deallocate(ptr, size);
+        }
+    };
+};
+
+/* awaiter of sleep_for, resumes the coroutine from a one shot timer */
+class TimerSleepAwaiter {
+public:
+    explicit TimerSleepAwaiter(unsigned long interval) : mInterval(interval) {}
+
+    bool await_ready(void) const {
+        return 0 == mInterval;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        TimerHandle timer = TimerManager::getInstance()->runOnce(mInterval, [handle](timer_st* tm, void* param)->void {
+            handle.resume();
+        });
+        return 0 != timer;  /* no timer available, continue at once rather than hang */
+    }
+
+    void await_resume(void) const {}
+
+private:
+    unsigned long mInterval;        /* milliseconds */
+};
+
+/* awaiter of probe, checks the predicate every interval until it holds or timeout is reached */
+class TimerProbeAwaiter {
+public:
+    TimerProbeAwaiter(TIMER_PROBE_PREDICATE predicate, unsigned long interval, unsigned long timeout)
+        : mPredicate(std::move(predicate)), mInterval(interval > 0 ? interval : 1), mTimeout(timeout), mDeadline(0), mResult(false) {}
+
+    bool await_ready(void) {
+        mResult = mPredicate && mPredicate();
+        return mResult || !mPredicate;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        mHandle = handle;
+        if (mTimeout > 0) {
+            mDeadline = (unsigned long long)(TimerManager::getTime() * 1000) + mTimeout;
+        }
+        return schedule();
+    }
+
+    /*
+     * Brief:	result of co_await
+     * Param:	void
+     * Return:	bool, true.predicate holds, false.timeout
+     */
+    bool await_resume(void) const {
+        return mResult;
+    }
+
+private:
+    /* one shot timer per check, a timer never fires again after the awaiter is gone */
+    bool schedule(void) {
+        return 0 != TimerManager::getInstance()->runOnce(mInterval, [this](timer_st* tm, void* param)->void {
+            check();
+        });
+    }
+
+    void check(void) {
+        if (mPredicate()) {
+            mResult = true;
+            mHandle.resume();
+            return;
+        }
+        if (mTimeout > 0 && (unsigned long long)(TimerManager::getTime() * 1000) >= mDeadline) {
+            mHandle.resume();
+            return;
+        }
+        if (!schedule()) {
+            mHandle.resume();
+        }
+    }
+
+private:
+    TIMER_PROBE_PREDICATE mPredicate;
+    unsigned long mInterval;            /* check interval in milliseconds */
+    unsigned long mTimeout;             /* milliseconds, 0 means wait forever */
+    unsigned long long mDeadline;       /* timeout time in milliseconds */
+    bool mResult;
+    std::coroutine_handle<> mHandle;
+};
+
+/*
+ * Brief:	suspend the coroutine for a while, a coroutine suspended on a timer removed by
+ *          TimerManager::clear is never resumed
+ * Param:	interval - milliseconds
+ * Return:	TimerSleepAwaiter, co_await it
+ */
+inline TimerSleepAwaiter sleep_for(unsigned long interval) {
+    return TimerSleepAwaiter(interval);
+}
+
+/*
+ * Brief:	suspend the coroutine until predicate returns true, predicate is checked at once
+ *          and then every interval
+ * Param:	predicate - condition
+ *          interval - check interval in milliseconds
+ *          timeout - milliseconds, 0 means wait forever
+ * Return:	TimerProbeAwaiter, co_await it, result is false on timeout
+ */
+inline TimerProbeAwaiter probe(TIMER_PROBE_PREDICATE predicate, unsigned long interval, unsigned long timeout = 0) {
+    return TimerProbeAwaiter(std::move(predicate), interval, timeout);
+}
+
+#endif
+
+#endif // _TIMER_COROUTINE_H_
+
+/*
+ * example, JHDaemon.cpp built with C++20 coroutines, one coroutine per app instead of timer callbacks:
+
+#include "process/ProcessCoroutine.h"
+
+TimerTask superviseApp(AppInfo* ai) {
+    while (1) {
+        unsigned long pid = getAppProcessId(ai->path);
+        if (0 == pid) {
+            int ret = Process::runApp(ai->path.c_str(), NULL, ai->alone, &pid);
+            if (0 != ret) {
+                log<LF_APP_START_FAIL>(ai->channel, true, ai->path, ret);
+                co_await sleep_for(ai->rate * 1000);
+                continue;
+            }
+            log<LF_APP_START>(ai->channel, true, ai->path, pid);
+        }
+        co_await process_exit(pid, ai->rate * 1000);
+        log<LF_APP_ENDED>(ai->channel, true, ai->path, pid);
+    }
+}
+
+int main() {
+    ...
+    for (size_t i = 0, len = s_appInfoList.size(); i < len; ++i) {
+        superviseApp(s_appInfoList[i]);
+    }
+    while (1) {
+        unsigned long timeout = TimerManager::getInstance()->getNextTimeout();
+        Sleep(timeout < 1000 ? timeout : 1000);
+        TimerManager::getInstance()->update();
+    }
+    return 0;
+}
+*/
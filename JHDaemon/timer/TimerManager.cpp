@@ -8,58 +8,535 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <map>
-#include <list>
-#include <thread>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
 #include <windows.h>
+#else
+#include <sys/time.h>
 #endif
 
-class TimerWrapper {
+#define TIMER_SLAB_CHUNK_BITS       8                                   /* 256 slots per chunk */
+#define TIMER_SLAB_CHUNK_SIZE       (1 << TIMER_SLAB_CHUNK_BITS)
+#define TIMER_HANDLE_INDEX_BITS     20                                  /* max 1M timers */
+#define TIMER_HANDLE_INDEX_MASK     ((1u << TIMER_HANDLE_INDEX_BITS) - 1)
+#define TIMER_HANDLE_GENERATION_MAX ((1u << (32 - TIMER_HANDLE_INDEX_BITS)) - 1)
+#define TIMER_SLAB_MAX_CHUNKS       (1 << (TIMER_HANDLE_INDEX_BITS - TIMER_SLAB_CHUNK_BITS))
+#define TIMER_COMMAND_CHUNK_SIZE    256
+
+/* state of a timer slot, only changed in update thread */
+enum TimerSlotState {
+    TSS_FREE,       /* in free list or owned by a producer which is filling it */
+    TSS_ACTIVE,     /* running in manager */
+    TSS_RETIRING    /* removed from manager, a worker is still delivering its callbacks */
+};
+
+/* timer slot, allocated from slab and reused, never freed */
+class TimerSlot {
 public:
-    ~TimerWrapper(void) {
-        if (tm) {
-            free(tm);
-        }
+    TimerSlot(void) : slack(0), index(0), generation(1), state(TSS_FREE), activePos(0), hasId(false),
+                      pendingRunCount(0), pendingOver(false), pendingBurst(false), scheduled(false), removed(false), poolNext(NULL), freeNext(NULL) {
+        memset(&tm, 0, sizeof(tm));
+        memset(&poolTm, 0, sizeof(poolTm));
     }
 public:
-    timer_st* tm;
+    timer_st tm;
     TIMER_TRIGGER_CALLBACK triggerCallback;
     TIMER_OVER_CALLBACK overCallback;
+    std::string id;                     /* optional secondary id */
+    unsigned long slack;                /* trigger may be delayed up to slack milliseconds to share a wakeup */
+    unsigned int index;                 /* slot index in slab */
+    unsigned int generation;            /* bumped when slot is freed, never 0 */
+    TimerSlotState state;
+    size_t activePos;                   /* position in sActiveSlots */
+    bool hasId;
+    /* worker pool state, guarded by sPoolMutex */
+    timer_st poolTm;                    /* copy of tm taken at the last dispatch, tm keeps changing in update */
+    unsigned long pendingRunCount;      /* trigger count not yet delivered */
+    bool pendingOver;                   /* over callback not yet delivered */
+    bool pendingBurst;                  /* deliver pending trigger count one call per period */
+    bool scheduled;                     /* in pool queue or executing, at most one worker at a time */
+    bool removed;                       /* removed from manager while scheduled */
+    TimerSlot* poolNext;                /* intrusive link of pool queue */
+    TimerSlot* freeNext;                /* intrusive link of free list and retired list */
 };
 
-static std::map<std::string, TimerWrapper*> sTimerWrapperMap;
-static std::list<std::string> sAddIdList;
-static std::list<TimerWrapper*> sAddTimerWrapperList;
-static std::mutex sAddListMutex;
-static std::list<std::string> sStopIdList;
-static std::mutex sStopIdListMutex;
-static bool sClearFlag = false;
-static std::mutex sClearFlagMutex;
-static TimerManager* mInstance = NULL;
+/* command type of the command queue */
+enum TimerCommandType {
+    TCT_ADD,        /* add a timer slot */
+    TCT_STOP,       /* stop a timer by handle or id */
+    TCT_SLACK,      /* set slack of a timer by handle or id */
+    TCT_CATCHUP,    /* set catch-up policy of a timer by handle or id */
+    TCT_CLEAR       /* clear all timer */
+};
 
-static void timerCallbackRun(timer_st* tm, unsigned long runCount, void* param) {
-    std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.begin();
-    for (; sTimerWrapperMap.end() != iter; ++iter) {
-        if (get_timer_id(tm) == get_timer_id(iter->second->tm)) {
-            if (iter->second->triggerCallback) {
-                iter->second->triggerCallback(tm, runCount, param);
+/* command node, pooled and intrusive linked into the command queue */
+class TimerCommand {
+public:
+    TimerCommand(void) : type(TCT_CLEAR), slot(NULL), handle(0), value(0), next(NULL), freeNext(NULL) {}
+public:
+    TimerCommandType type;
+    TimerSlot* slot;
+    TimerHandle handle;
+    unsigned long value;
+    std::string id;                     /* used instead of handle when not empty */
+    TimerCommand* next;                 /* intrusive link of command queue */
+    TimerCommand* freeNext;             /* intrusive link of free list */
+};
+
+/* lock-free stack of nodes linked by freeNext, nodes are only taken all at once so pop has no ABA */
+template<typename T>
+class TimerFreeList {
+public:
+    TimerFreeList(void) : mHead(NULL) {}
+
+    void push(T* node) {
+        T* head = mHead.load(std::memory_order_relaxed);
+        do {
+            node->freeNext = head;
+        } while (!mHead.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    T* takeAll(void) {
+        return mHead.exchange(NULL, std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<T*> mHead;
+};
+
+/*
+ * per thread cache of free nodes, given back to the shared list when the thread exits, every cache is
+ * registered so a thread can take the nodes of other threads when nothing else is left, the own mutex
+ * of a cache is only contended then
+ */
+template<typename T>
+class TimerLocalCache {
+public:
+    TimerLocalCache(TimerFreeList<T>& shared) : mShared(shared), mHead(NULL), mPrev(NULL), mNext(NULL) {
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        mNext = sRegistryHead;
+        if (mNext) {
+            mNext->mPrev = this;
+        }
+        sRegistryHead = this;
+    }
+
+    ~TimerLocalCache(void) {
+        {
+            std::lock_guard<std::mutex> lock(sRegistryMutex);
+            if (mPrev) {
+                mPrev->mNext = mNext;
+            } else {
+                sRegistryHead = mNext;
             }
-            break;
+            if (mNext) {
+                mNext->mPrev = mPrev;
+            }
+        }
+        T* node = takeAll();
+        while (node) {
+            T* next = node->freeNext;
+            mShared.push(node);
+            node = next;
+        }
+    }
+
+    /* take one node, NULL when the cache is empty */
+    T* pop(void) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        T* node = mHead;
+        if (node) {
+            mHead = node->freeNext;
+            node->freeNext = NULL;
         }
+        return node;
+    }
+
+    /* put nodes linked by freeNext into the cache, only called by the owner thread when pop returned NULL */
+    void fill(T* nodes) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mHead = nodes;
     }
+
+    /* take the nodes cached by any other thread, NULL when every cache is empty */
+    static T* steal(void) {
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        for (TimerLocalCache* cache = sRegistryHead; cache; cache = cache->mNext) {
+            T* nodes = cache->takeAll();
+            if (nodes) {
+                return nodes;
+            }
+        }
+        return NULL;
+    }
+
+private:
+    T* takeAll(void) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        T* nodes = mHead;
+        mHead = NULL;
+        return nodes;
+    }
+
+private:
+    TimerFreeList<T>& mShared;
+    std::mutex mMutex;
+    T* mHead;
+    TimerLocalCache* mPrev;             /* links of the registry, guarded by sRegistryMutex */
+    TimerLocalCache* mNext;
+    static std::mutex sRegistryMutex;
+    static TimerLocalCache* sRegistryHead;
+};
+
+template<typename T>
+std::mutex TimerLocalCache<T>::sRegistryMutex;
+
+template<typename T>
+TimerLocalCache<T>* TimerLocalCache<T>::sRegistryHead = NULL;
+
+static std::atomic<TimerSlot*> sSlabChunks[TIMER_SLAB_MAX_CHUNKS];
+static std::atomic<unsigned int> sSlabChunkCount(0);
+static std::mutex sSlabMutex;                               /* only taken to grow slab or command pool */
+static TimerFreeList<TimerSlot> sFreeSlots;
+static TimerFreeList<TimerSlot> sRetiredSlots;              /* released by workers, freed in update */
+static TimerFreeList<TimerCommand> sFreeCommands;
+static thread_local TimerLocalCache<TimerSlot> tSlotCache(sFreeSlots);
+static thread_local TimerLocalCache<TimerCommand> tCommandCache(sFreeCommands);
+static std::vector<TimerSlot*> sActiveSlots;
+static std::map<std::string, TimerSlot*> sIdIndex;           /* secondary index of timers created with id */
+static std::atomic<TimerCommand*> sCommandQueue(NULL);      /* lock-free mpsc stack, newest command at head */
+static TimerSlot* sUpdatingSlot = NULL;                     /* slot whose timer is being updated */
+static std::atomic<unsigned long> sDefaultSlack(0);         /* slack of new timers */
+static unsigned long long sNextWakeup = 0;                  /* earliest deadline + slack, 0 means scan on next update */
+static TimerCoalesceStats sCoalesceStats;
+static TimerManager* mInstance = NULL;
+/* worker pool */
+static std::vector<std::thread> sPoolThreads;
+static std::mutex sPoolMutex;
+static std::condition_variable sPoolCondition;
+static TimerSlot* sPoolQueueHead = NULL;
+static TimerSlot* sPoolQueueTail = NULL;
+static bool sPoolExit = false;
+static TimerPoolStats sPoolStats;
+
+static TimerHandle makeHandle(TimerSlot* slot) {
+    return (slot->generation << TIMER_HANDLE_INDEX_BITS) | slot->index;
 }
 
-static void timerCallbackOver(timer_st* tm, void* param) {
-    std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.begin();
-    for (; sTimerWrapperMap.end() != iter; ++iter) {
-        if (get_timer_id(tm) == get_timer_id(iter->second->tm)) {
-            if (iter->second->overCallback) {
-                iter->second->overCallback(tm, param);
+/* allocate a chunk of slots, return them linked by freeNext */
+static TimerSlot* growSlab(void) {
+    std::lock_guard<std::mutex> lock(sSlabMutex);
+    unsigned int chunkCount = sSlabChunkCount.load(std::memory_order_relaxed);
+    if (chunkCount >= TIMER_SLAB_MAX_CHUNKS) {
+        return NULL;
+    }
+    TimerSlot* chunk = new TimerSlot[TIMER_SLAB_CHUNK_SIZE];
+    for (unsigned int i = 0; i < TIMER_SLAB_CHUNK_SIZE; ++i) {
+        chunk[i].index = (chunkCount << TIMER_SLAB_CHUNK_BITS) | i;
+        chunk[i].freeNext = (i + 1 < TIMER_SLAB_CHUNK_SIZE) ? &chunk[i + 1] : NULL;
+    }
+    sSlabChunks[chunkCount].store(chunk, std::memory_order_release);
+    sSlabChunkCount.store(chunkCount + 1, std::memory_order_release);
+    return chunk;
+}
+
+/* take a free slot, can be called from any thread */
+static TimerSlot* allocSlot(void) {
+    TimerSlot* slot = tSlotCache.pop();
+    if (slot) {
+        return slot;
+    }
+    slot = sFreeSlots.takeAll();
+    if (!slot) {
+        slot = growSlab();
+    }
+    if (!slot) {
+        /* slab is full, free slots can still be cached by other threads */
+        slot = TimerLocalCache<TimerSlot>::steal();
+    }
+    if (!slot) {
+        slot = sFreeSlots.takeAll();
+        if (!slot) {
+            return NULL;
+        }
+    }
+    tSlotCache.fill(slot->freeNext);
+    slot->freeNext = NULL;
+    return slot;
+}
+
+/* find active slot of handle, NULL if handle is stale, only called from update thread */
+static TimerSlot* resolveSlot(TimerHandle handle) {
+    unsigned int index = handle & TIMER_HANDLE_INDEX_MASK;
+    unsigned int chunkIndex = index >> TIMER_SLAB_CHUNK_BITS;
+    if (0 == handle || chunkIndex >= sSlabChunkCount.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+    TimerSlot* slot = &sSlabChunks[chunkIndex].load(std::memory_order_acquire)[index & (TIMER_SLAB_CHUNK_SIZE - 1)];
+    if (TSS_ACTIVE != slot->state || slot->generation != (handle >> TIMER_HANDLE_INDEX_BITS)) {
+        return NULL;
+    }
+    return slot;
+}
+
+/* take a command node, can be called from any thread */
+static TimerCommand* allocCommand(TimerCommandType type) {
+    TimerCommand* cmd = tCommandCache.pop();
+    if (!cmd) {
+        cmd = sFreeCommands.takeAll();
+        if (!cmd) {
+            std::lock_guard<std::mutex> lock(sSlabMutex);
+            cmd = new TimerCommand[TIMER_COMMAND_CHUNK_SIZE];
+            for (unsigned int i = 0; i + 1 < TIMER_COMMAND_CHUNK_SIZE; ++i) {
+                cmd[i].freeNext = &cmd[i + 1];
             }
+        }
+        tCommandCache.fill(cmd->freeNext);
+    }
+    cmd->type = type;
+    cmd->slot = NULL;
+    cmd->handle = 0;
+    cmd->value = 0;
+    cmd->next = NULL;
+    cmd->freeNext = NULL;
+    return cmd;
+}
+
+/* push command to queue, can be called from any thread */
+static void pushCommand(TimerCommand* cmd) {
+    TimerCommand* head = sCommandQueue.load(std::memory_order_relaxed);
+    do {
+        cmd->next = head;
+    } while (!sCommandQueue.compare_exchange_weak(head, cmd, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/* take all queued commands at once, return them in push order, only called from update thread */
+static TimerCommand* popAllCommands(void) {
+    TimerCommand* head = sCommandQueue.exchange(NULL, std::memory_order_acquire);
+    TimerCommand* ordered = NULL;
+    while (head) {
+        TimerCommand* next = head->next;
+        head->next = ordered;
+        ordered = head;
+        head = next;
+    }
+    return ordered;
+}
+
+/* give slot back to free list with a new generation, only called from update thread */
+static void freeSlot(TimerSlot* slot) {
+    slot->triggerCallback = NULL;
+    slot->overCallback = NULL;
+    slot->id.clear();
+    slot->hasId = false;
+    slot->pendingRunCount = 0;
+    slot->pendingOver = false;
+    slot->scheduled = false;
+    slot->removed = false;
+    slot->state = TSS_FREE;
+    slot->generation = (slot->generation >= TIMER_HANDLE_GENERATION_MAX) ? 1 : slot->generation + 1;
+    sFreeSlots.push(slot);
+}
+
+/* push slot to pool queue tail, need lock sPoolMutex */
+static void enqueuePoolSlot(TimerSlot* slot) {
+    slot->poolNext = NULL;
+    if (sPoolQueueTail) {
+        sPoolQueueTail->poolNext = slot;
+    } else {
+        sPoolQueueHead = slot;
+    }
+    sPoolQueueTail = slot;
+    if (++sPoolStats.queueDepth > sPoolStats.maxQueueDepth) {
+        sPoolStats.maxQueueDepth = sPoolStats.queueDepth;
+    }
+}
+
+/* hand fired callbacks to the pool, fires of a slot already scheduled are merged into its pending count */
+static void dispatchPoolSlot(TimerSlot* slot, unsigned long runCount, bool over) {
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    slot->pendingRunCount += runCount;
+    slot->pendingOver = slot->pendingOver || over;
+    slot->pendingBurst = TIMER_CATCHUP_BURST == get_timer_catchup(&slot->tm);
+    slot->poolTm = slot->tm;
+    if (!slot->scheduled) {
+        slot->scheduled = true;
+        enqueuePoolSlot(slot);
+        sPoolCondition.notify_one();
+    }
+}
+
+static void poolWorkerLoop(void) {
+    std::unique_lock<std::mutex> lock(sPoolMutex);
+    while (1) {
+        sPoolCondition.wait(lock, []()->bool {
+            return sPoolExit || sPoolQueueHead;
+        });
+        if (sPoolExit) {
             break;
         }
+        TimerSlot* slot = sPoolQueueHead;
+        sPoolQueueHead = slot->poolNext;
+        if (!sPoolQueueHead) {
+            sPoolQueueTail = NULL;
+        }
+        --sPoolStats.queueDepth;
+        unsigned long runCount = slot->pendingRunCount;
+        bool over = slot->pendingOver;
+        bool burst = slot->pendingBurst;
+        timer_st tm = slot->poolTm;
+        slot->pendingRunCount = 0;
+        slot->pendingOver = false;
+        lock.unlock();
+        std::chrono::steady_clock::time_point beginTime = std::chrono::steady_clock::now();
+        if (runCount > 0 && slot->triggerCallback) {
+            if (burst) {
+                /* periods merged while queued are still delivered one by one */
+                for (unsigned long i = 0; i < runCount; ++i) {
+                    slot->triggerCallback(&tm, 1, get_timer_param(&tm));
+                }
+            } else {
+                slot->triggerCallback(&tm, runCount, get_timer_param(&tm));
+            }
+        }
+        if (over && slot->overCallback) {
+            slot->overCallback(&tm, get_timer_param(&tm));
+        }
+        unsigned long long duration = (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - beginTime).count();
+        lock.lock();
+        ++sPoolStats.executeCount;
+        sPoolStats.totalDuration += duration;
+        if (duration > sPoolStats.maxDuration) {
+            sPoolStats.maxDuration = duration;
+        }
+        if (slot->pendingRunCount > 0 || slot->pendingOver) {
+            enqueuePoolSlot(slot);
+        } else {
+            slot->scheduled = false;
+            if (slot->removed) {
+                sRetiredSlots.push(slot);
+            }
+        }
+    }
+}
+
+static void stopPool(void) {
+    {
+        std::lock_guard<std::mutex> lock(sPoolMutex);
+        sPoolExit = true;
+    }
+    sPoolCondition.notify_all();
+    for (size_t i = 0, len = sPoolThreads.size(); i < len; ++i) {
+        sPoolThreads[i].join();
+    }
+    sPoolThreads.clear();
+    /* drop callbacks not delivered yet */
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    while (sPoolQueueHead) {
+        TimerSlot* slot = sPoolQueueHead;
+        sPoolQueueHead = slot->poolNext;
+        slot->pendingRunCount = 0;
+        slot->pendingOver = false;
+        slot->scheduled = false;
+        if (slot->removed) {
+            freeSlot(slot);
+        }
+    }
+    sPoolQueueTail = NULL;
+    sPoolStats.queueDepth = 0;
+    sPoolExit = false;
+}
+
+/* remove slot from manager, the slot is freed now or after a worker delivered its callbacks */
+static void releaseSlot(TimerSlot* slot) {
+    TimerSlot* last = sActiveSlots.back();
+    last->activePos = slot->activePos;
+    sActiveSlots[slot->activePos] = last;
+    sActiveSlots.pop_back();
+    if (slot->hasId) {
+        std::map<std::string, TimerSlot*>::iterator iter = sIdIndex.find(slot->id);
+        if (sIdIndex.end() != iter && slot == iter->second) {
+            sIdIndex.erase(iter);
+        }
+    }
+    if (!sPoolThreads.empty()) {
+        std::lock_guard<std::mutex> lock(sPoolMutex);
+        if (slot->scheduled) {
+            slot->removed = true;
+            slot->state = TSS_RETIRING;
+            return;
+        }
+    }
+    freeSlot(slot);
+}
+
+static TimerSlot* findSlot(TimerCommand* cmd) {
+    if (cmd->id.empty()) {
+        return resolveSlot(cmd->handle);
+    }
+    std::map<std::string, TimerSlot*>::iterator iter = sIdIndex.find(cmd->id);
+    if (sIdIndex.end() == iter) {
+        return NULL;
+    }
+    return iter->second;
+}
+
+static void timerCallbackRun(timer_st* tm, unsigned long runCount, void* param);
+static void timerCallbackOver(timer_st* tm, void* param);
+
+/* fill a free slot and queue it to be added, id can be NULL */
+static TimerHandle addSlot(const char* id, unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK& triggerCallback, TIMER_OVER_CALLBACK& overCallback, void* param) {
+    if (0 == interval) {
+        return 0;
+    }
+    TimerSlot* slot = allocSlot();
+    if (!slot) {
+        return 0;
+    }
+    init_timer(&slot->tm, interval, count, timerCallbackRun, timerCallbackOver, param);
+    TimerHandle handle = makeHandle(slot);
+    slot->tm.id = handle;
+    slot->triggerCallback = std::move(triggerCallback);
+    slot->overCallback = std::move(overCallback);
+    slot->slack = sDefaultSlack.load(std::memory_order_relaxed);
+    if (id) {
+        slot->id = id;
+        slot->hasId = true;
+    }
+    TimerCommand* cmd = allocCommand(TCT_ADD);
+    cmd->slot = slot;
+    pushCommand(cmd);
+    return handle;
+}
+
+static void timerCallbackRun(timer_st* tm, unsigned long runCount, void* param) {
+    TimerSlot* slot = sUpdatingSlot;
+    if (!slot || &slot->tm != tm || !slot->triggerCallback) {
+        return;
+    }
+    if (sPoolThreads.empty()) {
+        slot->triggerCallback(tm, runCount, param);
+    } else {
+        dispatchPoolSlot(slot, runCount, false);
+    }
+}
+
+static void timerCallbackOver(timer_st* tm, void* param) {
+    TimerSlot* slot = sUpdatingSlot;
+    if (!slot || &slot->tm != tm || !slot->overCallback) {
+        return;
+    }
+    if (sPoolThreads.empty()) {
+        slot->overCallback(tm, param);
+    } else {
+        dispatchPoolSlot(slot, 0, true);
     }
 }
 
@@ -88,94 +565,257 @@ TimerManager* TimerManager::getInstance(void) {
 }
 
 void TimerManager::update(void) {
-    /* add list */
-    sAddListMutex.lock();
-    while (sAddIdList.size() > 0) {
-        std::string id = *(sAddIdList.begin());
-        sAddIdList.pop_front();
-        TimerWrapper* wrapper = *(sAddTimerWrapperList.begin());
-        sAddTimerWrapperList.pop_front();
-        std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.find(id);
-        if (sTimerWrapperMap.end() != iter) {
-            sTimerWrapperMap.erase(iter);
-            delete iter->second;
-        }
-        sTimerWrapperMap[id] = wrapper;
-        start_timer(wrapper->tm, (unsigned long long)(getTime() * 1000), 0);
-    }
-    sAddListMutex.unlock();
-    /* stop id list */
-    sStopIdListMutex.lock();
-    while (sStopIdList.size() > 0) {
-        std::string id = *(sStopIdList.begin());
-        sStopIdList.pop_front();
-        std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.find(id);
-        if (sTimerWrapperMap.end() != iter) {
-            sTimerWrapperMap.erase(iter);
-            delete iter->second;
-        }
-    }
-    sStopIdListMutex.unlock();
-    /* clear list */
-    sClearFlagMutex.lock();
-    if (sClearFlag) {
-        std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.begin();
-        for (; sTimerWrapperMap.end() != iter; ++iter) {
-            delete iter->second;
-        }
-        sTimerWrapperMap.clear();
-        sClearFlag = false;
-    }
-    sClearFlagMutex.unlock();
-    /* update list */
-    std::map<std::string, TimerWrapper*>::iterator iter = sTimerWrapperMap.begin();
-    while (sTimerWrapperMap.end() != iter) {
-        int ret = update_timer(iter->second->tm, (unsigned long long)(getTime() * 1000));
+    unsigned long long now = (unsigned long long)(getTime() * 1000);
+    /* slots whose callbacks were still running when they were removed */
+    TimerSlot* retired = sRetiredSlots.takeAll();
+    while (retired) {
+        TimerSlot* next = retired->freeNext;
+        freeSlot(retired);
+        retired = next;
+    }
+    /* command queue, handled in the order they were issued */
+    TimerCommand* cmd = popAllCommands();
+    if (cmd) {
+        sNextWakeup = 0;
+    }
+    while (cmd) {
+        TimerCommand* next = cmd->next;
+        if (TCT_ADD == cmd->type) {
+            TimerSlot* slot = cmd->slot;
+            if (slot->hasId) {
+                std::map<std::string, TimerSlot*>::iterator iter = sIdIndex.find(slot->id);
+                if (sIdIndex.end() != iter) {
+                    releaseSlot(iter->second);
+                }
+                sIdIndex[slot->id] = slot;
+            }
+            slot->state = TSS_ACTIVE;
+            slot->activePos = sActiveSlots.size();
+            sActiveSlots.push_back(slot);
+            start_timer(&slot->tm, now, 0);
+        } else if (TCT_STOP == cmd->type) {
+            TimerSlot* slot = findSlot(cmd);
+            if (slot) {
+                releaseSlot(slot);
+            }
+        } else if (TCT_SLACK == cmd->type) {
+            TimerSlot* slot = findSlot(cmd);
+            if (slot) {
+                slot->slack = cmd->value;
+            }
+        } else if (TCT_CATCHUP == cmd->type) {
+            TimerSlot* slot = findSlot(cmd);
+            if (slot) {
+                set_timer_catchup(&slot->tm, (unsigned int)cmd->value);
+            }
+        } else if (TCT_CLEAR == cmd->type) {
+            while (!sActiveSlots.empty()) {
+                releaseSlot(sActiveSlots.back());
+            }
+        }
+        cmd->id.clear();
+        sFreeCommands.push(cmd);
+        cmd = next;
+    }
+    /* no deadline window closed yet, timers already due wait to share the next wakeup */
+    if (now < sNextWakeup) {
+        ++sCoalesceStats.idleCount;
+        return;
+    }
+    /* update list, fire every due timer in one pass */
+    bool fired = false;
+    bool paused = false;
+    unsigned long long nextWakeup = 0;
+    size_t i = 0;
+    while (i < sActiveSlots.size()) {
+        TimerSlot* slot = sActiveSlots[i];
+        timer_st* tm = &slot->tm;
+        if (is_timer_running(tm) && !is_timer_paused(tm)) {
+            unsigned long long deadline = get_timer_deadline(tm);
+            if (deadline <= now) {
+                unsigned long long error = now - deadline;
+                fired = true;
+                ++sCoalesceStats.fireCount;
+                sCoalesceStats.totalError += error;
+                if (error > sCoalesceStats.maxError) {
+                    sCoalesceStats.maxError = error;
+                }
+            }
+        }
+        sUpdatingSlot = slot;
+        int ret = update_timer(tm, now);
+        if (0 == ret && get_timer_total_count(tm) > 0 && get_timer_current_count(tm) >= get_timer_total_count(tm)) {
+            ret = update_timer(tm, now);   /* count reached, complete now rather than at next wakeup */
+        }
+        sUpdatingSlot = NULL;
         if (1 == ret || 4 == ret) {
-            sTimerWrapperMap.erase(iter);
-            delete iter->second;
-        } else {
-            ++iter;
+            releaseSlot(slot);  /* last slot is moved to position i */
+            continue;
+        }
+        if (is_timer_paused(tm)) {
+            paused = true;
+        } else if (is_timer_running(tm)) {
+            unsigned long long latest = get_timer_deadline(tm) + slot->slack;
+            if (0 == nextWakeup || latest < nextWakeup) {
+                nextWakeup = latest;
+            }
         }
+        ++i;
     }
+    if (fired) {
+        ++sCoalesceStats.wakeupCount;
+    } else {
+        ++sCoalesceStats.idleCount;
+    }
+    /* paused timers are checked on every update */
+    sNextWakeup = paused ? 0 : nextWakeup;
+}
+
+TimerHandle TimerManager::run(unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
+    return addSlot(NULL, interval, count, triggerCallback, overCallback, param);
 }
 
-void TimerManager::run(const char* id, unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
+TimerHandle TimerManager::run(const char* id, unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
 	if (!id || 0 == strlen(id)) {
-		return;
+		return 0;
 	}
-    sAddListMutex.lock();
-    timer_st* tm = create_timer(interval, count, timerCallbackRun, timerCallbackOver, param);
-    if (tm) {
-        TimerWrapper* wrapper = new TimerWrapper();
-        wrapper->tm = tm;
-        wrapper->triggerCallback = triggerCallback;
-        wrapper->overCallback = overCallback;
-        sAddIdList.push_back(id);
-        sAddTimerWrapperList.push_back(wrapper);
-    }
-    sAddListMutex.unlock();
+    return addSlot(id, interval, count, triggerCallback, overCallback, param);
+}
+
+TimerHandle TimerManager::runLoop(unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param /*= NULL*/) {
+	return run(interval, 0, std::move(triggerCallback), NULL, param);
+}
+
+TimerHandle TimerManager::runLoop(const char* id, unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param /*= NULL*/) {
+	return run(id, interval, 0, std::move(triggerCallback), NULL, param);
+}
+
+TimerHandle TimerManager::runOnce(unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
+	return run(interval, 1, NULL, std::move(overCallback), param);
 }
 
-void TimerManager::runLoop(const char* id, unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param /*= NULL*/) {
-	run(id, interval, 0, triggerCallback, NULL, param);
+TimerHandle TimerManager::runOnce(const char* id, unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
+	return run(id, interval, 1, NULL, std::move(overCallback), param);
 }
 
-void TimerManager::runOnce(const char* id, unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param /*= NULL*/) {
-	run(id, interval, 1, NULL, overCallback, param);
+void TimerManager::stop(TimerHandle handle) {
+    if (0 == handle) {
+        return;
+    }
+    TimerCommand* cmd = allocCommand(TCT_STOP);
+    cmd->handle = handle;
+    pushCommand(cmd);
 }
 
 void TimerManager::stop(const char* id) {
 	if (!id || 0 == strlen(id)) {
 		return;
 	}
-    sStopIdListMutex.lock();
-    sStopIdList.push_back(id);
-    sStopIdListMutex.unlock();
+    TimerCommand* cmd = allocCommand(TCT_STOP);
+    cmd->id = id;
+    pushCommand(cmd);
+}
+
+void TimerManager::setSlack(const char* id, unsigned long slack) {
+    if (!id || 0 == strlen(id)) {
+        return;
+    }
+    TimerCommand* cmd = allocCommand(TCT_SLACK);
+    cmd->id = id;
+    cmd->value = slack;
+    pushCommand(cmd);
+}
+
+void TimerManager::setSlack(TimerHandle handle, unsigned long slack) {
+    if (0 == handle) {
+        return;
+    }
+    TimerCommand* cmd = allocCommand(TCT_SLACK);
+    cmd->handle = handle;
+    cmd->value = slack;
+    pushCommand(cmd);
+}
+
+void TimerManager::setCatchup(const char* id, unsigned int catchup) {
+    if (!id || 0 == strlen(id)) {
+        return;
+    }
+    TimerCommand* cmd = allocCommand(TCT_CATCHUP);
+    cmd->id = id;
+    cmd->value = catchup;
+    pushCommand(cmd);
+}
+
+void TimerManager::setCatchup(TimerHandle handle, unsigned int catchup) {
+    if (0 == handle) {
+        return;
+    }
+    TimerCommand* cmd = allocCommand(TCT_CATCHUP);
+    cmd->handle = handle;
+    cmd->value = catchup;
+    pushCommand(cmd);
+}
+
+bool TimerManager::getDriftStats(const char* id, timer_drift_st& drift) {
+    if (!id || 0 == strlen(id)) {
+        return false;
+    }
+    std::map<std::string, TimerSlot*>::iterator iter = sIdIndex.find(id);
+    if (sIdIndex.end() == iter) {
+        return false;
+    }
+    return 0 == get_timer_drift(&iter->second->tm, &drift);
+}
+
+bool TimerManager::getDriftStats(TimerHandle handle, timer_drift_st& drift) {
+    TimerSlot* slot = resolveSlot(handle);
+    if (!slot) {
+        return false;
+    }
+    return 0 == get_timer_drift(&slot->tm, &drift);
+}
+
+void TimerManager::setDefaultSlack(unsigned long slack) {
+    sDefaultSlack.store(slack, std::memory_order_relaxed);
 }
 
 void TimerManager::clear(void) {
-    sClearFlagMutex.lock();
-    sClearFlag = true;
-    sClearFlagMutex.unlock();
+    pushCommand(allocCommand(TCT_CLEAR));
+}
+
+void TimerManager::setWorkerCount(unsigned int count) {
+    stopPool();
+    for (unsigned int i = 0; i < count; ++i) {
+        sPoolThreads.push_back(std::thread(poolWorkerLoop));
+    }
+}
+
+void TimerManager::shutdown(void) {
+    stopPool();
+    clear();
+    update();
+}
+
+unsigned int TimerManager::getWorkerCount(void) {
+    return (unsigned int)sPoolThreads.size();
+}
+
+TimerPoolStats TimerManager::getPoolStats(void) {
+    std::lock_guard<std::mutex> lock(sPoolMutex);
+    return sPoolStats;
+}
+
+unsigned long TimerManager::getNextTimeout(void) {
+    if (sActiveSlots.empty()) {
+        return (unsigned long)-1;
+    }
+    unsigned long long now = (unsigned long long)(getTime() * 1000);
+    if (now >= sNextWakeup) {
+        return 0;
+    }
+    return (unsigned long)(sNextWakeup - now);
+}
+
+TimerCoalesceStats TimerManager::getCoalesceStats(void) {
+    return sCoalesceStats;
 }
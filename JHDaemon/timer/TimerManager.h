@@ -6,13 +6,39 @@
 #ifndef _TIMER_MANAGER_H_
 #define _TIMER_MANAGER_H_
 
-#include <functional>
+#include <cstddef>
+#include "InplaceFunction.h"
 #include "timer.h"
 
+/* 回调对象的最大字节数, 回调内联存储在定时器中, 不分配堆内存 */
+#define TIMER_CALLBACK_CAPACITY 64
 /* 定时器触发回调,返回值:无 */
-#define TIMER_TRIGGER_CALLBACK std::function<void(timer_st* tm, unsigned long runCount, void* param)>
+#define TIMER_TRIGGER_CALLBACK InplaceFunction<void(timer_st* tm, unsigned long runCount, void* param), TIMER_CALLBACK_CAPACITY>
 /* 定时器结束回调,返回值:无 */
-#define TIMER_OVER_CALLBACK std::function<void(timer_st* tm, void* param)>
+#define TIMER_OVER_CALLBACK InplaceFunction<void(timer_st* tm, void* param), TIMER_CALLBACK_CAPACITY>
+
+/* 定时器句柄, 低20位为槽位索引, 高12位为代数, 0为无效句柄 */
+typedef unsigned int TimerHandle;
+
+/* 回调线程池统计 */
+struct TimerPoolStats {
+    TimerPoolStats(void) : queueDepth(0), maxQueueDepth(0), executeCount(0), totalDuration(0), maxDuration(0) {}
+    unsigned long queueDepth;               /* timers waiting for a worker */
+    unsigned long maxQueueDepth;            /* max queue depth since start */
+    unsigned long long executeCount;        /* callback executions */
+    unsigned long long totalDuration;       /* total callback duration in microseconds */
+    unsigned long long maxDuration;         /* max callback duration in microseconds */
+};
+
+/* 定时器合并唤醒统计 */
+struct TimerCoalesceStats {
+    TimerCoalesceStats(void) : wakeupCount(0), idleCount(0), fireCount(0), totalError(0), maxError(0) {}
+    unsigned long long wakeupCount;         /* updates which fired at least one timer */
+    unsigned long long idleCount;           /* updates which fired nothing */
+    unsigned long long fireCount;           /* timer fires */
+    unsigned long long totalError;          /* sum of (fire time - deadline) in milliseconds */
+    unsigned long long maxError;            /* max (fire time - deadline) in milliseconds */
+};
 
 class TimerManager {
 public:
@@ -31,43 +57,82 @@ public:
     static TimerManager* getInstance(void);
 
     /*
-     * Brief:	update timer manager, need to be called in main thread for loop
+     * Brief:	update timer manager, need to be called in main thread for loop,
+     *          commands issued by run/stop/clear are applied here in the order they were issued
      * Param:	void
      * Return:	void
      */
     void update(void);
 
     /*
-     * Brief:	start a custom timer
+     * Brief:	start a custom timer, timers live in a slab and are addressed by handle,
+     *          in the steady state no heap memory is allocated
+     * Param:	interval - timer trigger interval(millisecond)
+     *			count - timer trigger count, when <=0 it will be in loop
+     *			triggerCallback - timer trigger callback
+     *			overCallback - timer over callback
+     *          param - param
+     * Return:	TimerHandle, 0 if interval is 0 or slab is full
+     */
+    TimerHandle run(unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
+
+    /*
+     * Brief:	start a custom timer with id, a running timer with the same id is replaced,
+     *          id is kept in a secondary index, prefer the handle version on hot paths
      * Param:	id - timer id
      *			interval - timer trigger interval(millisecond)
      *			count - timer trigger count, when <=0 it will be in loop
      *			triggerCallback - timer trigger callback
      *			overCallback - timer over callback
      *          param - param
-     * Return:	void
+     * Return:	TimerHandle, 0 if id is empty, interval is 0 or slab is full
      */
-    void run(const char* id, unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
+    TimerHandle run(const char* id, unsigned long interval, unsigned long count, TIMER_TRIGGER_CALLBACK triggerCallback, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
 
     /*
      * Brief:	start a loop timer
+     * Param:	interval - timer trigger interval(millisecond)
+     *			triggerCallback - timer trigger callback
+     *          param - param
+     * Return:	TimerHandle
+     */
+    TimerHandle runLoop(unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param = NULL);
+
+    /*
+     * Brief:	start a loop timer with id
      * Param:	id - id
      *			interval - timer trigger interval(millisecond)
      *			triggerCallback - timer trigger callback
      *          param - param
-     * Return:	void
+     * Return:	TimerHandle
      */
-    void runLoop(const char* id, unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param = NULL);
+    TimerHandle runLoop(const char* id, unsigned long interval, TIMER_TRIGGER_CALLBACK triggerCallback, void* param = NULL);
 
     /*
      * Brief:	start an once timer
+     * Param:	interval - timer trigger interval(millisecond)
+     *			overCallback - timer over callback
+     *          param - param
+     * Return:	TimerHandle
+     */
+    TimerHandle runOnce(unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
+
+    /*
+     * Brief:	start an once timer with id
      * Param:	id - id
      *			interval - timer trigger interval(millisecond)
      *			overCallback - timer over callback
      *          param - param
+     * Return:	TimerHandle
+     */
+    TimerHandle runOnce(const char* id, unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
+
+    /*
+     * Brief:	stop a timer, stale handles are ignored
+     * Param:	handle - timer handle
      * Return:	void
      */
-    void runOnce(const char* id, unsigned long interval, TIMER_OVER_CALLBACK overCallback, void* param = NULL);
+    void stop(TimerHandle handle);
 
     /*
      * Brief:	stop a timer
@@ -76,12 +141,121 @@ public:
      */
     void stop(const char* id);
 
+    /*
+     * Brief:	set slack of a timer, like linux timer_slack, the timer may fire up to slack
+     *          milliseconds after its deadline so that timers with overlapping windows share
+     *          one wakeup, a wakeup happens when the earliest (deadline + slack) is reached
+     *          and then fires every timer whose deadline has passed
+     * Param:	id - id
+     *			slack - slack in milliseconds
+     * Return:	void
+     */
+    void setSlack(const char* id, unsigned long slack);
+
+    /*
+     * Brief:	set slack of a timer
+     * Param:	handle - timer handle
+     *			slack - slack in milliseconds
+     * Return:	void
+     */
+    void setSlack(TimerHandle handle, unsigned long slack);
+
+    /*
+     * Brief:	set catch-up policy of a timer, deadlines stay phase locked to the start time,
+     *          the policy decides how periods missed by a late update are delivered
+     * Param:	id - id
+     *			catchup - TIMER_CATCHUP_COALESCE (default), TIMER_CATCHUP_SKIP, TIMER_CATCHUP_BURST
+     * Return:	void
+     */
+    void setCatchup(const char* id, unsigned int catchup);
+
+    /*
+     * Brief:	set catch-up policy of a timer
+     * Param:	handle - timer handle
+     *			catchup - TIMER_CATCHUP_XXX
+     * Return:	void
+     */
+    void setCatchup(TimerHandle handle, unsigned int catchup);
+
+    /*
+     * Brief:	get drift statistics of a timer, need to be called in the same thread as update
+     * Param:	id - id
+     *			drift - output statistics
+     * Return:	bool, false if timer not found
+     */
+    bool getDriftStats(const char* id, timer_drift_st& drift);
+
+    /*
+     * Brief:	get drift statistics of a timer, need to be called in the same thread as update
+     * Param:	handle - timer handle
+     *			drift - output statistics
+     * Return:	bool, false if timer not found
+     */
+    bool getDriftStats(TimerHandle handle, timer_drift_st& drift);
+
+    /*
+     * Brief:	set slack of timers created afterwards, default is 0
+     * Param:	slack - slack in milliseconds
+     * Return:	void
+     */
+    void setDefaultSlack(unsigned long slack);
+
     /*
      * Brief:	clear all timer
      * Param:	void
      * Return:	void
      */
     void clear(void);
+
+    /*
+     * Brief:	set callback worker count, 0 means callbacks are called inline in update (default),
+     *          otherwise fired callbacks are dispatched to a fixed thread pool, callbacks of the
+     *          same timer never overlap, fires during a running callback are merged into runCount,
+     *          callbacks on workers get a copy of the timer state taken when the timer fired, the
+     *          timer itself keeps being updated, changes made to the copy are not seen by the manager,
+     *          need to be called in the same thread as update, undelivered callbacks are dropped
+     * Param:	count - worker thread count
+     * Return:	void
+     */
+    void setWorkerCount(unsigned int count);
+
+    /*
+     * Brief:	stop and join the worker pool, callbacks being called are waited for and undelivered
+     *          callbacks are dropped, then all timers are cleared, need to be called in the same thread
+     *          as update before the data used by callbacks is released and before the process exits
+     * Param:	void
+     * Return:	void
+     */
+    void shutdown(void);
+
+    /*
+     * Brief:	get callback worker count
+     * Param:	void
+     * Return:	unsigned int
+     */
+    unsigned int getWorkerCount(void);
+
+    /*
+     * Brief:	get callback worker pool statistics
+     * Param:	void
+     * Return:	TimerPoolStats
+     */
+    TimerPoolStats getPoolStats(void);
+
+    /*
+     * Brief:	get milliseconds until the next wakeup, need to be called in the same thread as update,
+     *          the caller can sleep that long before next update
+     * Param:	void
+     * Return:	unsigned long, 0 means update now, (unsigned long)-1 means no timer
+     */
+    unsigned long getNextTimeout(void);
+
+    /*
+     * Brief:	get wakeup coalescing statistics
+     * Param:	void
+     * Return:	TimerCoalesceStats
+     */
+    TimerCoalesceStats getCoalesceStats(void);
 };
 
 #endif // _TIMER_MANAGER_H_
@@ -108,6 +282,8 @@ int main() {
     TimerManager::getInstance()->run("timer_1", 1000, 15, handleTimerTrigger1, handleTimerOver1, NULL);
     TimerManager::getInstance()->runLoop("timer_2", 2000, handleTimerTrigger2);
     TimerManager::getInstance()->runOnce("timer_3", 5000, handleTimerOver3);
+    TimerHandle handle = TimerManager::getInstance()->runLoop(3000, handleTimerTrigger2);
+    TimerManager::getInstance()->stop(handle);
     while (1) {
         Sleep(1);
         TimerManager::getInstance()->update();
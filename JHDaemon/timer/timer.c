@@ -5,6 +5,7 @@
 **********************************************************************/
 #include "timer.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 timer_st* create_timer(unsigned long interval, unsigned long count, timer_callback_run run_handler, timer_callback_over over_handler, void* param) {
@@ -13,17 +14,34 @@ timer_st* create_timer(unsigned long interval, unsigned long count, timer_callba
 	}
     static unsigned int s_id = 0;
 	timer_st* tm = (timer_st*)malloc(sizeof(timer_st));
+	if (!tm) {
+		return NULL;
+	}
+	init_timer(tm, interval, count, run_handler, over_handler, param);
     tm->id = ++s_id;
+	return tm;
+}
+
+int init_timer(timer_st* tm, unsigned long interval, unsigned long count, timer_callback_run run_handler, timer_callback_over over_handler, void* param) {
+	if (!tm) {
+		return 1;
+	}
+	if (interval <= 0) {
+		return 2;
+	}
+    tm->id = 0;
 	tm->interval = interval;
 	tm->total_count = count;
 	tm->current_count = 0;
 	tm->start_time = 0;
 	tm->running = 0;
 	tm->is_pause = 0;
+	tm->catchup = TIMER_CATCHUP_COALESCE;
+	memset(&tm->drift, 0, sizeof(timer_drift_st));
 	tm->run_handler = run_handler;
 	tm->over_handler = over_handler;
 	tm->param = param;
-	return tm;
+	return 0;
 }
 
 int update_timer(timer_st* tm, unsigned long long current_time) {
@@ -38,13 +56,40 @@ int update_timer(timer_st* tm, unsigned long long current_time) {
 		return 3;
 	}
     if (tm->total_count <= 0 || tm->current_count < tm->total_count) {
-        unsigned long long deltaTime = (unsigned long long)abs((unsigned int)(current_time - tm->start_time));
+        unsigned long long deltaTime = current_time - tm->start_time;
         if (deltaTime >= tm->interval) {
-            unsigned int runCount = (unsigned int)(deltaTime / tm->interval);
-            tm->current_count = tm->current_count + runCount;
-            tm->start_time = current_time;
-            if (tm->run_handler) {
-                tm->run_handler(tm, runCount, tm->param);
+            unsigned long periods = (unsigned long)(deltaTime / tm->interval);
+            unsigned long late = (unsigned long)(deltaTime - tm->interval);
+            unsigned long runCount = periods;
+            if (tm->total_count > 0 && runCount > tm->total_count - tm->current_count) {
+                runCount = tm->total_count - tm->current_count;
+            }
+            /* advance by whole periods so the phase is kept */
+            tm->start_time = tm->start_time + (unsigned long long)periods * tm->interval;
+            ++tm->drift.fire_count;
+            tm->drift.late_total = tm->drift.late_total + late;
+            if (late > tm->drift.late_max) {
+                tm->drift.late_max = late;
+            }
+            tm->drift.missed_count = tm->drift.missed_count + (periods - 1);
+            if (TIMER_CATCHUP_SKIP == tm->catchup) {
+                tm->current_count = tm->current_count + 1;
+                if (tm->run_handler) {
+                    tm->run_handler(tm, 1, tm->param);
+                }
+            } else if (TIMER_CATCHUP_BURST == tm->catchup) {
+                unsigned long i;
+                for (i = 0; i < runCount && tm->running; ++i) {
+                    tm->current_count = tm->current_count + 1;
+                    if (tm->run_handler) {
+                        tm->run_handler(tm, 1, tm->param);
+                    }
+                }
+            } else {
+                tm->current_count = tm->current_count + runCount;
+                if (tm->run_handler) {
+                    tm->run_handler(tm, runCount, tm->param);
+                }
             }
         }
     } else {
@@ -62,6 +107,7 @@ void start_timer(timer_st* tm, unsigned long long current_time, unsigned int exe
 	tm->is_pause = 0;
 	tm->current_count = 0;
 	tm->start_time = current_time;
+	memset(&tm->drift, 0, sizeof(timer_drift_st));
 	if (tm->run_handler && execute_flag) {
 		tm->run_handler(tm, 0, tm->param);
 	}
@@ -99,6 +145,13 @@ unsigned long get_timer_id(timer_st* tm) {
     return tm->id;
 }
 
+unsigned long long get_timer_deadline(timer_st* tm) {
+    if (!tm) {
+        return 0;
+    }
+    return tm->start_time + tm->interval;
+}
+
 unsigned long get_timer_interval(timer_st* tm) {
     if (!tm) {
 		return 0;
@@ -134,6 +187,28 @@ unsigned long get_timer_current_count(timer_st* tm) {
 	return tm->current_count;
 }
 
+unsigned int get_timer_catchup(timer_st* tm) {
+    if (!tm) {
+		return TIMER_CATCHUP_COALESCE;
+	}
+	return tm->catchup;
+}
+
+void set_timer_catchup(timer_st* tm, unsigned int catchup) {
+    if (!tm) {
+		return;
+	}
+	tm->catchup = catchup;
+}
+
+int get_timer_drift(timer_st* tm, timer_drift_st* drift) {
+    if (!tm || !drift) {
+		return 1;
+	}
+	*drift = tm->drift;
+	return 0;
+}
+
 unsigned int is_timer_running(timer_st* tm) {
     if (!tm) {
 		return 0;
@@ -141,6 +216,13 @@ unsigned int is_timer_running(timer_st* tm) {
 	return tm->running;
 }
 
+unsigned int is_timer_paused(timer_st* tm) {
+    if (!tm) {
+		return 0;
+	}
+	return tm->is_pause;
+}
+
 void set_timer_run_handler(timer_st* tm, timer_callback_run run_handler) {
     if (!tm) {
 		return;
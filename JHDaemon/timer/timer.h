@@ -16,12 +16,26 @@ struct timer_st;
 typedef void (*timer_callback_run)(struct timer_st* tm, unsigned long runCount, void* param);
 typedef void (*timer_callback_over)(struct timer_st* tm, void* param);
 
+/* catch-up policy, how periods missed by a late update are delivered */
+#define TIMER_CATCHUP_COALESCE  0           // one call, runCount is the number of elapsed periods (default)
+#define TIMER_CATCHUP_SKIP      1           // one call with runCount 1, missed periods are dropped
+#define TIMER_CATCHUP_BURST     2           // one call with runCount 1 for every elapsed period
+
+typedef struct timer_drift_st {
+    unsigned long fire_count;               // number of updates that triggered the timer
+    unsigned long late_max;                 // max lateness behind the deadline in milliseconds
+    unsigned long long late_total;          // sum of lateness in milliseconds
+    unsigned long missed_count;             // periods elapsed beyond the first one of each trigger
+} timer_drift_st;
+
 typedef struct timer_st {
     unsigned long id;                       // unique id
     unsigned long interval;					// interval duration in milliseconds
     unsigned long total_count;				// number of intervals, if count <= 0, timer will repeat forever
     unsigned long current_count;			// current interval count
-    unsigned long long start_time;			// start time for the current interval in milliseconds
+    unsigned long long start_time;			// start time for the current interval in milliseconds, deadline is start_time + interval
+    unsigned int catchup;                   // catch-up policy, TIMER_CATCHUP_XXX
+    timer_drift_st drift;                   // drift statistics since start
     unsigned int running;					// status of the timer
     unsigned int is_pause;					// is timer paused
     timer_callback_run run_handler;		    // called when current count changed
@@ -41,7 +55,20 @@ typedef struct timer_st {
 extern timer_st* create_timer(unsigned long interval, unsigned long count, timer_callback_run run_handler, timer_callback_over over_handler, void* param);
 
 /*
- * Brief:	update a timer
+ * Brief:	init a timer in caller provided memory, id is set to 0
+ * Param:	tm - timer
+ *			interval - interval duration in milliseconds
+ *			count - number of intervals, if count <= 0, timer will repeat forever
+ *			run_handler - called when current count changed
+ *			over_handler - called when timer is complete
+ *			param - parameter
+ * Return:	int, 0.ok, 1.tm is null, 2.interval is 0
+ */
+extern int init_timer(timer_st* tm, unsigned long interval, unsigned long count, timer_callback_run run_handler, timer_callback_over over_handler, void* param);
+
+/*
+ * Brief:	update a timer, deadlines are phase locked: the next deadline is the previous deadline plus
+ *          the interval, lateness of an update doesn't shift later deadlines, pause or clock going back resets the phase
  * Param:	tm - timer
  *			current_time - current time in milliseconds
  * Return:	int, 0.running, 1.tm is null, 2.tm not running, 3.tm is pause or not trigger, 4.tm is over
@@ -86,6 +113,13 @@ extern void pause_timer(timer_st* tm);
  */
 extern unsigned long get_timer_id(timer_st* tm);
 
+/*
+ * Brief:	get time of next trigger
+ * Param:	tm - timer
+ * Return:	long long, deadline in milliseconds
+ */
+extern unsigned long long get_timer_deadline(timer_st* tm);
+
 /*
  * Brief:	get timer interval
  * Param:	tm - timer
@@ -123,6 +157,29 @@ extern void set_timer_total_count(timer_st* tm, unsigned long count);
  */
 extern unsigned long get_timer_current_count(timer_st* tm);
 
+/*
+ * Brief:	get timer catch-up policy
+ * Param:	tm - timer
+ * Return:	int, TIMER_CATCHUP_XXX
+ */
+extern unsigned int get_timer_catchup(timer_st* tm);
+
+/*
+ * Brief:	set timer catch-up policy
+ * Param:	tm - timer
+ *			catchup - TIMER_CATCHUP_XXX
+ * Return:	void
+ */
+extern void set_timer_catchup(timer_st* tm, unsigned int catchup);
+
+/*
+ * Brief:	get timer drift statistics
+ * Param:	tm - timer
+ *			drift - output statistics
+ * Return:	int, 0.ok, 1.tm or drift is null
+ */
+extern int get_timer_drift(timer_st* tm, timer_drift_st* drift);
+
 /*
  * Brief:	check if timer is running
  * Param:	tm - timer
@@ -130,6 +187,13 @@ extern unsigned long get_timer_current_count(timer_st* tm);
  */
 extern unsigned int is_timer_running(timer_st* tm);
 
+/*
+ * Brief:	check if timer is paused
+ * Param:	tm - timer
+ * Return:	int, 0.Not paused, 1.Paused
+ */
+extern unsigned int is_timer_paused(timer_st* tm);
+
 /*
  * Brief:	set timer run handler
  * Param:	tm - timer
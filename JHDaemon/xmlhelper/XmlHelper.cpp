@@ -4,8 +4,11 @@
 * Brief:	xml helper
 **********************************************************************/
 #include "XmlHelper.h"
+#include <string.h>
 #include <fstream>
 
+#define XML_HELPER_MAX_QUERIES  1024    /* compiled keys kept, all are dropped when more keys are used */
+
 struct xml_writer_string : pugi::xml_writer {
     std::string result;
     virtual void write(const void* data, size_t size) {
@@ -13,6 +16,70 @@ struct xml_writer_string : pugi::xml_writer {
     }
 };
 
+/* key compiled once, nodes are resolved by walking the path or by the xpath query */
+struct XmlHelper::KeyQuery {
+    std::vector<std::string> keyVec;
+    pugi::xpath_query* xpath;       /* NULL for plain paths */
+    bool valid;
+    unsigned long long generation;  /* generation of node */
+    pugi::xml_node node;            /* empty node is cached too */
+};
+
+/* keys with these characters or a leading '/' are xpath queries, others are child names split by '/' */
+static bool isXPathKey(const std::string& key) {
+    return '/' == key[0] || std::string::npos != key.find_first_of("[]@*()|=");
+}
+
+/**********************************************************************
+ ***************************** ChildRange *****************************
+ **********************************************************************/
+/* next element sibling from node on, node itself included */
+static pugi::xml_node nextElement(pugi::xml_node node, const char* name) {
+    for (; !node.empty(); node = node.next_sibling()) {
+        if (pugi::node_element == node.type() && (!name || 0 == strcmp(name, node.name()))) {
+            break;
+        }
+    }
+    return node;
+}
+
+XmlHelper::ChildRange::iterator::iterator(const pugi::xml_node& node, const char* name) : mNode(node), mName(name) {}
+
+const pugi::xml_node& XmlHelper::ChildRange::iterator::operator*(void) const {
+    return mNode;
+}
+
+const pugi::xml_node* XmlHelper::ChildRange::iterator::operator->(void) const {
+    return &mNode;
+}
+
+XmlHelper::ChildRange::iterator& XmlHelper::ChildRange::iterator::operator++(void) {
+    mNode = nextElement(mNode.next_sibling(), mName);
+    return *this;
+}
+
+bool XmlHelper::ChildRange::iterator::operator==(const iterator& other) const {
+    return mNode == other.mNode;
+}
+
+bool XmlHelper::ChildRange::iterator::operator!=(const iterator& other) const {
+    return mNode != other.mNode;
+}
+
+XmlHelper::ChildRange::ChildRange(const pugi::xml_node& parent, const char* name) : mParent(parent), mName(name && *name ? name : NULL) {}
+
+XmlHelper::ChildRange::iterator XmlHelper::ChildRange::begin(void) const {
+    return iterator(nextElement(mParent.first_child(), mName), mName);
+}
+
+XmlHelper::ChildRange::iterator XmlHelper::ChildRange::end(void) const {
+    return iterator(pugi::xml_node(), mName);
+}
+
+bool XmlHelper::ChildRange::empty(void) const {
+    return begin() == end();
+}
+
 /**********************************************************************
  **************************** class methods ***************************
  **********************************************************************/
@@ -160,6 +227,14 @@ std::vector<pugi::xml_node> XmlHelper::getChildren(pugi::xml_node& parent) {
     return children;
 }
 
+XmlHelper::ChildRange XmlHelper::getChildRange(const pugi::xml_node& parent, const char* name /*= NULL*/) {
+    return ChildRange(parent, name);
+}
+
+XmlHelper::AttributeRange XmlHelper::getAttributeRange(const pugi::xml_node& node) {
+    return node.attributes();
+}
+
 pugi::xml_node XmlHelper::getNode(pugi::xml_node& parent, const std::string& key, bool createIfNotExist /*= false*/) {
     if (parent.empty() || key.empty()) {
         return pugi::xml_node();
@@ -309,19 +384,23 @@ XmlHelper::XmlHelper(void) {
     mDocument = NULL;
     mRoot = pugi::xml_node();
     mFileName = "";
+    mGeneration = 1;
 }
 
 XmlHelper::~XmlHelper(void) {
     if (mDocument) {
         delete mDocument;
     }
+    clearQueries();
 }
 
 pugi::xml_document* XmlHelper::getDocument(void) {
+    invalidate();
     return mDocument;
 }
 
 pugi::xml_node& XmlHelper::getRoot(void) {
+    invalidate();
     return mRoot;
 }
 
@@ -330,6 +409,7 @@ std::string XmlHelper::getFileName(void) {
 }
 
 bool XmlHelper::open(const std::string& fileName, bool forceCreate /*= false*/, const std::string& rootName /*= "root"*/) {
+    invalidate();
     if (mDocument) {
         delete mDocument;
         mDocument = NULL;
@@ -373,6 +453,7 @@ bool XmlHelper::clear(void) {
     if (!mDocument) {
         return false;
     }
+    invalidate();
     return removeChildren(mRoot);
 }
 
@@ -383,28 +464,32 @@ std::string XmlHelper::toString(void) {
     return toString(mDocument);
 }
 
+void XmlHelper::invalidate(void) {
+    ++mGeneration;
+}
+
 int XmlHelper::getInt(const std::string& key, int defaultValue /*= 0*/) {
-    return getNodeText(mRoot, key).as_int(defaultValue);
+    return findNode(key, false).text().as_int(defaultValue);
 }
 
 bool XmlHelper::setInt(const std::string& key, int value) {
     char str[32] = {0};
     sprintf(str, "%d", value);
-    return setNodeValue(mRoot, key, str);
+    return setValue(key, str);
 }
 
 long XmlHelper::getLong(const std::string& key, long defaultValue /*= 0*/) {
-    return getNodeText(mRoot, key).as_llong(defaultValue);
+    return findNode(key, false).text().as_llong(defaultValue);
 }
 
 bool XmlHelper::setLong(const std::string& key, long value) {
     char str[64] = {0};
     sprintf(str, "%ld", value);
-    return setNodeValue(mRoot, key, str);
+    return setValue(key, str);
 }
 
 float XmlHelper::getFloat(const std::string& key, float defaultValue /*= 0.0f*/) {
-    return getNodeText(mRoot, key).as_float(defaultValue);
+    return findNode(key, false).text().as_float(defaultValue);
 }
 
 bool XmlHelper::setFloat(const std::string& key, float value) {
@@ -412,31 +497,115 @@ bool XmlHelper::setFloat(const std::string& key, float value) {
 }
 
 double XmlHelper::getDouble(const std::string& key, double defaultValue /*= 0.0*/) {
-    return getNodeText(mRoot, key).as_double(defaultValue);
+    return findNode(key, false).text().as_double(defaultValue);
 }
 
 bool XmlHelper::setDouble(const std::string& key, double value) {
     char str[64] = {0};
     sprintf(str, "%f", value);
-    return setNodeValue(mRoot, key, str);
+    return setValue(key, str);
 }
 
 bool XmlHelper::getBool(const std::string& key, bool defaultValue /*= false*/) {
-    return getNodeText(mRoot, key).as_bool(defaultValue);
+    return findNode(key, false).text().as_bool(defaultValue);
 }
 
 bool XmlHelper::setBool(const std::string& key, bool value) {
-    return setNodeValue(mRoot, key, value ? "true" : "false");
+    return setValue(key, value ? "true" : "false");
 }
 
 std::string XmlHelper::getString(const std::string& key, const std::string& defaultValue /*= ""*/) {
-    return getNodeText(mRoot, key).as_string(defaultValue.c_str());
+    return findNode(key, false).text().as_string(defaultValue.c_str());
 }
 
 bool XmlHelper::setString(const std::string& key, const std::string& value) {
-    return setNodeValue(mRoot, key, value);
+    return setValue(key, value.c_str());
 }
 
 bool XmlHelper::remove(const std::string& key) {
-    return removeNode(mRoot, key);
+    pugi::xml_node node = findNode(key, false);
+    if (node.empty() || node == mRoot) {
+        return false;
+    }
+    invalidate();
+    return node.parent().remove_child(node);
+}
+
+pugi::xml_node XmlHelper::findNode(const std::string& key, bool createIfNotExist) {
+    if (mRoot.empty() || key.empty()) {
+        return pugi::xml_node();
+    }
+    KeyQuery* query = NULL;
+    std::unordered_map<std::string, KeyQuery*>::iterator iter = mQueries.find(key);
+    if (mQueries.end() == iter) {
+        /* keys built at runtime must not grow the cache without bound */
+        if (mQueries.size() >= XML_HELPER_MAX_QUERIES) {
+            clearQueries();
+        }
+        query = new KeyQuery();
+        query->xpath = NULL;
+        query->valid = true;
+        query->generation = 0;
+        if (isXPathKey(key)) {
+            try {
+                query->xpath = new pugi::xpath_query(key.c_str());
+            } catch (const pugi::xpath_exception&) {
+                query->valid = false;
+            }
+        } else {
+            size_t start = 0;
+            while (start <= key.size()) {
+                size_t end = key.find('/', start);
+                if (std::string::npos == end) {
+                    end = key.size();
+                }
+                if (end > start) {
+                    query->keyVec.push_back(key.substr(start, end - start));
+                }
+                start = end + 1;
+            }
+            query->valid = !query->keyVec.empty();
+        }
+        mQueries[key] = query;
+    } else {
+        query = iter->second;
+    }
+    if (!query->valid) {
+        return pugi::xml_node();
+    }
+    /* pugixml frees removed nodes, a cached node is only trusted while the generation is unchanged */
+    if (query->generation != mGeneration) {
+        if (query->xpath) {
+            query->node = mRoot.select_node(*query->xpath).node();
+        } else {
+            query->node = getNode(mRoot, query->keyVec, false);
+        }
+        query->generation = mGeneration;
+    }
+    /* xpath queries select existing nodes only */
+    if (query->node.empty() && createIfNotExist && !query->xpath) {
+        invalidate();
+        query->node = getNode(mRoot, query->keyVec, true);
+        query->generation = mGeneration;
+    }
+    return query->node;
+}
+
+void XmlHelper::clearQueries(void) {
+    std::unordered_map<std::string, KeyQuery*>::iterator iter = mQueries.begin();
+    for (; mQueries.end() != iter; ++iter) {
+        delete iter->second->xpath;
+        delete iter->second;
+    }
+    mQueries.clear();
+}
+
+bool XmlHelper::setValue(const std::string& key, const char* value) {
+    pugi::xml_node node = findNode(key, true);
+    if (node.empty()) {
+        return false;
+    }
+    /* values can change what xpath predicates select */
+    invalidate();
+    return node.text().set(value);
 }
@@ -7,10 +7,54 @@
 #define _XML_HELPER_H_
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "../pugixml/pugixml.hpp"
 
 class XmlHelper {
+/**********************************************************************
+ ***************************** type define ****************************
+ **********************************************************************/
+public:
+    /* element children of a node, optionally only those with a name, walked in place without allocation */
+    class ChildRange {
+    public:
+        class iterator {
+        public:
+            iterator(const pugi::xml_node& node, const char* name);
+
+            const pugi::xml_node& operator*(void) const;
+
+            const pugi::xml_node* operator->(void) const;
+
+            iterator& operator++(void);
+
+            bool operator==(const iterator& other) const;
+
+            bool operator!=(const iterator& other) const;
+
+        private:
+            pugi::xml_node mNode;
+            const char* mName;      /* NULL for all elements */
+        };
+
+    public:
+        ChildRange(const pugi::xml_node& parent, const char* name);
+
+        iterator begin(void) const;
+
+        iterator end(void) const;
+
+        bool empty(void) const;
+
+    private:
+        pugi::xml_node mParent;
+        const char* mName;
+    };
+
+    /* attributes of a node, walked in place without allocation */
+    typedef pugi::xml_object_range<pugi::xml_attribute_iterator> AttributeRange;
+
 /**********************************************************************
  **************************** class methods ***************************
  **********************************************************************/
@@ -35,8 +79,14 @@ public:
 
     static bool removeNode(pugi::xml_node& parent, const std::vector<std::string>& keyVec);
     
+    /* all child nodes including text and comments copied into a vector, getChildRange walks elements without copy */
     static std::vector<pugi::xml_node> getChildren(pugi::xml_node& parent);
 
+    /* name must be valid while the range is used, NULL or "" for all element children */
+    static ChildRange getChildRange(const pugi::xml_node& parent, const char* name = NULL);
+
+    static AttributeRange getAttributeRange(const pugi::xml_node& node);
+
     static pugi::xml_node getNode(pugi::xml_node& parent, const std::string& key, bool createIfNotExist = false);
 
     static pugi::xml_node getNode(pugi::xml_node& parent, const std::vector<std::string>& keyVec, bool createIfNotExist = false);
@@ -71,14 +121,17 @@ public:
 
 public:
     /*
-     * Brief:	get document
+     * Brief:	get document, cached nodes are dropped because nodes can be changed through it
      * Param:	void
      * Return:	pugi::xml_document*
      */
     pugi::xml_document* getDocument(void);
 
     /*
-     * Brief:	get root
+     * Brief:	get root, cached nodes are dropped because nodes can be changed through it, every
+     *          change made through a root or document kept from before a later getter or setter
+     *          must be followed by invalidate, cached nodes are not checked again and a removed
+     *          node is freed by pugixml
      * Param:	void
      * Return:	pugi::xml_node
      */
@@ -122,7 +175,17 @@ public:
     std::string toString(void);
 
     /*
-     * Brief:	get int value
+     * Brief:	drop nodes resolved by keys, the compiled keys are kept, must be called after nodes
+     *          are added or removed outside of the setters, remove and clear of this helper
+     * Param:	void
+     * Return:	void
+     */
+    void invalidate(void);
+
+    /*
+     * Brief:	get int value, keys of all getters and setters are compiled once and the resolved node is
+     *          cached until the document changes, a key can be a child name, a path e.g. "log/level"
+     *          or an xpath query relative to root e.g. "app[2]/path", setters create nodes of a path
      * Param:	key - key
      *			defaultValue - default int
      * Return:	int
@@ -224,10 +287,21 @@ public:
      */
     bool remove(const std::string& key);
 
+private:
+    struct KeyQuery;
+
+    pugi::xml_node findNode(const std::string& key, bool createIfNotExist);
+
+    bool setValue(const std::string& key, const char* value);
+
+    void clearQueries(void);
+
 private:
     pugi::xml_document* mDocument;  /* document */
     pugi::xml_node mRoot;           /* root node */
     std::string mFileName;          /* file name */
+    std::unordered_map<std::string, KeyQuery*> mQueries;   /* compiled keys */
+    unsigned long long mGeneration; /* changes when nodes are added or removed, cached nodes of older generations are resolved again */
 };
 
 #endif	// _XML_HELPER_H_
@@ -0,0 +1,577 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	streaming xml pull parser, the file is read through a fixed
+*           buffer and events are pulled one by one, no tree is built,
+*           so memory does not grow with the file
+**********************************************************************/
+#include "XmlPullParser.h"
+#include <string.h>
+
+#define XML_PULL_NPOS   ((size_t)-1)
+
+static bool isSpace(char c) {
+    return ' ' == c || '\t' == c || '\r' == c || '\n' == c;
+}
+
+static bool isNameEnd(char c) {
+    return isSpace(c) || '/' == c || '>' == c || '=' == c;
+}
+
+static void appendUtf8(std::string& str, unsigned int ch) {
+    if (ch < 0x80) {
+        str.push_back((char)ch);
+    } else if (ch < 0x800) {
+        str.push_back((char)(0xC0 | (ch >> 6)));
+        str.push_back((char)(0x80 | (ch & 0x3F)));
+    } else if (ch < 0x10000) {
+        str.push_back((char)(0xE0 | (ch >> 12)));
+        str.push_back((char)(0x80 | ((ch >> 6) & 0x3F)));
+        str.push_back((char)(0x80 | (ch & 0x3F)));
+    } else {
+        str.push_back((char)(0xF0 | (ch >> 18)));
+        str.push_back((char)(0x80 | ((ch >> 12) & 0x3F)));
+        str.push_back((char)(0x80 | ((ch >> 6) & 0x3F)));
+        str.push_back((char)(0x80 | (ch & 0x3F)));
+    }
+}
+
+/* length of the entity at data, 0 when it is not a known entity */
+static size_t decodeEntity(const char* data, size_t size, std::string& out) {
+    static const char* names[] = { "lt;", "gt;", "amp;", "apos;", "quot;" };
+    static const char values[] = { '<', '>', '&', '\'', '"' };
+    for (size_t i = 0; i < sizeof(values); ++i) {
+        size_t len = strlen(names[i]);
+        if (size >= 1 + len && 0 == memcmp(data + 1, names[i], len)) {
+            out.push_back(values[i]);
+            return 1 + len;
+        }
+    }
+    if (size < 4 || '#' != data[1]) {
+        return 0;
+    }
+    bool hex = 'x' == data[2];
+    unsigned int ch = 0;
+    size_t i = hex ? 3 : 2;
+    size_t digits = 0;
+    for (; i < size && ';' != data[i]; ++i, ++digits) {
+        char c = data[i];
+        if (c >= '0' && c <= '9') {
+            ch = ch * (hex ? 16 : 10) + (c - '0');
+        } else if (hex && (c | ' ') >= 'a' && (c | ' ') <= 'f') {
+            ch = ch * 16 + ((c | ' ') - 'a' + 10);
+        } else {
+            return 0;
+        }
+        if (ch > 0x10FFFF) {
+            return 0;
+        }
+    }
+    if (i >= size || 0 == digits) {
+        return 0;
+    }
+    appendUtf8(out, ch);
+    return i + 1;
+}
+
+/**********************************************************************
+ ******************************** Range *******************************
+ **********************************************************************/
+bool XmlPullParser::Range::empty(void) const {
+    return 0 == size;
+}
+
+bool XmlPullParser::Range::equals(const char* str) const {
+    return data && size == strlen(str) && 0 == memcmp(data, str, size);
+}
+
+std::string XmlPullParser::Range::toString(void) const {
+    return data ? std::string(data, size) : std::string();
+}
+
+unsigned int XmlPullParser::Range::toUint(unsigned int def /*= 0*/) const {
+    if (!data || 0 == size) {
+        return def;
+    }
+    size_t i = 0;
+    while (i < size && isSpace(data[i])) {
+        ++i;
+    }
+    bool negative = i < size && '-' == data[i];
+    if (i < size && ('-' == data[i] || '+' == data[i])) {
+        ++i;
+    }
+    unsigned long long value = 0;
+    bool overflow = false;
+    if (i + 1 < size && '0' == data[i] && 'x' == (data[i + 1] | ' ')) {
+        for (i += 2; i < size; ++i) {
+            char c = data[i] | ' ';
+            if (data[i] >= '0' && data[i] <= '9') {
+                value = value * 16 + (data[i] - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                value = value * 16 + (c - 'a' + 10);
+            } else {
+                break;
+            }
+            overflow = overflow || value > 0xFFFFFFFFULL;
+        }
+    } else {
+        for (; i < size && data[i] >= '0' && data[i] <= '9'; ++i) {
+            value = value * 10 + (data[i] - '0');
+            overflow = overflow || value > 0xFFFFFFFFULL;
+        }
+    }
+    if (negative) {
+        return 0;
+    }
+    return overflow ? 0xFFFFFFFFU : (unsigned int)value;
+}
+
+bool XmlPullParser::Range::toBool(bool def /*= false*/) const {
+    if (!data || 0 == size) {
+        return def;
+    }
+    char first = data[0];
+    return '1' == first || 't' == first || 'T' == first || 'y' == first || 'Y' == first;
+}
+
+/**********************************************************************
+ ************************** instance methods **************************
+ **********************************************************************/
+XmlPullParser::XmlPullParser(void) : mFile(NULL), mData(NULL), mPos(0), mEnd(0), mEof(true), mError(NULL),
+                                     mPendingEnd(false), mPendingPop(false), mSeenRoot(false), mTextRaw(false),
+                                     mTextDecoded(false), mTag(NULL) {
+    mName.data = NULL;
+    mName.size = 0;
+    mText = mName;
+}
+
+XmlPullParser::~XmlPullParser(void) {
+    close();
+}
+
+bool XmlPullParser::open(const std::string& fileName, size_t bufferSize /*= XML_PULL_DEFAULT_BUFFER*/) {
+    close();
+    mFile = fopen(fileName.c_str(), "rb");
+    if (!mFile) {
+        return false;
+    }
+    mBuffer.resize(bufferSize > 16 ? bufferSize : 16);
+    mData = mBuffer.data();
+    mEof = false;
+    return true;
+}
+
+void XmlPullParser::openBuffer(const char* data, size_t size) {
+    close();
+    mData = data;
+    mEnd = size;
+}
+
+void XmlPullParser::close(void) {
+    if (mFile) {
+        fclose(mFile);
+        mFile = NULL;
+    }
+    mData = NULL;
+    mPos = 0;
+    mEnd = 0;
+    mEof = true;
+    mError = NULL;
+    mNames.clear();
+    mNameOffsets.clear();
+    mPendingEnd = false;
+    mPendingPop = false;
+    mSeenRoot = false;
+    mAttributes.clear();
+}
+
+XmlPullParser::Event XmlPullParser::next(void) {
+    if (mError) {
+        return XPE_ERROR;
+    }
+    if (mPendingPop) {
+        mPendingPop = false;
+        mNames.resize(mNameOffsets.back());
+        mNameOffsets.pop_back();
+    }
+    mAttributes.clear();
+    if (mPendingEnd) {
+        mPendingEnd = false;
+        mPendingPop = true;
+        mName.data = mNames.data() + mNameOffsets.back();
+        mName.size = mNames.size() - mNameOffsets.back();
+        return XPE_END_ELEMENT;
+    }
+    while (1) {
+        if (!available(1)) {
+            if (!mNameOffsets.empty()) {
+                return fail("unexpected end of document");
+            }
+            return mSeenRoot ? XPE_END_DOCUMENT : fail("no document element");
+        }
+        if ('<' != mData[mPos]) {
+            size_t end = find(0, '<');
+            if (XML_PULL_NPOS == end) {
+                end = mEnd - mPos;
+            }
+            const char* text = mData + mPos;
+            mPos += end;
+            size_t i = 0;
+            while (i < end && isSpace(text[i])) {
+                ++i;
+            }
+            /* text outside of elements is ignored like pugixml does */
+            if (i == end || mNameOffsets.empty()) {
+                continue;
+            }
+            mText.data = text;
+            mText.size = end;
+            mTextRaw = false;
+            mTextDecoded = false;
+            return XPE_TEXT;
+        }
+        if (!available(2)) {
+            return fail("unexpected end of document");
+        }
+        char c = mData[mPos + 1];
+        if ('?' == c) {
+            size_t end = findSequence(2, "?>");
+            if (XML_PULL_NPOS == end) {
+                return fail("unterminated processing instruction");
+            }
+            mPos += end + 2;
+        } else if ('!' == c) {
+            if (available(4) && 0 == memcmp(mData + mPos, "<!--", 4)) {
+                size_t end = findSequence(4, "-->");
+                if (XML_PULL_NPOS == end) {
+                    return fail("unterminated comment");
+                }
+                mPos += end + 3;
+            } else if (available(9) && 0 == memcmp(mData + mPos, "<![CDATA[", 9)) {
+                size_t end = findSequence(9, "]]>");
+                if (XML_PULL_NPOS == end) {
+                    return fail("unterminated CDATA");
+                }
+                if (mNameOffsets.empty()) {
+                    mPos += end + 3;
+                    continue;
+                }
+                mText.data = mData + mPos + 9;
+                mText.size = end - 9;
+                mTextRaw = true;
+                mTextDecoded = false;
+                mPos += end + 3;
+                return XPE_TEXT;
+            } else if (!skipDoctype()) {
+                return fail("unterminated doctype");
+            }
+        } else if ('/' == c) {
+            return parseEndTag();
+        } else {
+            return parseStartTag();
+        }
+    }
+}
+
+size_t XmlPullParser::getDepth(void) const {
+    return mNameOffsets.size();
+}
+
+XmlPullParser::Range XmlPullParser::getName(void) const {
+    return mName;
+}
+
+XmlPullParser::Range XmlPullParser::getText(void) {
+    if (mTextRaw || mTextDecoded) {
+        return mText;
+    }
+    mTextDecoded = true;
+    mText = decode(mText.data, mText.size, mTextScratch);
+    return mText;
+}
+
+size_t XmlPullParser::getAttributeCount(void) const {
+    return mAttributes.size();
+}
+
+XmlPullParser::Range XmlPullParser::getAttributeName(size_t index) const {
+    Range range;
+    range.data = mTag + mAttributes[index].name;
+    range.size = mAttributes[index].nameSize;
+    return range;
+}
+
+XmlPullParser::Range XmlPullParser::getAttributeValue(size_t index) {
+    Attribute& attr = mAttributes[index];
+    Range range;
+    range.data = mTag + attr.value;
+    range.size = attr.valueSize;
+    if (attr.decoded) {
+        range.data = mAttributeScratch[index].data();
+        range.size = mAttributeScratch[index].size();
+        return range;
+    }
+    if (mAttributeScratch.size() < mAttributes.size()) {
+        mAttributeScratch.resize(mAttributes.size());
+    }
+    range = decode(range.data, range.size, mAttributeScratch[index]);
+    if (range.data == mAttributeScratch[index].data()) {
+        attr.decoded = true;
+    }
+    return range;
+}
+
+XmlPullParser::Range XmlPullParser::getAttribute(const char* name) {
+    for (size_t i = 0, len = mAttributes.size(); i < len; ++i) {
+        if (getAttributeName(i).equals(name)) {
+            return getAttributeValue(i);
+        }
+    }
+    Range range;
+    range.data = NULL;
+    range.size = 0;
+    return range;
+}
+
+const char* XmlPullParser::getError(void) const {
+    return mError;
+}
+
+/* read more data, [mPos, mEnd) is kept and moved to the front */
+bool XmlPullParser::fill(void) {
+    if (!mFile || mEof) {
+        return false;
+    }
+    if (mPos > 0) {
+        memmove(&mBuffer[0], &mBuffer[mPos], mEnd - mPos);
+        mEnd -= mPos;
+        mPos = 0;
+    }
+    if (mEnd == mBuffer.size()) {
+        mBuffer.resize(mBuffer.size() * 2);
+    }
+    size_t count = fread(&mBuffer[mEnd], 1, mBuffer.size() - mEnd, mFile);
+    mData = mBuffer.data();
+    if (0 == count) {
+        mEof = true;
+        return false;
+    }
+    mEnd += count;
+    return true;
+}
+
+bool XmlPullParser::available(size_t count) {
+    while (mEnd - mPos < count) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* offset from mPos, XML_PULL_NPOS when not found before the end */
+size_t XmlPullParser::find(size_t from, char c) {
+    while (1) {
+        if (mPos + from < mEnd) {
+            const char* p = (const char*)memchr(mData + mPos + from, c, mEnd - mPos - from);
+            if (p) {
+                return (size_t)(p - (mData + mPos));
+            }
+            from = mEnd - mPos;
+        }
+        if (!fill()) {
+            return XML_PULL_NPOS;
+        }
+    }
+}
+
+size_t XmlPullParser::findSequence(size_t from, const char* sequence) {
+    const size_t length = strlen(sequence);
+    while (1) {
+        size_t pos = find(from, sequence[0]);
+        if (XML_PULL_NPOS == pos || !available(pos + length)) {
+            return XML_PULL_NPOS;
+        }
+        if (0 == memcmp(mData + mPos + pos, sequence, length)) {
+            return pos;
+        }
+        from = pos + 1;
+    }
+}
+
+XmlPullParser::Event XmlPullParser::fail(const char* error) {
+    mError = error;
+    return XPE_ERROR;
+}
+
+XmlPullParser::Event XmlPullParser::parseStartTag(void) {
+    /* find '>' outside of quoted attribute values */
+    size_t from = 1;
+    size_t end = 0;
+    char quote = 0;
+    while (1) {
+        end = find(from, '>');
+        if (XML_PULL_NPOS == end) {
+            return fail("unterminated start tag");
+        }
+        for (size_t i = from; i < end; ++i) {
+            char c = mData[mPos + i];
+            if (quote) {
+                if (c == quote) {
+                    quote = 0;
+                }
+            } else if ('"' == c || '\'' == c) {
+                quote = c;
+            }
+        }
+        if (0 == quote) {
+            break;
+        }
+        from = end + 1;
+    }
+    const char* tag = mData + mPos;
+    bool empty = '/' == tag[end - 1];
+    size_t stop = empty ? end - 1 : end;
+    size_t i = 1;
+    while (i < stop && !isNameEnd(tag[i])) {
+        ++i;
+    }
+    if (1 == i) {
+        return fail("start tag has no name");
+    }
+    mName.data = tag + 1;
+    mName.size = i - 1;
+    mTag = tag;
+    while (1) {
+        while (i < stop && isSpace(tag[i])) {
+            ++i;
+        }
+        if (i >= stop) {
+            break;
+        }
+        Attribute attr;
+        attr.name = i;
+        while (i < stop && !isNameEnd(tag[i])) {
+            ++i;
+        }
+        attr.nameSize = i - attr.name;
+        while (i < stop && isSpace(tag[i])) {
+            ++i;
+        }
+        if (0 == attr.nameSize || i >= stop || '=' != tag[i]) {
+            return fail("attribute has no value");
+        }
+        ++i;
+        while (i < stop && isSpace(tag[i])) {
+            ++i;
+        }
+        if (i >= stop || ('"' != tag[i] && '\'' != tag[i])) {
+            return fail("attribute value is not quoted");
+        }
+        char q = tag[i++];
+        attr.value = i;
+        while (i < stop && q != tag[i]) {
+            ++i;
+        }
+        if (i >= stop) {
+            return fail("attribute value is not closed");
+        }
+        attr.valueSize = i - attr.value;
+        attr.decoded = false;
+        mAttributes.push_back(attr);
+        ++i;
+    }
+    mSeenRoot = true;
+    mNameOffsets.push_back(mNames.size());
+    mNames.append(mName.data, mName.size);
+    mPendingEnd = empty;
+    mPos += end + 1;
+    return XPE_START_ELEMENT;
+}
+
+XmlPullParser::Event XmlPullParser::parseEndTag(void) {
+    size_t end = find(2, '>');
+    if (XML_PULL_NPOS == end) {
+        return fail("unterminated end tag");
+    }
+    const char* tag = mData + mPos;
+    size_t size = end;
+    while (size > 2 && isSpace(tag[size - 1])) {
+        --size;
+    }
+    if (mNameOffsets.empty()) {
+        return fail("end tag without start tag");
+    }
+    const size_t offset = mNameOffsets.back();
+    if (size - 2 != mNames.size() - offset || 0 != memcmp(tag + 2, mNames.data() + offset, size - 2)) {
+        return fail("end tag does not match start tag");
+    }
+    mName.data = mNames.data() + offset;
+    mName.size = mNames.size() - offset;
+    mPendingPop = true;
+    mPos += end + 1;
+    return XPE_END_ELEMENT;
+}
+
+/* "<!DOCTYPE ... [ ... ]>", brackets of the internal subset are matched */
+bool XmlPullParser::skipDoctype(void) {
+    size_t depth = 0;
+    for (size_t i = 2; ; ++i) {
+        if (!available(i + 1)) {
+            return false;
+        }
+        char c = mData[mPos + i];
+        if ('[' == c) {
+            ++depth;
+        } else if (']' == c && depth > 0) {
+            --depth;
+        } else if ('>' == c && 0 == depth) {
+            mPos += i + 1;
+            return true;
+        }
+    }
+}
+
+/* decode entities and line ends, data is returned as it is when nothing changes */
+XmlPullParser::Range XmlPullParser::decode(const char* data, size_t size, std::string& scratch) {
+    const bool attribute = &scratch != &mTextScratch;
+    Range range;
+    range.data = data;
+    range.size = size;
+    size_t i = 0;
+    for (; i < size; ++i) {
+        char c = data[i];
+        if ('&' == c || '\r' == c || (attribute && ('\n' == c || '\t' == c))) {
+            break;
+        }
+    }
+    if (i == size) {
+        return range;
+    }
+    scratch.assign(data, i);
+    for (; i < size; ++i) {
+        char c = data[i];
+        if ('&' == c) {
+            size_t length = decodeEntity(data + i, size - i, scratch);
+            if (length > 0) {
+                i += length - 1;
+                continue;
+            }
+            scratch.push_back(c);
+        } else if ('\r' == c) {
+            /* "\r\n" and "\r" become one "\n", or one space in attribute values */
+            if (i + 1 < size && '\n' == data[i + 1]) {
+                ++i;
+            }
+            scratch.push_back(attribute ? ' ' : '\n');
+        } else if (attribute && ('\n' == c || '\t' == c)) {
+            scratch.push_back(' ');
+        } else {
+            scratch.push_back(c);
+        }
+    }
+    range.data = scratch.data();
+    range.size = scratch.size();
+    return range;
+}
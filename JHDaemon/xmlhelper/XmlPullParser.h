@@ -0,0 +1,192 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2017-12-25
+* Brief:	streaming xml pull parser, the file is read through a fixed
+*           buffer and events are pulled one by one, no tree is built,
+*           so memory does not grow with the file
+**********************************************************************/
+#ifndef _XML_PULL_PARSER_H_
+#define _XML_PULL_PARSER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define XML_PULL_DEFAULT_BUFFER     64*1024     /* grows only for a token larger than it */
+
+class XmlPullParser {
+public:
+    /**********************************************************************
+     * type define
+     **********************************************************************/
+    enum Event {
+        XPE_START_ELEMENT = 0,      /* name and attributes are valid */
+        XPE_END_ELEMENT,            /* name is valid, also follows an empty element "<a/>" */
+        XPE_TEXT,                   /* character data or CDATA, text of only whitespace is skipped */
+        XPE_END_DOCUMENT,
+        XPE_ERROR                   /* see getError, every later call returns XPE_ERROR */
+    };
+
+    /* characters in the parser buffer, valid until the next call of next */
+    struct Range {
+        const char* data;
+        size_t size;
+
+        bool empty(void) const;
+
+        bool equals(const char* str) const;
+
+        std::string toString(void) const;
+
+        /* same rules as pugi::xml_text::as_uint, def when empty */
+        unsigned int toUint(unsigned int def = 0) const;
+
+        /* same rules as pugi::xml_text::as_bool, def when empty */
+        bool toBool(bool def = false) const;
+    };
+
+public:
+    XmlPullParser(void);
+
+    virtual ~XmlPullParser(void);
+
+public:
+    /*
+     * Brief:	open xml file
+     * Param:	fileName - file name
+     *          bufferSize - read buffer size
+     * Return:	bool
+     */
+    bool open(const std::string& fileName, size_t bufferSize = XML_PULL_DEFAULT_BUFFER);
+
+    /*
+     * Brief:	parse xml in memory, the memory must be valid until close
+     * Param:	data - xml content
+     *          size - content size
+     * Return:	void
+     */
+    void openBuffer(const char* data, size_t size);
+
+    /*
+     * Brief:	close file
+     * Param:	void
+     * Return:	void
+     */
+    void close(void);
+
+    /*
+     * Brief:	pull next event, declarations, processing instructions, comments and doctype are skipped,
+     *          entities and line ends in text and attribute values are decoded like pugixml does,
+     *          and like pugixml text outside of elements is ignored and more than one top element is allowed
+     * Param:	void
+     * Return:	Event
+     */
+    Event next(void);
+
+    /*
+     * Brief:	get depth of current element, the document element is 1
+     * Param:	void
+     * Return:	size_t
+     */
+    size_t getDepth(void) const;
+
+    /*
+     * Brief:	get element name, for XPE_START_ELEMENT and XPE_END_ELEMENT
+     * Param:	void
+     * Return:	Range
+     */
+    Range getName(void) const;
+
+    /*
+     * Brief:	get text, for XPE_TEXT
+     * Param:	void
+     * Return:	Range
+     */
+    Range getText(void);
+
+    /*
+     * Brief:	get count of attributes, for XPE_START_ELEMENT
+     * Param:	void
+     * Return:	size_t
+     */
+    size_t getAttributeCount(void) const;
+
+    /*
+     * Brief:	get attribute name
+     * Param:	index - attribute index
+     * Return:	Range
+     */
+    Range getAttributeName(size_t index) const;
+
+    /*
+     * Brief:	get attribute value
+     * Param:	index - attribute index
+     * Return:	Range
+     */
+    Range getAttributeValue(size_t index);
+
+    /*
+     * Brief:	get attribute value by name
+     * Param:	name - attribute name
+     * Return:	Range, data is NULL when not exist
+     */
+    Range getAttribute(const char* name);
+
+    /*
+     * Brief:	get error message
+     * Param:	void
+     * Return:	const char*, NULL when no error
+     */
+    const char* getError(void) const;
+
+private:
+    struct Attribute {
+        size_t name;                /* offsets from the tag */
+        size_t nameSize;
+        size_t value;
+        size_t valueSize;
+        bool decoded;
+    };
+
+    bool fill(void);
+
+    bool available(size_t count);
+
+    size_t find(size_t from, char c);
+
+    size_t findSequence(size_t from, const char* sequence);
+
+    Event fail(const char* error);
+
+    Event parseStartTag(void);
+
+    Event parseEndTag(void);
+
+    bool skipDoctype(void);
+
+    Range decode(const char* data, size_t size, std::string& scratch);
+
+private:
+    FILE* mFile;
+    std::vector<char> mBuffer;
+    const char* mData;              /* mBuffer, or memory of openBuffer */
+    size_t mPos;                    /* start of the next token */
+    size_t mEnd;                    /* end of valid data */
+    bool mEof;
+    const char* mError;
+    std::string mNames;             /* names of open elements */
+    std::vector<size_t> mNameOffsets;
+    bool mPendingEnd;               /* end of an empty element is the next event */
+    bool mPendingPop;               /* the element ended by the last event is popped on next call */
+    bool mSeenRoot;
+    Range mName;
+    Range mText;
+    bool mTextRaw;                  /* CDATA is not decoded */
+    bool mTextDecoded;
+    std::string mTextScratch;
+    const char* mTag;               /* current start tag */
+    std::vector<Attribute> mAttributes;
+    std::vector<std::string> mAttributeScratch;
+};
+
+#endif	// _XML_PULL_PARSER_H_
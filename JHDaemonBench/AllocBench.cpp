@@ -0,0 +1,178 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	heap allocation check of the logging record paths
+**********************************************************************/
+#include "AllocBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "BenchCommon.h"
+#include "../JHDaemon/logfile/logfile.h"
+#include "../JHDaemon/logfile/logfileasync.h"
+#include "../JHDaemon/logfile/logfilewrapper.h"
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#ifdef _DEBUG
+#include <crtdbg.h>
+#define ALLOC_BENCH_HOOK    1
+#endif
+#elif defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define ALLOC_BENCH_HOOK    1
+#endif
+
+#define ALLOC_BENCH_BASENAME    "JHDaemonBench_alloc"
+#define ALLOC_BENCH_EXTNAME     ".log"
+#define ALLOC_BENCH_WARMUP      1000        /* calls before counting, first writes set up stdio buffers and caches */
+
+/* allocations of the counting thread only, background threads may allocate */
+static thread_local bool tCounting = false;
+static thread_local unsigned long long tAllocations = 0;
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#ifdef ALLOC_BENCH_HOOK
+static int allocHook(int allocType, void*, size_t, int, long, const unsigned char*, int) {
+    if (_HOOK_FREE != allocType && tCounting) {
+        ++tAllocations;
+    }
+    return TRUE;
+}
+#endif
+#elif defined(ALLOC_BENCH_HOOK)
+/* the bench replaces malloc of the whole process, operator new and the c library allocate through it */
+extern "C" {
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    if (tCounting) {
+        ++tAllocations;
+    }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (tCounting) {
+        ++tAllocations;
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (tCounting) {
+        ++tAllocations;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+#endif
+
+/* one record path, param is the file or wrapper */
+typedef unsigned int (*AllocBenchRecord)(void* target, const char* content);
+
+static unsigned int recordPlain(void* target, const char* content) {
+    return logfile_record((logfile_st*)target, content, 1);
+}
+
+static unsigned int recordWithTime(void* target, const char* content) {
+    return logfile_record_with_time((logfile_st*)target, content);
+}
+
+static unsigned int recordWithTag(void* target, const char* content) {
+    return logfile_record_with_tag((logfile_st*)target, "bench", 1, content);
+}
+
+static unsigned int recordWrapper(void* target, const char* content) {
+    return logfilewrapper_record((logfilewrapper_st*)target, "bench", 1, content);
+}
+
+static unsigned int recordAsync(void* target, const char* content) {
+    return logfileasync_record((logfileasync_st*)target, "bench", 1, content);
+}
+
+/* count allocations of records calls after the warm up, failed calls are counted too */
+static void benchPath(BenchJson& json, const char* name, AllocBenchRecord record, void* target, unsigned long records, bool* passed) {
+    char line[128] = { 0 };
+    unsigned long long failed = 0;
+    for (unsigned long i = 0; i < ALLOC_BENCH_WARMUP; ++i) {
+        sprintf(line, "Application \"C:/bench/app%02lu.exe\", pid = [%lu] has been ended\n", i % 16, i);
+        record(target, line);
+    }
+    tAllocations = 0;
+    for (unsigned long i = 0; i < records; ++i) {
+        sprintf(line, "Application \"C:/bench/app%02lu.exe\", pid = [%lu] has been ended\n", i % 16, i);
+        tCounting = true;
+        unsigned int ret = record(target, line);
+        tCounting = false;
+        if (0 != ret) {
+            ++failed;
+        }
+    }
+    unsigned long long allocations = tAllocations;
+    if (allocations > 0 || failed > 0) {
+        *passed = false;
+    }
+    json.beginObject();
+    json.value("path", std::string(name));
+    json.value("records", (unsigned long long)records);
+    json.value("failed", failed);
+    json.value("allocations", allocations);
+    json.value("allocations_per_record", records > 0 ? (double)allocations / (double)records : 0.0);
+    json.endObject();
+}
+
+std::string AllocBench::run(unsigned long records, bool* passed) {
+    BenchJson json;
+    /* no rotation during the run, rotation is measured by the rotate suite */
+    size_t fileSize = (size_t)(ALLOC_BENCH_WARMUP + records) * 256 + 1024 * 1024;
+    *passed = true;
+    json.beginObject();
+    json.value("benchmark", std::string("alloc"));
+#ifdef ALLOC_BENCH_HOOK
+    json.value("supported", true);
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    _CRT_ALLOC_HOOK oldHook = _CrtSetAllocHook(allocHook);
+#endif
+    json.beginArray("results");
+    remove(ALLOC_BENCH_BASENAME ALLOC_BENCH_EXTNAME);
+    logfile_st* lf = logfile_open(ALLOC_BENCH_BASENAME ALLOC_BENCH_EXTNAME, fileSize);
+    if (lf) {
+        benchPath(json, "logfile_record", recordPlain, lf, records, passed);
+        benchPath(json, "logfile_record_with_time", recordWithTime, lf, records, passed);
+        benchPath(json, "logfile_record_with_tag", recordWithTag, lf, records, passed);
+        logfile_close(lf);
+    } else {
+        *passed = false;
+    }
+    remove(ALLOC_BENCH_BASENAME ALLOC_BENCH_EXTNAME);
+    logfilewrapper_st* wrapper = logfilewrapper_init(ALLOC_BENCH_BASENAME, ALLOC_BENCH_EXTNAME, fileSize, 0);
+    if (wrapper) {
+        logfilewrapper_setindex(wrapper, LOGFILE_INDEX_DEFAULT_INTERVAL);
+        benchPath(json, "logfilewrapper_record", recordWrapper, wrapper, records, passed);
+        logfileasync_st* async = logfileasync_open(wrapper, LOGFILE_ASYNC_DEFAULT_CAPACITY, LOGFILE_ASYNC_BLOCK);
+        if (async) {
+            benchPath(json, "logfileasync_record", recordAsync, async, records, passed);
+            logfileasync_close(async);
+        }
+        logfilewrapper_close(wrapper);
+    } else {
+        *passed = false;
+    }
+    remove(ALLOC_BENCH_BASENAME ALLOC_BENCH_EXTNAME);
+    remove(ALLOC_BENCH_BASENAME ALLOC_BENCH_EXTNAME LOGFILE_INDEX_EXT);
+    json.endArray();
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    _CrtSetAllocHook(oldHook);
+#endif
+#else
+    json.value("supported", false);
+#endif
+    json.value("passed", *passed);
+    json.endObject();
+    return json.str();
+}
@@ -0,0 +1,26 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	heap allocation check of the logging record paths
+**********************************************************************/
+#ifndef _ALLOC_BENCH_H_
+#define _ALLOC_BENCH_H_
+
+#include <string>
+
+class AllocBench {
+public:
+    /*
+     * Brief:	count heap allocations made by the recording thread in steady state record calls of
+     *          logfile_record, logfile_record_with_time, logfile_record_with_tag, logfilewrapper_record
+     *          and logfileasync_record, files are sized so that no rotation happens, every path must
+     *          allocate nothing, allocations are counted by a malloc hook on glibc and by the crt
+     *          allocation hook of Windows debug builds, other builds report "supported": false
+     * Param:	records - record calls counted on each path, after a warm up
+     *          passed - output, false when a path allocated, true when unsupported
+     * Return:	std::string, json result
+     */
+    static std::string run(unsigned long records, bool* passed);
+};
+
+#endif // _ALLOC_BENCH_H_
@@ -0,0 +1,279 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	benchmark common, clock, histogram and json writer
+**********************************************************************/
+#ifndef _BENCH_COMMON_H_
+#define _BENCH_COMMON_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+class BenchClock {
+public:
+    /*
+     * Brief:	monotonic time
+     * Param:	void
+     * Return:	unsigned long long (nanoseconds)
+     */
+    static unsigned long long nowNs(void) {
+        return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+/*
+ * HDR style histogram: values are grouped by power of two, each group is split into
+ * 2^SUB_BITS linear sub buckets, so every recorded value keeps about 2 significant digits
+ */
+class BenchHistogram {
+public:
+    enum {
+        SUB_BITS = 7,
+        SUB_COUNT = 1 << SUB_BITS,
+        GROUP_COUNT = 64 - SUB_BITS + 1
+    };
+
+    BenchHistogram(void) : mCounts(GROUP_COUNT * SUB_COUNT, 0), mTotal(0), mMin(0), mMax(0), mSum(0.0) {}
+
+    /*
+     * Brief:	record a value
+     * Param:	value - value, unit is up to the caller
+     * Return:	void
+     */
+    void record(unsigned long long value) {
+        ++mCounts[bucketIndex(value)];
+        if (0 == mTotal || value < mMin) {
+            mMin = value;
+        }
+        if (value > mMax) {
+            mMax = value;
+        }
+        ++mTotal;
+        mSum += (double)value;
+    }
+
+    /*
+     * Brief:	merge another histogram
+     * Param:	other - histogram
+     * Return:	void
+     */
+    void merge(const BenchHistogram& other) {
+        for (size_t i = 0, len = mCounts.size(); i < len; ++i) {
+            mCounts[i] += other.mCounts[i];
+        }
+        if (other.mTotal > 0 && (0 == mTotal || other.mMin < mMin)) {
+            mMin = other.mMin;
+        }
+        if (other.mMax > mMax) {
+            mMax = other.mMax;
+        }
+        mTotal += other.mTotal;
+        mSum += other.mSum;
+    }
+
+    /*
+     * Brief:	get value at percentile
+     * Param:	percentile - [0, 100]
+     * Return:	unsigned long long, upper bound of the bucket
+     */
+    unsigned long long percentile(double percentile) const {
+        if (0 == mTotal) {
+            return 0;
+        }
+        unsigned long long target = (unsigned long long)(percentile / 100.0 * (double)mTotal + 0.5);
+        if (target < 1) {
+            target = 1;
+        }
+        unsigned long long seen = 0;
+        for (size_t i = 0, len = mCounts.size(); i < len; ++i) {
+            seen += mCounts[i];
+            if (seen >= target) {
+                unsigned long long value = bucketUpper(i);
+                return value < mMax ? value : mMax;
+            }
+        }
+        return mMax;
+    }
+
+    unsigned long long count(void) const {
+        return mTotal;
+    }
+
+    unsigned long long min(void) const {
+        return mMin;
+    }
+
+    unsigned long long max(void) const {
+        return mMax;
+    }
+
+    double mean(void) const {
+        return mTotal > 0 ? mSum / (double)mTotal : 0.0;
+    }
+
+    /*
+     * Brief:	get non-empty buckets
+     * Param:	uppers - output bucket upper bounds
+     *          counts - output bucket counts
+     * Return:	void
+     */
+    void buckets(std::vector<unsigned long long>& uppers, std::vector<unsigned long long>& counts) const {
+        for (size_t i = 0, len = mCounts.size(); i < len; ++i) {
+            if (mCounts[i] > 0) {
+                uppers.push_back(bucketUpper(i));
+                counts.push_back(mCounts[i]);
+            }
+        }
+    }
+
+private:
+    static size_t bucketIndex(unsigned long long value) {
+        if (value < SUB_COUNT) {
+            return (size_t)value;
+        }
+        unsigned int bits = 0;
+        while ((value >> bits) >= SUB_COUNT) {
+            ++bits;
+        }
+        /* group g holds [2^(g+SUB_BITS-1), 2^(g+SUB_BITS)), top half of the sub buckets is used */
+        return (size_t)(bits * SUB_COUNT + (value >> bits));
+    }
+
+    static unsigned long long bucketUpper(size_t index) {
+        unsigned int bits = (unsigned int)(index / SUB_COUNT);
+        unsigned long long sub = index % SUB_COUNT;
+        return ((sub + 1) << bits) - 1;
+    }
+
+private:
+    std::vector<unsigned long long> mCounts;
+    unsigned long long mTotal;
+    unsigned long long mMin;
+    unsigned long long mMax;
+    double mSum;
+};
+
+/* minimal json writer, keeps track of commas */
+class BenchJson {
+public:
+    BenchJson(void) : mNeedComma(false) {}
+
+    void beginObject(const char* key = NULL) {
+        writeKey(key);
+        mText += "{";
+        mNeedComma = false;
+    }
+
+    void endObject(void) {
+        mText += "}";
+        mNeedComma = true;
+    }
+
+    void beginArray(const char* key = NULL) {
+        writeKey(key);
+        mText += "[";
+        mNeedComma = false;
+    }
+
+    void endArray(void) {
+        mText += "]";
+        mNeedComma = true;
+    }
+
+    void value(const char* key, const std::string& str) {
+        writeKey(key);
+        mText += "\"";
+        for (size_t i = 0, len = str.size(); i < len; ++i) {
+            char c = str[i];
+            if ('"' == c || '\\' == c) {
+                mText += '\\';
+                mText += c;
+            } else if ((unsigned char)c < 0x20) {
+                char buf[8] = { 0 };
+                sprintf(buf, "\\u%04x", (unsigned int)(unsigned char)c);
+                mText += buf;
+            } else {
+                mText += c;
+            }
+        }
+        mText += "\"";
+        mNeedComma = true;
+    }
+
+    void value(const char* key, unsigned long long num) {
+        char buf[32] = { 0 };
+        sprintf(buf, "%llu", num);
+        writeKey(key);
+        mText += buf;
+        mNeedComma = true;
+    }
+
+    void value(const char* key, double num) {
+        char buf[64] = { 0 };
+        sprintf(buf, "%.3f", num);
+        writeKey(key);
+        mText += buf;
+        mNeedComma = true;
+    }
+
+    void value(const char* key, bool flag) {
+        writeKey(key);
+        mText += flag ? "true" : "false";
+        mNeedComma = true;
+    }
+
+    /*
+     * Brief:	write histogram summary and buckets
+     * Param:	key - key
+     *          hist - histogram
+     * Return:	void
+     */
+    void histogram(const char* key, const BenchHistogram& hist) {
+        beginObject(key);
+        value("count", hist.count());
+        value("min", hist.min());
+        value("mean", hist.mean());
+        value("p50", hist.percentile(50.0));
+        value("p90", hist.percentile(90.0));
+        value("p99", hist.percentile(99.0));
+        value("p999", hist.percentile(99.9));
+        value("max", hist.max());
+        std::vector<unsigned long long> uppers, counts;
+        hist.buckets(uppers, counts);
+        beginArray("buckets");
+        for (size_t i = 0, len = uppers.size(); i < len; ++i) {
+            beginArray();
+            value(NULL, uppers[i]);
+            value(NULL, counts[i]);
+            endArray();
+        }
+        endArray();
+        endObject();
+    }
+
+    const std::string& str(void) const {
+        return mText;
+    }
+
+private:
+    void writeKey(const char* key) {
+        if (mNeedComma) {
+            mText += ",";
+        }
+        if (key) {
+            mText += "\"";
+            mText += key;
+            mText += "\":";
+        }
+        mNeedComma = false;
+    }
+
+private:
+    std::string mText;
+    bool mNeedComma;
+};
+
+#endif // _BENCH_COMMON_H_
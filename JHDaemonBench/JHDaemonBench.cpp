@@ -0,0 +1,93 @@
+// JHDaemonBench.cpp: JHDaemon 各子系统的性能测试入口
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "AllocBench.h"
+#include "LogBench.h"
+#include "RotateBench.h"
+#include "TimerBench.h"
+#include "../JHDaemon/logfile/logchannel.h"
+
+static void usage(void) {
+    printf("usage: JHDaemonBench <suite> [options]\n");
+    printf("suites:\n");
+    printf("  timer    insert/cancel/fire throughput, idle tick cost and firing lateness\n");
+    printf("  rotate   logfile record latency at rotation, in recording thread and in background\n");
+    printf("  log      logging throughput, latency and write syscalls of every write path, 1 to n threads\n");
+    printf("  alloc    heap allocations of steady state log record calls, fails when a record allocates\n");
+    printf("options:\n");
+    printf("  --max <n>          max timer count, default 1000000\n");
+    printf("  --duration <ms>    duration of each lateness run, default 2000\n");
+    printf("  --records <n>      records written in each rotate mode, each log run and each alloc path, default 200000\n");
+    printf("  --filesize <n>     max log file size of rotate and log suites, default 1048576\n");
+    printf("  --threads <n>      max recording threads of log suite, default 4\n");
+    printf("  --dir <path>       log file directory of log suite, run once on tmpfs and once on disk, default current\n");
+    printf("  --sync <policy>    durability policy of log suite, none, interval, group or record, default none\n");
+    printf("  --out <file>       write json result to file, default stdout\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    std::string suite = argv[1];
+    unsigned long maxTimers = 1000000;
+    unsigned long durationMs = 2000;
+    unsigned long records = 200000;
+    unsigned long fileSize = 1024 * 1024;
+    unsigned long threads = 4;
+    std::string dir;
+    const char* sync = NULL;
+    const char* outFile = NULL;
+    for (int i = 2; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "--max") && i + 1 < argc) {
+            maxTimers = strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--duration") && i + 1 < argc) {
+            durationMs = strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--records") && i + 1 < argc) {
+            records = strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--filesize") && i + 1 < argc) {
+            fileSize = strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--dir") && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (0 == strcmp(argv[i], "--sync") && i + 1 < argc) {
+            sync = argv[++i];
+        } else if (0 == strcmp(argv[i], "--out") && i + 1 < argc) {
+            outFile = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    std::string result;
+    bool passed = true;
+    if ("timer" == suite) {
+        result = TimerBench::run(maxTimers, durationMs);
+    } else if ("rotate" == suite) {
+        result = RotateBench::run(records, fileSize);
+    } else if ("log" == suite) {
+        result = LogBench::run(dir, threads, records, fileSize, logchannel_parsesync(sync, LOGFILE_SYNC_NONE));
+    } else if ("alloc" == suite) {
+        result = AllocBench::run(records, &passed);
+    } else {
+        usage();
+        return 1;
+    }
+    if (outFile) {
+        FILE* fp = fopen(outFile, "wb");
+        if (!fp) {
+            fprintf(stderr, "can not open %s\n", outFile);
+            return 1;
+        }
+        fwrite(result.c_str(), 1, result.size(), fp);
+        fclose(fp);
+    } else {
+        printf("%s\n", result.c_str());
+    }
+    return passed ? 0 : 2;
+}
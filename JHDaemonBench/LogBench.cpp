@@ -0,0 +1,366 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	logging throughput and latency benchmark
+**********************************************************************/
+#include "LogBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+#include "BenchCommon.h"
+#include "../JHDaemon/logfile/logbinary.h"
+#include "../JHDaemon/logfile/logchannel.h"
+#include "../JHDaemon/logfile/logfileasync.h"
+#include "../JHDaemon/logfile/logfilemmap.h"
+#include "../JHDaemon/logfile/logsink.h"
+#include "../JHDaemon/logfile/logtime.h"
+#include "../JHDaemon/logformats.h"
+
+#define LOG_BENCH_NAME      "JHDaemonBench_log"
+#define LOG_BENCH_EXTNAME   ".log"
+#define LOG_BENCH_SMALL     64
+#define LOG_BENCH_LARGE     1024
+#define LOG_BENCH_SYNC_INTERVAL 100
+
+enum LogBenchMode {
+    LBM_SYNC = 0,       /* logfilewrapper_record under a mutex, rotation in background */
+    LBM_ASYNC,          /* logfileasync ring, blocking when full */
+    LBM_MMAP,           /* memory mapped text records */
+    LBM_BINARY,         /* memory mapped binary records */
+    LBM_CHANNEL,        /* log channel, ring drops when full */
+    LBM_DAEMON,         /* JHDaemon log(): level check, render once and publish to the file sink, without console */
+    LBM_COUNT
+};
+
+static const char* s_modeNames[LBM_COUNT] = { "sync", "async", "mmap", "binary", "channel", "daemon" };
+static const char* s_syncNames[] = { "none", "interval", "group", "record" };
+
+/* write paths of one run */
+struct LogBenchTarget {
+    LogBenchTarget(void) : wrapper(NULL), async(NULL), mmap(NULL), channel(NULL), pipe(NULL) {}
+    std::mutex mutex;
+    logfilewrapper_st* wrapper;
+    logfileasync_st* async;
+    logfilemmap_st* mmap;
+    logchannel_st* channel;
+    logsinkpipe_st* pipe;
+};
+
+/* file sink of JHDaemon, the channel has its own ring */
+static unsigned int channelSinkWrite(const logsink_record_st* record, void*) {
+    if (!record) {
+        return 0;
+    }
+    return 3 == logchannel_record((logchannel_st*)record->key, record->level, 0, record->text) ? 1 : 0;
+}
+
+/* write system calls of the process, background writers included */
+static bool writeSyscalls(unsigned long long& count) {
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    IO_COUNTERS io;
+    if (!GetProcessIoCounters(GetCurrentProcess(), &io)) {
+        return false;
+    }
+    count = io.WriteOperationCount;
+    return true;
+#else
+    FILE* fp = fopen("/proc/self/io", "r");
+    if (!fp) {
+        return false;
+    }
+    char line[128] = { 0 };
+    bool found = false;
+    while (fgets(line, sizeof(line), fp)) {
+        if (0 == strncmp(line, "syscw:", 6)) {
+            count = strtoull(line + 6, NULL, 10);
+            found = true;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+#endif
+}
+
+/* remove every file of the benchmark in dir, current, rotated and compressed */
+static unsigned long removeFiles(const std::string& dir) {
+    std::vector<std::string> names;
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + LOG_BENCH_NAME "*").c_str(), &data);
+    if (INVALID_HANDLE_VALUE != find) {
+        do {
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                names.push_back(data.cFileName);
+            }
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    const size_t prefixLength = strlen(LOG_BENCH_NAME);
+    DIR* d = opendir(dir.empty() ? "." : dir.c_str());
+    if (d) {
+        struct dirent* entry = NULL;
+        while (NULL != (entry = readdir(d))) {
+            if (0 == strncmp(entry->d_name, LOG_BENCH_NAME, prefixLength)) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(d);
+    }
+#endif
+    for (size_t i = 0, len = names.size(); i < len; ++i) {
+        remove((dir + names[i]).c_str());
+    }
+    return (unsigned long)names.size();
+}
+
+static bool openTarget(LogBenchTarget& target, LogBenchMode mode, const std::string& basename, unsigned long fileSize, unsigned int syncPolicy) {
+    switch (mode) {
+    case LBM_SYNC:
+    case LBM_ASYNC:
+        target.wrapper = logfilewrapper_init(basename.c_str(), LOG_BENCH_EXTNAME, fileSize, 0);
+        if (!target.wrapper) {
+            return false;
+        }
+        logfilewrapper_prepare(target.wrapper);
+        logfilewrapper_setsync(target.wrapper, syncPolicy, LOG_BENCH_SYNC_INTERVAL);
+        if (LBM_ASYNC == mode) {
+            target.async = logfileasync_open(target.wrapper, LOGFILE_ASYNC_DEFAULT_CAPACITY, LOGFILE_ASYNC_BLOCK);
+            return NULL != target.async;
+        }
+        return true;
+    case LBM_MMAP:
+        target.mmap = logfilemmap_open(basename.c_str(), LOG_BENCH_EXTNAME, fileSize, LOGFILE_MMAP_DEFAULT_SYNC);
+        return NULL != target.mmap;
+    case LBM_BINARY:
+        target.mmap = logfilemmap_open(basename.c_str(), ".jhlog", fileSize, LOGFILE_MMAP_DEFAULT_SYNC);
+        return NULL != target.mmap;
+    default:
+        target.channel = logchannel_open(LOG_BENCH_NAME, basename.c_str(), LOG_BENCH_EXTNAME, fileSize,
+                                         LOGFILE_ASYNC_DEFAULT_CAPACITY, LOG_LEVEL_INFO);
+        if (!target.channel) {
+            return false;
+        }
+        logchannel_setsync(target.channel, syncPolicy, LOG_BENCH_SYNC_INTERVAL);
+        if (LBM_DAEMON == mode) {
+            target.pipe = logsinkpipe_open(LOG_SINK_DEFAULT_POOL);
+            if (!target.pipe) {
+                return false;
+            }
+            logsinkpipe_add(target.pipe, logsink_open("file", 0, LOG_SINK_DROP, channelSinkWrite, NULL));
+        }
+        return true;
+    }
+}
+
+/* flush and close, pending records are part of the measured time, stats and failed can be NULL, failed gets records the async writer could not write */
+static void closeTarget(LogBenchTarget& target, logfile_syncstats_st* stats, unsigned long long* failed) {
+    if (target.async) {
+        if (failed) {
+            logfileasync_stats_st asyncStats;
+            logfileasync_flush(target.async);
+            logfileasync_stats(target.async, &asyncStats);
+            *failed = asyncStats.failed;
+        }
+        logfileasync_close(target.async);
+    }
+    if (target.wrapper) {
+        if (stats) {
+            logfilewrapper_syncstats(target.wrapper, stats);
+        }
+        logfilewrapper_close(target.wrapper);
+    }
+    if (target.mmap) {
+        logfilemmap_close(target.mmap);
+    }
+    if (target.pipe) {
+        logsinkpipe_close(target.pipe);
+    }
+    if (target.channel) {
+        if (stats) {
+            logchannel_syncstats(target.channel, stats);
+        }
+        logchannel_close(target.channel);
+    }
+}
+
+/* same steps as log() of JHDaemon */
+static unsigned int daemonLog(logsinkpipe_st* pipe, logchannel_st* channel, const std::string& path, unsigned long pid) {
+    const unsigned int level = getLogLevel(LF_APP_ENDED);
+    if (!logchannel_isenable(channel, level)) {
+        return 1;
+    }
+    unsigned long long now = logtime_now_ms();
+    char date[32] = { 0 };
+    date[0] = '[';
+    size_t dateLength = 1 + logtime_format(now, date + 1, sizeof(date) - 3, 1);
+    date[dateLength++] = ']';
+    date[dateLength++] = ' ';
+    std::string str(date, dateLength);
+    str += LogBinary::render(getLogFormat(LF_APP_ENDED), path, pid);
+    logsink_record_st record;
+    record.key = channel;
+    record.level = level;
+    record.ms = now;
+    record.text = str.c_str();
+    record.length = str.size();
+    record.offset = dateLength;
+    return logsinkpipe_publish(pipe, &record);
+}
+
+static unsigned int recordOnce(LogBenchTarget& target, LogBenchMode mode, const std::string& content, const std::string& path, unsigned long pid) {
+    switch (mode) {
+    case LBM_SYNC: {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        unsigned int flag = logfilewrapper_record(target.wrapper, NULL, 1, content.c_str());
+        logfilewrapper_commit(target.wrapper);
+        return flag;
+    }
+    case LBM_ASYNC:
+        return logfileasync_record(target.async, NULL, 1, content.c_str());
+    case LBM_MMAP:
+        return logfilemmap_record(target.mmap, NULL, 1, content.c_str());
+    case LBM_BINARY: {
+        char buf[LOG_BINARY_MAX_RECORD];
+        size_t length = LogBinary::encode(buf, sizeof(buf), (unsigned short)LF_APP_ENDED, logtime_now_ms(), path, pid);
+        return length > 0 ? logfilemmap_write(target.mmap, buf, length) : 1;
+    }
+    case LBM_CHANNEL:
+        return logchannel_record(target.channel, LOG_LEVEL_WARNING, 1, content.c_str());
+    default:
+        return daemonLog(target.pipe, target.channel, path, pid);
+    }
+}
+
+static void benchRun(BenchJson& json, const std::string& dir, LogBenchMode mode, unsigned long threadCount,
+                     size_t messageSize, unsigned long records, unsigned long fileSize, unsigned int syncPolicy) {
+    removeFiles(dir);
+    LogBenchTarget target;
+    if (!openTarget(target, mode, dir + LOG_BENCH_NAME, fileSize, syncPolicy)) {
+        closeTarget(target, NULL, NULL);
+        removeFiles(dir);
+        return;
+    }
+    /* path is sized so that a rendered record is about messageSize bytes */
+    const std::string prefix = "C:/bench/";
+    const size_t overhead = strlen(getLogFormat(LF_APP_ENDED)) + prefix.size() + 4;
+    const std::string path = prefix + std::string(messageSize > overhead ? messageSize - overhead : 1, 'a');
+    const std::string content = LogBinary::render(getLogFormat(LF_APP_ENDED), path, 1234UL);
+    const unsigned long perThread = (records + threadCount - 1) / threadCount;
+    std::vector<BenchHistogram> latency(threadCount);
+    std::vector<unsigned long long> failed(threadCount, 0);
+    std::vector<std::thread> threads;
+    std::atomic<bool> go(false);
+    for (unsigned long t = 0; t < threadCount; ++t) {
+        threads.push_back(std::thread([&, t]()->void {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            unsigned long long count = 0;
+            for (unsigned long i = 0; i < perThread; ++i) {
+                unsigned long long beginNs = BenchClock::nowNs();
+                unsigned int flag = recordOnce(target, mode, content, path, i);
+                latency[t].record(BenchClock::nowNs() - beginNs);
+                if (0 != flag) {
+                    ++count;
+                }
+            }
+            failed[t] = count;
+        }));
+    }
+    unsigned long long syscallsBegin = 0;
+    unsigned long long syscallsEnd = 0;
+    bool syscalls = writeSyscalls(syscallsBegin);
+    unsigned long long beginNs = BenchClock::nowNs();
+    go.store(true);
+    for (size_t t = 0, len = threads.size(); t < len; ++t) {
+        threads[t].join();
+    }
+    logfile_syncstats_st stats;
+    memset(&stats, 0, sizeof(stats));
+    unsigned long long writeFailed = 0;
+    closeTarget(target, &stats, &writeFailed);
+    unsigned long long elapsedNs = BenchClock::nowNs() - beginNs;
+    syscalls = syscalls && writeSyscalls(syscallsEnd);
+    unsigned long files = removeFiles(dir);
+    BenchHistogram total;
+    unsigned long long totalFailed = writeFailed;
+    for (unsigned long t = 0; t < threadCount; ++t) {
+        total.merge(latency[t]);
+        totalFailed += failed[t];
+    }
+    /* throughput counts only records which were written, failed records are attempts */
+    const unsigned long long attempted = total.count();
+    const unsigned long long written = attempted - totalFailed;
+    const double seconds = (double)elapsedNs / 1e9;
+    json.beginObject();
+    json.value("mode", std::string(s_modeNames[mode]));
+    json.value("threads", (unsigned long long)threadCount);
+    json.value("message_size", (unsigned long long)content.size());
+    json.value("records", attempted);
+    json.value("written", written);
+    json.value("failed", totalFailed);
+    json.value("files", (unsigned long long)files);
+    json.value("seconds", seconds);
+    json.value("records_per_sec", seconds > 0 ? (double)written / seconds : 0.0);
+    json.value("mb_per_sec", seconds > 0 ? (double)(written * content.size()) / seconds / (1024.0 * 1024.0) : 0.0);
+    if (syscalls && written > 0) {
+        json.value("write_syscalls_per_record", (double)(syscallsEnd - syscallsBegin) / (double)written);
+    }
+    if (stats.syncs > 0) {
+        json.beginObject("sync");
+        json.value("syncs", stats.syncs);
+        json.value("writes", stats.writes);
+        json.value("mean_ns", (double)stats.totalNs / (double)stats.syncs);
+        json.value("max_ns", stats.maxNs);
+        json.endObject();
+    }
+    json.histogram("latency_ns", total);
+    json.endObject();
+}
+
+std::string LogBench::run(const std::string& dir, unsigned long maxThreads, unsigned long records, unsigned long fileSize, unsigned int syncPolicy) {
+    std::string prefix = dir;
+    if (!prefix.empty() && '/' != prefix[prefix.size() - 1] && '\\' != prefix[prefix.size() - 1]) {
+        prefix += "/";
+    }
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+    std::vector<unsigned long> threadCounts;
+    for (unsigned long n = 1; n < maxThreads; n *= 2) {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(maxThreads);
+    const size_t sizes[] = { LOG_BENCH_SMALL, LOG_BENCH_LARGE };
+    unsigned long long probe = 0;
+    BenchJson json;
+    json.beginObject();
+    json.value("benchmark", std::string("log"));
+    json.value("dir", dir.empty() ? std::string(".") : dir);
+    json.value("file_size", (unsigned long long)fileSize);
+    json.value("sync", std::string(s_syncNames[syncPolicy <= LOGFILE_SYNC_RECORD ? syncPolicy : LOGFILE_SYNC_NONE]));
+    json.value("syscalls_counted", writeSyscalls(probe));
+    json.beginArray("results");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (size_t n = 0, len = threadCounts.size(); n < len; ++n) {
+            for (int m = 0; m < LBM_COUNT; ++m) {
+                benchRun(json, prefix, (LogBenchMode)m, threadCounts[n], sizes[s], records, fileSize, syncPolicy);
+            }
+        }
+    }
+    json.endArray();
+    json.endObject();
+    return json.str();
+}
@@ -0,0 +1,28 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	logging throughput and latency benchmark
+**********************************************************************/
+#ifndef _LOG_BENCH_H_
+#define _LOG_BENCH_H_
+
+#include <string>
+
+class LogBench {
+public:
+    /*
+     * Brief:	run logging benchmark on every write path, synchronous wrapper, asynchronous ring,
+     *          memory mapped text and binary, log channel and the daemon log path, from 1 to
+     *          maxThreads threads with small and large messages, files rotate during the run
+     * Param:	dir - directory of log files, e.g. a tmpfs mount or a real disk
+     *          maxThreads - max recording threads, e.g. 4
+     *          records - records written in each run, split between threads
+     *          fileSize - max log file size in bytes, e.g. 1048576
+     *          syncPolicy - durability policy of file write paths, LOGFILE_SYNC_XXX, memory
+     *                       mapped paths are not affected
+     * Return:	std::string, json result
+     */
+    static std::string run(const std::string& dir, unsigned long maxThreads, unsigned long records, unsigned long fileSize, unsigned int syncPolicy);
+};
+
+#endif // _LOG_BENCH_H_
@@ -0,0 +1,76 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	logfile rotation benchmark
+**********************************************************************/
+#include "RotateBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "BenchCommon.h"
+#include "../JHDaemon/logfile/logfilewrapper.h"
+
+#define ROTATE_BENCH_BASENAME   "JHDaemonBench_rotate"
+#define ROTATE_BENCH_EXTNAME    ".log"
+
+/* rotated files are collected and removed after the run */
+static void onRotate(const char* filename, void* param) {
+    std::vector<std::string>* rotated = (std::vector<std::string>*)param;
+    rotated->push_back(filename);
+}
+
+static void benchMode(BenchJson& json, bool background, unsigned long records, unsigned long fileSize) {
+    std::vector<std::string> rotated;
+    BenchHistogram steady;
+    BenchHistogram rotation;
+    char line[128] = { 0 };
+    remove(ROTATE_BENCH_BASENAME ROTATE_BENCH_EXTNAME);
+    logfilewrapper_st* wrapper = logfilewrapper_init(ROTATE_BENCH_BASENAME, ROTATE_BENCH_EXTNAME, fileSize, 0);
+    if (!wrapper) {
+        return;
+    }
+    logfilewrapper_onrotate(wrapper, onRotate, &rotated);
+    if (background) {
+        logfilewrapper_prepare(wrapper);
+    }
+    for (unsigned long i = 0; i < records; ++i) {
+        sprintf(line, "[2018-05-10 12:00:00.000] Application \"C:/bench/app%02lu.exe\", pid = [%lu] has been ended\n", i % 16, i);
+        size_t before = wrapper->logfile->filesize;
+        unsigned long long beginNs = BenchClock::nowNs();
+        logfilewrapper_record(wrapper, NULL, 0, line);
+        unsigned long long elapsedNs = BenchClock::nowNs() - beginNs;
+        /* a rotating record lands in an empty file */
+        if (wrapper->logfile->filesize < before) {
+            rotation.record(elapsedNs);
+        } else {
+            steady.record(elapsedNs);
+        }
+    }
+    logfilewrapper_close(wrapper);
+    json.beginObject();
+    json.value("mode", std::string(background ? "background" : "sync"));
+    json.value("records", (unsigned long long)records);
+    json.value("rotations", (unsigned long long)rotated.size());
+    json.histogram("steady_ns", steady);
+    json.histogram("rotation_ns", rotation);
+    json.value("rotation_max_over_steady_p999", steady.percentile(99.9) > 0 ? (double)rotation.max() / (double)steady.percentile(99.9) : 0.0);
+    json.endObject();
+    for (size_t i = 0, len = rotated.size(); i < len; ++i) {
+        remove(rotated[i].c_str());
+    }
+    remove(ROTATE_BENCH_BASENAME ROTATE_BENCH_EXTNAME);
+}
+
+std::string RotateBench::run(unsigned long records, unsigned long fileSize) {
+    BenchJson json;
+    json.beginObject();
+    json.value("benchmark", std::string("rotate"));
+    json.value("file_size", (unsigned long long)fileSize);
+    json.beginArray("results");
+    benchMode(json, false, records, fileSize);
+    benchMode(json, true, records, fileSize);
+    json.endArray();
+    json.endObject();
+    return json.str();
+}
@@ -0,0 +1,23 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	logfile rotation benchmark
+**********************************************************************/
+#ifndef _ROTATE_BENCH_H_
+#define _ROTATE_BENCH_H_
+
+#include <string>
+
+class RotateBench {
+public:
+    /*
+     * Brief:	run logfile wrapper rotation benchmark, record latency of steady records and of records
+     *          which rotate the file, with rotation in the recording thread and in background
+     * Param:	records - records written in each mode, e.g. 200000
+     *          fileSize - max file size in bytes, e.g. 1048576
+     * Return:	std::string, json result
+     */
+    static std::string run(unsigned long records, unsigned long fileSize);
+};
+
+#endif // _ROTATE_BENCH_H_
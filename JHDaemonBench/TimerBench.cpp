@@ -0,0 +1,281 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	timer benchmark
+**********************************************************************/
+#include "TimerBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "BenchCommon.h"
+#include "../JHDaemon/timer/timer.h"
+#include "../JHDaemon/timer/TimerManager.h"
+
+/* per timer state shared by all engines */
+struct TimerBenchParam {
+    unsigned long long lastNs;      /* time of add or last fire */
+    unsigned long interval;         /* interval in milliseconds */
+    BenchHistogram* lateness;       /* lateness in microseconds, NULL when not measured */
+    unsigned long long* fires;      /* fire counter */
+};
+
+static void onFire(TimerBenchParam* p) {
+    unsigned long long now = BenchClock::nowNs();
+    if (p->lateness) {
+        unsigned long long elapsedUs = (now - p->lastNs) / 1000;
+        unsigned long long intervalUs = (unsigned long long)p->interval * 1000;
+        p->lateness->record(elapsedUs > intervalUs ? elapsedUs - intervalUs : 0);
+    }
+    p->lastNs = now;
+    ++(*p->fires);
+}
+
+/* timer engine, every engine exposes the same add/cancel/tick operations */
+class TimerBenchEngine {
+public:
+    virtual ~TimerBenchEngine(void) {}
+    virtual const char* name(void) = 0;
+    virtual void reserve(size_t count) = 0;
+    virtual void add(size_t index, unsigned long interval, TimerBenchParam* param) = 0;
+    virtual void cancel(size_t index) = 0;
+    virtual void apply(void) = 0;       /* make queued add/cancel take effect */
+    virtual void tick(void) = 0;        /* one scheduler pass */
+    virtual void clear(void) = 0;
+};
+
+/* raw timer.c, one malloc'ed timer each, scanned linearly */
+class TimerBenchEngineC : public TimerBenchEngine {
+public:
+    virtual const char* name(void) {
+        return "timer_c";
+    }
+
+    virtual void reserve(size_t count) {
+        mTimers.assign(count, NULL);
+    }
+
+    virtual void add(size_t index, unsigned long interval, TimerBenchParam* param) {
+        timer_st* tm = create_timer(interval, 0, onRun, NULL, param);
+        start_timer(tm, BenchClock::nowNs() / 1000000, 0);
+        mTimers[index] = tm;
+    }
+
+    virtual void cancel(size_t index) {
+        free(mTimers[index]);
+        mTimers[index] = NULL;
+    }
+
+    virtual void apply(void) {}
+
+    virtual void tick(void) {
+        unsigned long long now = BenchClock::nowNs() / 1000000;
+        for (size_t i = 0, len = mTimers.size(); i < len; ++i) {
+            if (mTimers[i]) {
+                update_timer(mTimers[i], now);
+            }
+        }
+    }
+
+    virtual void clear(void) {
+        for (size_t i = 0, len = mTimers.size(); i < len; ++i) {
+            free(mTimers[i]);
+        }
+        mTimers.clear();
+    }
+
+private:
+    static void onRun(timer_st*, unsigned long, void* param) {
+        onFire((TimerBenchParam*)param);
+    }
+
+private:
+    std::vector<timer_st*> mTimers;
+};
+
+/* TimerManager addressed by handle */
+class TimerBenchEngineHandle : public TimerBenchEngine {
+public:
+    virtual const char* name(void) {
+        return "manager_handle";
+    }
+
+    virtual void reserve(size_t count) {
+        mHandles.assign(count, 0);
+    }
+
+    virtual void add(size_t index, unsigned long interval, TimerBenchParam* param) {
+        mHandles[index] = TimerManager::getInstance()->runLoop(interval, [](timer_st*, unsigned long, void* param)->void {
+            onFire((TimerBenchParam*)param);
+        }, param);
+    }
+
+    virtual void cancel(size_t index) {
+        TimerManager::getInstance()->stop(mHandles[index]);
+    }
+
+    virtual void apply(void) {
+        TimerManager::getInstance()->update();
+    }
+
+    virtual void tick(void) {
+        TimerManager::getInstance()->update();
+    }
+
+    virtual void clear(void) {
+        TimerManager::getInstance()->clear();
+        TimerManager::getInstance()->update();
+        mHandles.clear();
+    }
+
+private:
+    std::vector<TimerHandle> mHandles;
+};
+
+/* TimerManager addressed by string id, goes through the id map */
+class TimerBenchEngineId : public TimerBenchEngine {
+public:
+    virtual const char* name(void) {
+        return "manager_id";
+    }
+
+    virtual void reserve(size_t count) {
+        mIds.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            char id[32] = { 0 };
+            sprintf(id, "timer_%07lu", (unsigned long)i);
+            mIds[i] = id;
+        }
+    }
+
+    virtual void add(size_t index, unsigned long interval, TimerBenchParam* param) {
+        TimerManager::getInstance()->runLoop(mIds[index].c_str(), interval, [](timer_st*, unsigned long, void* param)->void {
+            onFire((TimerBenchParam*)param);
+        }, param);
+    }
+
+    virtual void cancel(size_t index) {
+        TimerManager::getInstance()->stop(mIds[index].c_str());
+    }
+
+    virtual void apply(void) {
+        TimerManager::getInstance()->update();
+    }
+
+    virtual void tick(void) {
+        TimerManager::getInstance()->update();
+    }
+
+    virtual void clear(void) {
+        TimerManager::getInstance()->clear();
+        TimerManager::getInstance()->update();
+        mIds.clear();
+    }
+
+private:
+    std::vector<std::string> mIds;
+};
+
+static void sleepMs(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void addAll(TimerBenchEngine* engine, std::vector<TimerBenchParam>& params, unsigned long interval, BenchHistogram* lateness, unsigned long long* fires) {
+    engine->reserve(params.size());
+    unsigned long long now = BenchClock::nowNs();
+    for (size_t i = 0, len = params.size(); i < len; ++i) {
+        params[i].lastNs = now;
+        params[i].interval = interval;
+        params[i].lateness = lateness;
+        params[i].fires = fires;
+        engine->add(i, interval, &params[i]);
+    }
+}
+
+static void benchScale(BenchJson& json, TimerBenchEngine* engine, size_t count, unsigned long durationMs) {
+    std::vector<TimerBenchParam> params(count);
+    unsigned long long fires = 0;
+    json.beginObject();
+    json.value("engine", std::string(engine->name()));
+    json.value("timers", (unsigned long long)count);
+    /* insert: timers far in the future */
+    unsigned long long beginNs = BenchClock::nowNs();
+    addAll(engine, params, 3600 * 1000, NULL, &fires);
+    engine->apply();
+    unsigned long long insertNs = BenchClock::nowNs() - beginNs;
+    json.value("insert_ns_per_op", (double)insertNs / count);
+    json.value("insert_ops_per_sec", count * 1.0e9 / (double)(insertNs > 0 ? insertNs : 1));
+    /* idle tick: nothing due */
+    unsigned long ticks = count >= 100000 ? 20 : 200;
+    beginNs = BenchClock::nowNs();
+    for (unsigned long i = 0; i < ticks; ++i) {
+        engine->tick();
+    }
+    json.value("idle_tick_ns", (double)(BenchClock::nowNs() - beginNs) / ticks);
+    /* cancel */
+    beginNs = BenchClock::nowNs();
+    for (size_t i = 0; i < count; ++i) {
+        engine->cancel(i);
+    }
+    engine->apply();
+    unsigned long long cancelNs = BenchClock::nowNs() - beginNs;
+    json.value("cancel_ns_per_op", (double)cancelNs / count);
+    json.value("cancel_ops_per_sec", count * 1.0e9 / (double)(cancelNs > 0 ? cancelNs : 1));
+    engine->clear();
+    /* fire: every timer due in the same tick */
+    addAll(engine, params, 1, NULL, &fires);
+    engine->apply();
+    sleepMs(5);
+    fires = 0;
+    beginNs = BenchClock::nowNs();
+    engine->tick();
+    unsigned long long fireNs = BenchClock::nowNs() - beginNs;
+    json.value("fired", fires);
+    json.value("fire_ns_per_timer", fires > 0 ? (double)fireNs / fires : 0.0);
+    json.value("fires_per_sec", fires * 1.0e9 / (double)(fireNs > 0 ? fireNs : 1));
+    engine->clear();
+    /* lateness under load, 100ms interval, ticked every millisecond */
+    if (count <= 100000) {
+        BenchHistogram lateness;
+        fires = 0;
+        addAll(engine, params, 100, &lateness, &fires);
+        engine->apply();
+        unsigned long long endNs = BenchClock::nowNs() + (unsigned long long)durationMs * 1000000;
+        while (BenchClock::nowNs() < endNs) {
+            sleepMs(1);
+            engine->tick();
+        }
+        engine->clear();
+        json.value("lateness_fires", fires);
+        json.histogram("lateness_us", lateness);
+    }
+    json.endObject();
+}
+
+std::string TimerBench::run(unsigned long maxTimers, unsigned long durationMs) {
+    TimerBenchEngineC engineC;
+    TimerBenchEngineHandle engineHandle;
+    TimerBenchEngineId engineId;
+    TimerBenchEngine* engines[] = { &engineC, &engineHandle, &engineId };
+    BenchJson json;
+    json.beginObject();
+    json.value("benchmark", std::string("timer"));
+    json.value("lateness_duration_ms", (unsigned long long)durationMs);
+    json.beginArray("results");
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e) {
+        for (unsigned long count = 10; count <= maxTimers; count *= 10) {
+            fprintf(stderr, "timer: %s %lu\n", engines[e]->name(), count);
+            benchScale(json, engines[e], count, durationMs);
+        }
+    }
+    json.endArray();
+    TimerCoalesceStats stats = TimerManager::getInstance()->getCoalesceStats();
+    json.beginObject("manager_coalesce");
+    json.value("wakeups", stats.wakeupCount);
+    json.value("idle", stats.idleCount);
+    json.value("fires", stats.fireCount);
+    json.value("max_error_ms", stats.maxError);
+    json.endObject();
+    json.endObject();
+    return json.str();
+}
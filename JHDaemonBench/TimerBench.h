@@ -0,0 +1,23 @@
+/**********************************************************************
+* Author:	jaron.ho
+* Date:		2018-05-10
+* Brief:	timer benchmark
+**********************************************************************/
+#ifndef _TIMER_BENCH_H_
+#define _TIMER_BENCH_H_
+
+#include <string>
+
+class TimerBench {
+public:
+    /*
+     * Brief:	run timer benchmark on every engine, insert/cancel/fire throughput and idle tick cost
+     *          from 10 to maxTimers timers, and firing lateness histogram under load
+     * Param:	maxTimers - max timer count, e.g. 1000000
+     *          durationMs - duration of each lateness run in milliseconds
+     * Return:	std::string, json result
+     */
+    static std::string run(unsigned long maxTimers, unsigned long durationMs);
+};
+
+#endif // _TIMER_BENCH_H_
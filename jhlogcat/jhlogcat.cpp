@@ -0,0 +1,372 @@
+// jhlogcat.cpp: 将 JHDaemon 的二进制日志(.jhlog)转为文本输出, 按时间范围查询日志
+//
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#ifdef LOGFILE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "../JHDaemon/logfile/logbinary.h"
+#include "../JHDaemon/logfile/logfile.h"
+#include "../JHDaemon/logformats.h"
+
+#define QUERY_SLACK_MS      60000ULL        /* a record reaches its file at most this late after its time */
+#define QUERY_CHUNK         64 * 1024
+#define BINARY_EXT          ".jhlog"
+#define PACKED_EXT          ".gz"
+
+/* time range of query mode, both ends are inclusive */
+struct Query {
+    Query(void) : enable(false), fromMs(0), toMs(ULLONG_MAX / 2) {}
+    bool enable;
+    unsigned long long fromMs;
+    unsigned long long toMs;
+    std::string match;
+};
+
+/* text log opened at an offset, gzip compressed rotated logs are read through zlib */
+struct LogReader {
+    LogReader(void) : fp(NULL)
+#ifdef LOGFILE_HAVE_ZLIB
+        , gz(NULL)
+#endif
+    {}
+    FILE* fp;
+#ifdef LOGFILE_HAVE_ZLIB
+    gzFile gz;
+#endif
+};
+
+static void usage(void) {
+    printf("usage: jhlogcat [--from <time>] [--to <time>] [--match <text>] <file> [file...]\n");
+    printf("  render JHDaemon binary log files (.jhlog) as text to stdout\n");
+    printf("  with --from or --to, print records in the time range, time is \"YYYY-mm-dd HH:MM:SS\",\n");
+    printf("  text logs are read only from the range found in their sidecar index (.idx),\n");
+    printf("  --match keeps records which contain text\n");
+}
+
+static bool endsWith(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() && 0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix);
+}
+
+/* "YYYY-mm-dd HH:MM:SS" in local time, as written by logtime */
+static bool parseTime(const char* str, unsigned long long& ms) {
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    if (6 != sscanf(str, "%4d-%2d-%2d %2d:%2d:%2d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec)) {
+        return false;
+    }
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    time_t sec = mktime(&t);
+    if ((time_t)-1 == sec) {
+        return false;
+    }
+    ms = (unsigned long long)sec * 1000;
+    return true;
+}
+
+static bool readFile(const char* filename, std::vector<char>& data) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    char buf[64 * 1024];
+    size_t count = 0;
+    while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.insert(data.end(), buf, buf + count);
+    }
+    fclose(fp);
+    return true;
+}
+
+/* render every record, bytes which are not a record are skipped until the next magic */
+static unsigned long long catFile(const std::vector<char>& data, const Query& query) {
+    unsigned long long skipped = 0;
+    size_t pos = 0;
+    LogBinaryRecord record;
+    while (pos < data.size()) {
+        size_t length = LogBinary::decode(&data[pos], data.size() - pos, record);
+        if (length > 0) {
+            pos += length;
+            /* records without time are not in any range */
+            if (query.enable && (0 == record.timestamp || record.timestamp < query.fromMs || record.timestamp > query.toMs + 999)) {
+                continue;
+            }
+            std::string str = LogBinary::renderRecord(getLogFormat(record.formatId), record);
+            if (!query.match.empty() && std::string::npos == str.find(query.match)) {
+                continue;
+            }
+            fwrite(str.c_str(), 1, str.size(), stdout);
+        } else {
+            /* zero bytes are the preallocated tail of a segment which is still being written */
+            if ('\0' != data[pos]) {
+                ++skipped;
+            }
+            ++pos;
+        }
+    }
+    return skipped;
+}
+
+/* index of "file.log" or of "file.log.gz" is "file.log.idx", a truncated last entry is dropped */
+static void readIndex(const std::string& filename, std::vector<logfile_index_st>& entries) {
+    std::string indexFilename = filename;
+    if (endsWith(indexFilename, PACKED_EXT)) {
+        indexFilename.erase(indexFilename.size() - strlen(PACKED_EXT));
+    }
+    std::vector<char> data;
+    if (!readFile((indexFilename + LOGFILE_INDEX_EXT).c_str(), data)) {
+        return;
+    }
+    entries.resize(data.size() / sizeof(logfile_index_st));
+    if (!entries.empty()) {
+        memcpy(&entries[0], &data[0], entries.size() * sizeof(logfile_index_st));
+    }
+}
+
+/* [begin, end) of the log which can hold records of the query, false when none can */
+static bool findRange(const std::vector<logfile_index_st>& entries, const Query& query, unsigned long long& begin, unsigned long long& end) {
+    begin = 0;
+    end = ULLONG_MAX;
+    if (entries.empty()) {
+        return true;
+    }
+    const unsigned long long lateMs = query.toMs + 999 + QUERY_SLACK_MS;
+    if (entries[0].ms > lateMs) {
+        return false;
+    }
+    /* every record before an entry is older than the entry */
+    std::vector<logfile_index_st>::const_iterator iter = std::lower_bound(entries.begin(), entries.end(), query.fromMs,
+        [](const logfile_index_st& entry, unsigned long long ms)->bool {
+        return entry.ms < ms;
+    });
+    if (entries.begin() != iter) {
+        begin = (iter - 1)->offset;
+    }
+    /* every record after an entry is written after it, so its time is at most slack before the entry */
+    iter = std::upper_bound(entries.begin(), entries.end(), lateMs, [](unsigned long long ms, const logfile_index_st& entry)->bool {
+        return ms < entry.ms;
+    });
+    if (entries.end() != iter) {
+        end = iter->offset;
+    }
+    return true;
+}
+
+static bool openReader(LogReader& reader, const std::string& filename, unsigned long long offset) {
+    if (endsWith(filename, PACKED_EXT)) {
+#ifdef LOGFILE_HAVE_ZLIB
+        /* gzip can not seek, skipped bytes are still inflated but never parsed */
+        reader.gz = gzopen(filename.c_str(), "rb");
+        if (!reader.gz) {
+            return false;
+        }
+        gzbuffer(reader.gz, QUERY_CHUNK);
+        return offset == (unsigned long long)gzseek(reader.gz, (z_off_t)offset, SEEK_SET);
+#else
+        return false;
+#endif
+    }
+    reader.fp = fopen(filename.c_str(), "rb");
+    if (!reader.fp) {
+        return false;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    return 0 == _fseeki64(reader.fp, (long long)offset, SEEK_SET);
+#else
+    return 0 == fseeko(reader.fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static size_t readReader(LogReader& reader, char* buf, size_t size) {
+#ifdef LOGFILE_HAVE_ZLIB
+    if (reader.gz) {
+        int n = gzread(reader.gz, buf, (unsigned int)size);
+        return n > 0 ? (size_t)n : 0;
+    }
+#endif
+    return fread(buf, 1, size, reader.fp);
+}
+
+static void closeReader(LogReader& reader) {
+#ifdef LOGFILE_HAVE_ZLIB
+    if (reader.gz) {
+        gzclose(reader.gz);
+        reader.gz = NULL;
+    }
+#endif
+    if (reader.fp) {
+        fclose(reader.fp);
+        reader.fp = NULL;
+    }
+}
+
+/* state of text lines, the time text of the last record is kept since most records share a second */
+struct LineFilter {
+    LineFilter(void) : lastMs(0), keep(false) {}
+    std::string lastText;
+    unsigned long long lastMs;
+    bool keep;
+};
+
+/*
+ * a line starting with "[YYYY-mm-dd HH:MM:SS]" or "[YYYY-mm-dd HH:MM:SS.mmm]" begins a record,
+ * other lines belong to the record above
+ */
+static bool filterLine(LineFilter& filter, const Query& query, const std::string& line) {
+    unsigned long long ms = 0;
+    if (line.size() >= 21 && '[' == line[0] && ']' == line[20]) {
+        ms = 0;
+    } else if (line.size() >= 25 && '[' == line[0] && '.' == line[20] && ']' == line[24]) {
+        ms = (unsigned long long)atoi(line.substr(21, 3).c_str());
+    } else {
+        return filter.keep;
+    }
+    if (0 != line.compare(1, 19, filter.lastText)) {
+        unsigned long long sec = 0;
+        if (!parseTime(line.c_str() + 1, sec)) {
+            return filter.keep;
+        }
+        filter.lastText = line.substr(1, 19);
+        filter.lastMs = sec;
+    }
+    ms += filter.lastMs;
+    filter.keep = ms >= query.fromMs && ms <= query.toMs + 999 &&
+                  (query.match.empty() || std::string::npos != line.find(query.match));
+    return filter.keep;
+}
+
+/* print records of the query between begin and end */
+static bool queryText(const std::string& filename, const Query& query, unsigned long long begin, unsigned long long end) {
+    LogReader reader;
+    if (!openReader(reader, filename, begin)) {
+        closeReader(reader);
+        return false;
+    }
+    std::vector<char> buf(QUERY_CHUNK);
+    std::string line;
+    LineFilter filter;
+    unsigned long long pos = begin;         /* offset of line begin */
+    bool done = false;
+    size_t count = 0;
+    while (!done && (count = readReader(reader, &buf[0], buf.size())) > 0) {
+        const char* data = &buf[0];
+        const char* dataEnd = data + count;
+        while (data < dataEnd) {
+            const char* newline = (const char*)memchr(data, '\n', dataEnd - data);
+            if (!newline) {
+                line.append(data, dataEnd);
+                break;
+            }
+            line.append(data, newline);
+            data = newline + 1;
+            if (pos >= end) {
+                done = true;
+                break;
+            }
+            pos += line.size() + 1;
+            if (!line.empty() && '\r' == line[line.size() - 1]) {
+                line.erase(line.size() - 1);
+            }
+            if (filterLine(filter, query, line)) {
+                line.push_back('\n');
+                fwrite(line.c_str(), 1, line.size(), stdout);
+            }
+            line.clear();
+        }
+    }
+    /* last line without newline */
+    if (!done && !line.empty() && pos < end && filterLine(filter, query, line)) {
+        line.push_back('\n');
+        fwrite(line.c_str(), 1, line.size(), stdout);
+    }
+    closeReader(reader);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Query query;
+    std::vector<std::string> filenames;
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "--from") && i + 1 < argc) {
+            if (!parseTime(argv[++i], query.fromMs)) {
+                fprintf(stderr, "bad time %s\n", argv[i]);
+                return 1;
+            }
+            query.enable = true;
+        } else if (0 == strcmp(argv[i], "--to") && i + 1 < argc) {
+            if (!parseTime(argv[++i], query.toMs)) {
+                fprintf(stderr, "bad time %s\n", argv[i]);
+                return 1;
+            }
+            query.enable = true;
+        } else if (0 == strcmp(argv[i], "--match") && i + 1 < argc) {
+            query.match = argv[++i];
+            query.enable = true;
+        } else {
+            filenames.push_back(argv[i]);
+        }
+    }
+    if (filenames.empty()) {
+        usage();
+        return 1;
+    }
+    int ret = 0;
+    if (query.enable) {
+        /* text logs in time order of their first index entry, current and rotated names do not sort by time */
+        std::vector<std::pair<unsigned long long, size_t> > order;
+        std::vector<std::vector<logfile_index_st> > indexes(filenames.size());
+        for (size_t i = 0, len = filenames.size(); i < len; ++i) {
+            if (!endsWith(filenames[i], BINARY_EXT)) {
+                readIndex(filenames[i], indexes[i]);
+            }
+            order.push_back(std::make_pair(indexes[i].empty() ? 0 : indexes[i][0].ms, i));
+        }
+        std::stable_sort(order.begin(), order.end(), [](const std::pair<unsigned long long, size_t>& a, const std::pair<unsigned long long, size_t>& b)->bool {
+            return a.first < b.first;
+        });
+        for (size_t n = 0, len = order.size(); n < len; ++n) {
+            const std::string& filename = filenames[order[n].second];
+            if (endsWith(filename, BINARY_EXT)) {
+                std::vector<char> data;
+                if (!readFile(filename.c_str(), data)) {
+                    fprintf(stderr, "can not open %s\n", filename.c_str());
+                    ret = 1;
+                    continue;
+                }
+                catFile(data, query);
+                continue;
+            }
+            unsigned long long begin = 0;
+            unsigned long long end = 0;
+            if (!findRange(indexes[order[n].second], query, begin, end)) {
+                continue;
+            }
+            if (!queryText(filename, query, begin, end)) {
+                fprintf(stderr, "can not read %s\n", filename.c_str());
+                ret = 1;
+            }
+        }
+        return ret;
+    }
+    for (size_t i = 0, len = filenames.size(); i < len; ++i) {
+        std::vector<char> data;
+        if (!readFile(filenames[i].c_str(), data)) {
+            fprintf(stderr, "can not open %s\n", filenames[i].c_str());
+            ret = 1;
+            continue;
+        }
+        unsigned long long skipped = catFile(data, query);
+        if (skipped > 0) {
+            fprintf(stderr, "%s: %llu bytes skipped\n", filenames[i].c_str(), skipped);
+        }
+    }
+    return ret;
+}